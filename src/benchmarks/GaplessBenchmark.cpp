@@ -0,0 +1,424 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+
+/* plays the same file several times back to back, hands each track off to
+the next the way GaplessTransport does, and counts how many samples of
+silence the output had to play at each hand-off. every read from the file is
+delayed, to stand in for slow storage or a network share.
+
+    gapless_benchmark <audio file> [transitions] [read delay ms] [speed]
+
+the output plays buffers in real time, sped up by `speed` (default 4x). with
+the default prefill settings every hand-off should be gapless; the exit code
+is non-zero if any wasn't. */
+
+#include "BenchmarkUtil.h"
+
+#include <musikcore/audio/Player.h>
+#include <musikcore/debug.h>
+#include <musikcore/io/DataStreamFactory.h>
+#include <musikcore/plugin/Plugins.h>
+#include <musikcore/sdk/IOutput.h>
+
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using namespace musik::core;
+using namespace musik::core::audio;
+using namespace musik::core::io;
+using namespace musik::core::sdk;
+using namespace musik::benchmarks;
+
+static const std::string SLOW_SCHEME = "slow://";
+static const int PREFILL_MIXPOINT = 1;
+
+/* wraps a regular stream, and sleeps before every read */
+class SlowDataStream : public IDataStream {
+    public:
+        SlowDataStream(IDataStream* stream, int delayMs)
+        : stream(stream), delayMs(delayMs) {
+        }
+
+        bool Open(const char *uri, OpenFlags flags) override { return false; }
+        bool Close() override { return this->stream->Close(); }
+        void Interrupt() override { this->stream->Interrupt(); }
+        void Release() override { this->stream->Release(); delete this; }
+        bool Readable() override { return true; }
+        bool Writable() override { return false; }
+        PositionType Write(void *buffer, PositionType writeBytes) override { return 0; }
+        bool SetPosition(PositionType position) override { return this->stream->SetPosition(position); }
+        PositionType Position() override { return this->stream->Position(); }
+        bool Seekable() override { return this->stream->Seekable(); }
+        bool Eof() override { return this->stream->Eof(); }
+        long Length() override { return this->stream->Length(); }
+        const char* Type() override { return this->stream->Type(); }
+        const char* Uri() override { return this->stream->Uri(); }
+        bool CanPrefetch() override { return true; }
+
+        PositionType Read(void *buffer, PositionType readBytes) override {
+            std::this_thread::sleep_for(std::chrono::milliseconds(this->delayMs));
+            return this->stream->Read(buffer, readBytes);
+        }
+
+    private:
+        IDataStream* stream;
+        int delayMs;
+};
+
+class SlowDataStreamFactory : public IDataStreamFactory {
+    public:
+        SlowDataStreamFactory(int delayMs) : delayMs(delayMs) { }
+
+        bool CanRead(const char *uri) override {
+            return strncmp(uri, SLOW_SCHEME.c_str(), SLOW_SCHEME.size()) == 0;
+        }
+
+        IDataStream* Open(const char *uri, OpenFlags flags) override {
+            IDataStream* stream = DataStreamFactory::OpenDataStream(uri + SLOW_SCHEME.size(), flags);
+            return stream ? new SlowDataStream(stream, this->delayMs) : nullptr;
+        }
+
+        void Release() override { }
+
+    private:
+        int delayMs;
+};
+
+/* plays buffers in (sped up) real time, like a device that keeps `latency`
+seconds of audio queued. records how much silence it had to play whenever it
+ran out, separately for hand-offs (the next buffer came from a different
+player) and mid-track starvation. */
+class PacedOutput : public IOutput {
+    public:
+        PacedOutput(double speed) : speed(speed) {
+            this->thread = std::thread(&PacedOutput::ThreadProc, this);
+        }
+
+        ~PacedOutput() {
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->quit = true;
+                this->condition.notify_all();
+            }
+            this->thread.join();
+        }
+
+        void Release() override { }
+        void Pause() override { }
+        void Resume() override { }
+        void SetVolume(double volume) override { }
+        double GetVolume() override { return 1.0; }
+        void Stop() override { }
+        void Drain() override { }
+        double Latency() override { return kLatency; }
+        const char* Name() override { return "PacedOutput"; }
+        int GetDefaultSampleRate() override { return -1; }
+        IDeviceList* GetDeviceList() override { return nullptr; }
+        bool SetDefaultDevice(const char* deviceId) override { return false; }
+        IDevice* GetDefaultDevice() override { return nullptr; }
+
+        OutputState Play(IBuffer* buffer, IBufferProvider* provider) override {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            if (this->queue.size() >= kMaxQueued) {
+                return (OutputState) 10; /* try again in 10ms */
+            }
+            this->queue.push_back({ buffer, provider });
+            this->condition.notify_all();
+            return OutputState::BufferWritten;
+        }
+
+        /* samples per channel of silence played at each hand-off so far */
+        std::vector<double> HandoffGaps() {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            return this->handoffGaps;
+        }
+
+        /* samples per channel of silence played mid-track */
+        double Starved() {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            return this->starved;
+        }
+
+    private:
+        static constexpr size_t kMaxQueued = 8;
+        static constexpr double kLatency = 0.1;
+
+        struct Entry {
+            IBuffer* buffer;
+            IBufferProvider* provider;
+        };
+
+        void ThreadProc() {
+            IBufferProvider* lastProvider = nullptr;
+            Clock::time_point deviceEnd; /* when the "device" runs out of audio */
+
+            while (true) {
+                Entry entry;
+
+                {
+                    std::unique_lock<std::mutex> lock(this->mutex);
+                    while (!this->quit && this->queue.empty()) {
+                        this->condition.wait(lock);
+                    }
+                    if (this->quit) {
+                        return;
+                    }
+                    entry = this->queue.front();
+                    this->queue.pop_front();
+                }
+
+                IBuffer* buffer = entry.buffer;
+                const long sampleRate = buffer->SampleRate();
+                const double seconds = (double) buffer->Samples() /
+                    (double) (buffer->Channels() * sampleRate);
+
+                const auto now = Clock::now();
+
+                if (lastProvider) {
+                    const double idle = std::max(0.0,
+                        std::chrono::duration<double>(now - deviceEnd).count());
+                    const double silence = idle * this->speed * (double) sampleRate;
+
+                    std::unique_lock<std::mutex> lock(this->mutex);
+                    if (entry.provider != lastProvider) {
+                        this->handoffGaps.push_back(silence);
+                    }
+                    else {
+                        this->starved += silence;
+                    }
+                }
+
+                /* copied into the device, so the player can have it back */
+                deviceEnd = std::max(now, deviceEnd) +
+                    std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double>(seconds / this->speed));
+                lastProvider = entry.provider;
+                entry.provider->OnBufferProcessed(buffer);
+
+                /* wait until the device only has `kLatency` left to play */
+                std::this_thread::sleep_until(deviceEnd -
+                    std::chrono::duration_cast<Clock::duration>(
+                        std::chrono::duration<double>(kLatency / this->speed)));
+            }
+        }
+
+        double speed;
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<Entry> queue;
+        std::vector<double> handoffGaps;
+        double starved{ 0.0 };
+        bool quit{ false };
+};
+
+/* queues player events for the main thread, which drives the hand-offs */
+class Listener : public Player::EventListener {
+    public:
+        enum class Type { Buffered, MixPoint, StreamEof, Finished, OpenFailed, Destroying };
+
+        struct Event {
+            Type type;
+            Player* player;
+        };
+
+        void OnPlayerBuffered(Player* player) override { this->Push(Type::Buffered, player); }
+        void OnPlayerStreamEof(Player* player) override { this->Push(Type::StreamEof, player); }
+        void OnPlayerFinished(Player* player) override { this->Push(Type::Finished, player); }
+        void OnPlayerOpenFailed(Player* player) override { this->Push(Type::OpenFailed, player); }
+        void OnPlayerDestroying(Player* player) override { this->Push(Type::Destroying, player); }
+
+        void OnPlayerMixPoint(Player* player, int id, double time) override {
+            if (id == PREFILL_MIXPOINT) {
+                this->Push(Type::MixPoint, player);
+            }
+        }
+
+        Event Next() {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            while (this->events.empty()) {
+                this->condition.wait(lock);
+            }
+            Event event = this->events.front();
+            this->events.pop_front();
+            return event;
+        }
+
+    private:
+        void Push(Type type, Player* player) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->events.push_back({ type, player });
+            this->condition.notify_all();
+        }
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<Event> events;
+};
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("usage: %s <audio file> [transitions] [read delay ms] [speed]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const std::string uri = SLOW_SCHEME + argv[1];
+    const int transitions = argc > 2 ? std::max(1, atoi(argv[2])) : 3;
+    const int delayMs = argc > 3 ? std::max(0, atoi(argv[3])) : 20;
+    const double speed = argc > 4 ? std::max(1.0, atof(argv[4])) : 4.0;
+
+    /* GaplessTransport's defaults */
+    const double prefillSeconds = 3.0;
+    const double prefillLeadSeconds = 15.0;
+
+    musik::debug::Start({ });
+    plugin::Init();
+
+    DataStreamFactory::Register(std::make_shared<SlowDataStreamFactory>(delayMs));
+
+    /* outlive every player */
+    Listener listener;
+    auto output = std::make_shared<PacedOutput>(speed);
+
+    int created = 0, destroyed = 0, handoffs = 0;
+    bool failed = false;
+    Player* active = nullptr;
+    Player* next = nullptr;
+
+    auto create = [&]() {
+        ++created;
+        return Player::Create(uri, output, Player::DestroyMode::NoDrain, &listener);
+    };
+
+    /* same as GaplessTransport::SchedulePrefill(): decode the start of the
+    next track once the active one is within the lead time of its end. */
+    auto prepareNext = [&]() {
+        if (created > transitions) {
+            return;
+        }
+        next = create();
+        const double duration = active->GetDuration();
+        const double at = duration - prefillLeadSeconds;
+        if (duration > 0.0 && at > active->GetPosition()) {
+            active->AddMixPoint(PREFILL_MIXPOINT, at);
+        }
+        else {
+            next->Prefill(prefillSeconds);
+        }
+    };
+
+    active = create();
+    active->Play();
+
+    while (destroyed < created) {
+        const Listener::Event event = listener.Next();
+        Player* player = event.player;
+
+        switch (event.type) {
+            case Listener::Type::Buffered:
+                if (player == active && !next) {
+                    prepareNext();
+                }
+                break;
+
+            case Listener::Type::MixPoint:
+                if (player == active && next) {
+                    next->Prefill(prefillSeconds);
+                }
+                break;
+
+            case Listener::Type::StreamEof:
+                if (player == active && next) {
+                    next->ExpectHandoff();
+                    next->Play();
+                    active->Destroy();
+                    active = next;
+                    next = nullptr;
+                    ++handoffs;
+                    prepareNext();
+                }
+                break;
+
+            case Listener::Type::Finished:
+                if (player == active) {
+                    active = nullptr;
+                }
+                break;
+
+            case Listener::Type::OpenFailed:
+                printf("failed to open %s\n", uri.c_str());
+                failed = true;
+                player->Destroy();
+                if (player == active) {
+                    active = nullptr;
+                }
+                if (next && player != next) {
+                    next->Destroy();
+                }
+                next = nullptr;
+                break;
+
+            case Listener::Type::Destroying:
+                ++destroyed;
+                break;
+        }
+    }
+
+    const auto gaps = output->HandoffGaps();
+    double total = 0.0;
+    for (size_t i = 0; i < gaps.size(); i++) {
+        printf("hand-off %zu: %.0f samples of silence\n", i + 1, gaps[i]);
+        total += gaps[i];
+    }
+
+    printf("%-32s %d\n", "hand-offs", handoffs);
+    printf("%-32s %.0f samples\n", "total gap", total);
+    printf("%-32s %.0f samples\n", "starved mid-track", output->Starved());
+
+    plugin::Shutdown();
+    musik::debug::Shutdown();
+
+    if (failed || (int) gaps.size() != handoffs || total > 0.0) {
+        printf("FAILED\n");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,188 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+
+/* measures how long it takes from Player::Create() until the output has
+consumed the player's first buffer, over many consecutive players. this is
+the cost a transport pays every time a track starts: worker startup, stream
+and decoder setup, buffer allocation and the first decode.
+
+    player_start_benchmark <audio file> [iterations]
+
+the output used here consumes buffers as soon as it gets them, so the
+numbers don't include any device latency. */
+
+#include "BenchmarkUtil.h"
+
+#include <musikcore/audio/Player.h>
+#include <musikcore/debug.h>
+#include <musikcore/plugin/Plugins.h>
+#include <musikcore/sdk/IOutput.h>
+
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+
+using namespace musik::core;
+using namespace musik::core::audio;
+using namespace musik::core::sdk;
+using namespace musik::benchmarks;
+
+class ImmediateOutput : public IOutput {
+    public:
+        void Release() override { }
+        void Pause() override { }
+        void Resume() override { }
+        void SetVolume(double volume) override { }
+        double GetVolume() override { return 1.0; }
+        void Stop() override { }
+        void Drain() override { }
+        double Latency() override { return 0.0; }
+        const char* Name() override { return "ImmediateOutput"; }
+        int GetDefaultSampleRate() override { return -1; }
+        IDeviceList* GetDeviceList() override { return nullptr; }
+        bool SetDefaultDevice(const char* deviceId) override { return false; }
+        IDevice* GetDefaultDevice() override { return nullptr; }
+
+        OutputState Play(IBuffer* buffer, IBufferProvider* provider) override {
+            provider->OnBufferProcessed(buffer);
+            return OutputState::BufferWritten;
+        }
+};
+
+class Listener : public Player::EventListener {
+    public:
+        void OnPlayerStarted(Player* player) override {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->startedAt = Clock::now();
+            this->started = true;
+            this->condition.notify_all();
+        }
+
+        void OnPlayerOpenFailed(Player* player) override {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->failed = true;
+            this->condition.notify_all();
+        }
+
+        void OnPlayerDestroying(Player* player) override {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->destroyed = true;
+            this->condition.notify_all();
+        }
+
+        void Reset() {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->started = this->failed = this->destroyed = false;
+        }
+
+        /* returns false if the player couldn't open the file */
+        bool WaitForStart() {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            while (!this->started && !this->failed) {
+                this->condition.wait(lock);
+            }
+            return this->started;
+        }
+
+        void WaitForDestroy() {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            while (!this->destroyed) {
+                this->condition.wait(lock);
+            }
+        }
+
+        Clock::time_point startedAt;
+
+    private:
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool started{ false }, failed{ false }, destroyed{ false };
+};
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("usage: %s <audio file> [iterations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const std::string uri = argv[1];
+    const int iterations = argc > 2 ? std::max(1, atoi(argv[2])) : 50;
+
+    musik::debug::Start({ });
+    plugin::Init();
+
+    /* outlives every player; a player may still be returning from its last
+    callback when WaitForDestroy() wakes up. */
+    Listener listener;
+    auto output = std::shared_ptr<IOutput>(new ImmediateOutput());
+    std::vector<double> samples;
+    int exitCode = EXIT_SUCCESS;
+
+    /* the first iteration pays for loading plugins and warming caches, so it's
+    reported separately. */
+    for (int i = 0; i <= iterations; i++) {
+        listener.Reset();
+
+        const auto start = Clock::now();
+        Player* player = Player::Create(uri, output, Player::DestroyMode::NoDrain, &listener);
+        player->Play();
+
+        const bool started = listener.WaitForStart();
+        player->Destroy();
+        listener.WaitForDestroy();
+
+        if (!started) {
+            printf("failed to open %s\n", uri.c_str());
+            exitCode = EXIT_FAILURE;
+            break;
+        }
+
+        const double elapsed = ElapsedMs(start, listener.startedAt);
+        if (i == 0) {
+            printf("%-32s %.3fms\n", "first start (cold)", elapsed);
+        }
+        else {
+            samples.push_back(elapsed);
+        }
+    }
+
+    PrintSummary("create to first buffer played", samples);
+
+    plugin::Shutdown();
+    musik::debug::Shutdown();
+
+    return exitCode;
+}
@@ -0,0 +1,177 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+
+/* checks the core Resampler's output against an ideal signal, and times it.
+
+    resampler_benchmark [seconds]
+
+for every quality level and a few common rate pairs, a 1khz stereo sine is
+fed through in 2048 frame chunks, then flushed. we report:
+
+  - frames: expected vs produced. they should match exactly.
+  - phase: offset of the output relative to the ideal sine, in output frames.
+    the filter's delay is compensated for, so this should be ~0.
+  - snr: power of the ideal sine vs everything else, ignoring the first and
+    last 100ms where the filter is filling and draining.
+  - time: milliseconds spent per second of audio. */
+
+#include "BenchmarkUtil.h"
+
+#include <musikcore/audio/Buffer.h>
+#include <musikcore/audio/Resampler.h>
+
+#include <cmath>
+#include <cstdlib>
+
+using namespace musik::core::audio;
+using namespace musik::benchmarks;
+
+static const int kChannels = 2;
+static const int kFramesPerChunk = 2048;
+static const double kFrequency = 1000.0;
+static const double kAmplitude = 0.5;
+static const double kPi = 3.14159265358979323846;
+
+struct Result {
+    long expectedFrames;
+    long frames;
+    double phaseFrames;
+    double snr;
+    double msPerSecond;
+};
+
+static Result measure(Resampler::Quality quality, long inputRate, long outputRate, double seconds) {
+    const long inputFrames = (long) (seconds * inputRate);
+
+    std::vector<float> input(inputFrames * kChannels);
+    for (long i = 0; i < inputFrames; i++) {
+        const float value = (float) (kAmplitude * sin(2.0 * kPi * kFrequency * i / inputRate));
+        for (int ch = 0; ch < kChannels; ch++) {
+            input[i * kChannels + ch] = value;
+        }
+    }
+
+    Resampler resampler(kChannels, inputRate, outputRate, quality);
+    Buffer buffer;
+    std::vector<float> output;
+
+    auto append = [&output, &buffer](int frames) {
+        const float* data = buffer.BufferPointer();
+        output.insert(output.end(), data, data + frames * kChannels);
+    };
+
+    const auto start = Clock::now();
+    for (long offset = 0; offset < inputFrames; offset += kFramesPerChunk) {
+        const int frames = (int) std::min((long) kFramesPerChunk, inputFrames - offset);
+        append(resampler.Process(input.data() + offset * kChannels, frames, &buffer));
+    }
+    append(resampler.Flush(&buffer));
+    const double elapsed = ElapsedMs(start, Clock::now());
+
+    Result result;
+    result.expectedFrames = (long) ((double) inputFrames * outputRate / inputRate + 0.5);
+    result.frames = (long) (output.size() / kChannels);
+    result.msPerSecond = elapsed / seconds;
+
+    /* least squares fit of a sine and cosine at the test frequency to the
+    first channel (skipping the edges). that gives us the phase, and the fit
+    itself is the "signal" -- the residual is noise and distortion. */
+    const long skip = outputRate / 10;
+    const long end = result.frames - skip;
+    const double w = 2.0 * kPi * kFrequency / outputRate;
+
+    double ss = 0.0, sc = 0.0, cc = 0.0, ys = 0.0, yc = 0.0;
+    for (long i = skip; i < end; i++) {
+        const double s = sin(w * i), c = cos(w * i), y = output[i * kChannels];
+        ss += s * s; sc += s * c; cc += c * c; ys += y * s; yc += y * c;
+    }
+
+    const double det = ss * cc - sc * sc;
+    const double a = (ys * cc - yc * sc) / det;
+    const double b = (yc * ss - ys * sc) / det;
+    result.phaseFrames = atan2(b, a) / w;
+
+    double signal = 0.0, noise = 0.0;
+    for (long i = skip; i < end; i++) {
+        const double fit = a * sin(w * i) + b * cos(w * i);
+        const double error = output[i * kChannels] - fit;
+        signal += fit * fit;
+        noise += error * error;
+    }
+
+    result.snr = noise > 0.0 ? 10.0 * log10(signal / noise) : INFINITY;
+    return result;
+}
+
+int main(int argc, char** argv) {
+    const double seconds = argc > 1 ? std::max(1.0, atof(argv[1])) : 10.0;
+
+    const struct { Resampler::Quality quality; const char* name; } qualities[] = {
+        { Resampler::Quality::Fast, "fast" },
+        { Resampler::Quality::Balanced, "balanced" },
+        { Resampler::Quality::Best, "best" },
+    };
+
+    const long rates[][2] = {
+        { 44100, 48000 },
+        { 48000, 44100 },
+        { 96000, 44100 },
+        { 44100, 96000 },
+    };
+
+    printf("%-10s %-14s %-20s %-10s %-10s %s\n",
+        "quality", "rates", "frames (expected)", "phase", "snr", "time");
+
+    int exitCode = EXIT_SUCCESS;
+
+    for (auto& q : qualities) {
+        for (auto& rate : rates) {
+            const Result r = measure(q.quality, rate[0], rate[1], seconds);
+
+            char rates[32], frames[32];
+            snprintf(rates, sizeof(rates), "%ld->%ld", rate[0], rate[1]);
+            snprintf(frames, sizeof(frames), "%ld (%ld)", r.frames, r.expectedFrames);
+
+            printf("%-10s %-14s %-20s %-10.3f %-10.1f %.3fms/s\n",
+                q.name, rates, frames, r.phaseFrames, r.snr, r.msPerSecond);
+
+            if (r.frames != r.expectedFrames) {
+                exitCode = EXIT_FAILURE;
+            }
+        }
+    }
+
+    return exitCode;
+}
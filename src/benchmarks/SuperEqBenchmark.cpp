@@ -0,0 +1,142 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+
+/* compares the supereq dsp's original scalar convolution with SuperEqEngine's
+vectorized one: speed, and whether the output matches.
+
+    supereq_benchmark [seconds] [bands dB, e.g. 6,0,-3,...]
+
+both engines process the same stereo white noise at 44.1khz, in 2048 frame
+buffers, the way the dsp sees it during playback. */
+
+#include "BenchmarkUtil.h"
+
+#include <plugins/supereqdsp/SuperEqEngine.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+
+using namespace musik::benchmarks;
+
+static const int kChannels = 2;
+static const long kSampleRate = 44100;
+static const int kFramesPerBuffer = 2048;
+static const int kPasses = 5;
+
+/* default curve: a loudness-ish smile, so the filter isn't trivial */
+static void parseBands(const char* arg, float* bands) {
+    static const float defaults[SuperEqEngine::kBandCount] = {
+        6, 5, 4, 2, 0, -1, -2, -2, -1, 0, 1, 2, 3, 4, 5, 5, 6, 6 };
+
+    float dB[SuperEqEngine::kBandCount];
+    memcpy(dB, defaults, sizeof(dB));
+
+    if (arg) {
+        std::stringstream stream(arg);
+        std::string value;
+        for (int i = 0; i < SuperEqEngine::kBandCount && std::getline(stream, value, ','); i++) {
+            dB[i] = (float) atof(value.c_str());
+        }
+    }
+
+    for (int i = 0; i < SuperEqEngine::kBandCount; i++) {
+        bands[i] = (float) pow(10, dB[i] / 20.0);
+    }
+}
+
+/* runs `samples` through a fresh engine, in place. returns the time spent in
+Process(), in milliseconds. */
+static double run(bool simd, const float* bands, std::vector<float>& samples) {
+    SuperEqEngine engine(kChannels, kSampleRate, bands, simd);
+
+    const int stride = kFramesPerBuffer * kChannels;
+    const auto start = Clock::now();
+    for (size_t offset = 0; offset + stride <= samples.size(); offset += stride) {
+        engine.Process(samples.data() + offset, kFramesPerBuffer);
+    }
+    return ElapsedMs(start, Clock::now());
+}
+
+int main(int argc, char** argv) {
+    const double seconds = argc > 1 ? std::max(1.0, atof(argv[1])) : 30.0;
+
+    float bands[SuperEqEngine::kBandCount];
+    parseBands(argc > 2 ? argv[2] : nullptr, bands);
+
+    const size_t buffers = (size_t) (seconds * kSampleRate / kFramesPerBuffer);
+    std::vector<float> noise(buffers * kFramesPerBuffer * kChannels);
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> distribution(-0.5f, 0.5f);
+    for (float& sample : noise) {
+        sample = distribution(rng);
+    }
+
+    const double audioSeconds = (double) buffers * kFramesPerBuffer / kSampleRate;
+
+    std::vector<float> legacy, simd;
+    std::vector<double> legacyMs, simdMs;
+
+    /* alternate the engines so neither one consistently gets a warmer cache */
+    for (int i = 0; i < kPasses; i++) {
+        legacy = noise;
+        legacyMs.push_back(run(false, bands, legacy) / audioSeconds);
+        simd = noise;
+        simdMs.push_back(run(true, bands, simd) / audioSeconds);
+    }
+
+    printf("%.1fs of stereo noise at %ldhz, %d frame buffers, %d passes\n",
+        audioSeconds, kSampleRate, kFramesPerBuffer, kPasses);
+    PrintSummary("scalar (per second of audio)", legacyMs);
+    PrintSummary("simd (per second of audio)", simdMs);
+
+    double maxDifference = 0.0;
+    for (size_t i = 0; i < legacy.size(); i++) {
+        maxDifference = std::max(maxDifference, (double) fabsf(legacy[i] - simd[i]));
+    }
+
+    if (maxDifference == 0.0) {
+        printf("output: bit-identical\n");
+    }
+    else {
+        printf("output: max difference %g (%.1f dBFS)\n", maxDifference, 20.0 * log10(maxDifference));
+    }
+
+    return EXIT_SUCCESS;
+}
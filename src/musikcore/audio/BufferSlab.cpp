@@ -0,0 +1,104 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "pch.hpp"
+
+#include <musikcore/audio/BufferSlab.h>
+
+#include <list>
+#include <mutex>
+
+using namespace musik::core::audio;
+
+/* enough for a handful of recently finished tracks across a couple of
+channel layouts; anything beyond this is freed normally. */
+static const size_t kMaxIdleSlabs = 6;
+
+static std::mutex idleMutex;
+static std::list<BufferSlab::Ptr> idleSlabs;
+
+BufferSlab::BufferSlab(int channels, int samplesPerChannel, int count)
+: channels(channels)
+, samplesPerChannel(samplesPerChannel) {
+    const int samplesPerBuffer = samplesPerChannel * channels;
+    this->raw = new float[count * samplesPerBuffer];
+    this->buffers.reserve(count);
+    for (int i = 0; i < count; i++) {
+        this->buffers.push_back(new Buffer(this->raw + (i * samplesPerBuffer), samplesPerBuffer));
+    }
+}
+
+BufferSlab::~BufferSlab() {
+    for (Buffer* buffer : this->buffers) {
+        delete buffer;
+    }
+    delete[] this->raw;
+}
+
+BufferSlab::Ptr BufferSlab::Acquire(int channels, int samplesPerChannel, int count) {
+    {
+        std::unique_lock<std::mutex> lock(idleMutex);
+
+        /* smallest idle slab of the right shape that's big enough */
+        auto best = idleSlabs.end();
+        for (auto it = idleSlabs.begin(); it != idleSlabs.end(); ++it) {
+            auto& slab = *it;
+            if (slab->channels == channels &&
+                slab->samplesPerChannel == samplesPerChannel &&
+                slab->Count() >= count &&
+                (best == idleSlabs.end() || slab->Count() < (*best)->Count()))
+            {
+                best = it;
+            }
+        }
+
+        if (best != idleSlabs.end()) {
+            Ptr result = *best;
+            idleSlabs.erase(best);
+            return result;
+        }
+    }
+
+    return Ptr(new BufferSlab(channels, samplesPerChannel, count));
+}
+
+void BufferSlab::Recycle(Ptr slab) {
+    if (slab) {
+        std::unique_lock<std::mutex> lock(idleMutex);
+        idleSlabs.push_front(slab);
+        while (idleSlabs.size() > kMaxIdleSlabs) {
+            idleSlabs.pop_back();
+        }
+    }
+}
@@ -0,0 +1,74 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <musikcore/config.h>
+#include <musikcore/audio/Buffer.h>
+
+#include <memory>
+#include <vector>
+
+namespace musik { namespace core { namespace audio {
+
+    /* a single contiguous allocation carved up into fixed-size Buffers. Streams
+    need a few dozen of these per track; instead of allocating (and zeroing) a
+    fresh block every time a track starts, released slabs are kept around and
+    handed to the next Stream with the same shape. */
+    class BufferSlab {
+        public:
+            using Ptr = std::shared_ptr<BufferSlab>;
+
+            static Ptr Acquire(int channels, int samplesPerChannel, int count);
+            static void Recycle(Ptr slab);
+
+            BufferSlab(const BufferSlab&) = delete;
+            BufferSlab& operator=(const BufferSlab&) = delete;
+            ~BufferSlab();
+
+            int Channels() const noexcept { return this->channels; }
+            int SamplesPerChannel() const noexcept { return this->samplesPerChannel; }
+            int Count() const noexcept { return (int) this->buffers.size(); }
+            Buffer* At(int index) const { return this->buffers[index]; }
+
+        private:
+            BufferSlab(int channels, int samplesPerChannel, int count);
+
+            int channels;
+            int samplesPerChannel;
+            float* raw;
+            std::vector<Buffer*> buffers;
+    };
+
+} } }
@@ -38,6 +38,7 @@
 #include <musikcore/audio/CrossfadeTransport.h>
 #include <musikcore/plugin/PluginFactory.h>
 #include <musikcore/audio/Outputs.h>
+#include <musikcore/support/Trace.h>
 #include <algorithm>
 
 #define CROSSFADE_DURATION_MS 1500
@@ -80,6 +81,8 @@ void CrossfadeTransport::PrepareNextTrack(const std::string& uri, Gain gain) {
 }
 
 void CrossfadeTransport::Start(const std::string& uri, Gain gain, StartMode mode) {
+    trace::Span span("CrossfadeTransport::Start");
+
     {
         Lock lock(this->stateMutex);
 
@@ -473,10 +476,32 @@ void CrossfadeTransport::PlayerContext::Reset(
             this->output,
             Player::DestroyMode::Drain,
             listener,
-            gain)
+            gain,
+            transport.AcquireDspChain())
         : nullptr;
 }
 
+DspChain::Ptr CrossfadeTransport::AcquireDspChain() {
+    /* tracks overlap while crossfading, so they can't share a chain. reuse
+    any chain that's no longer attached to a stream, and only create a new
+    one if every existing chain is busy. idle chains built from plugins that
+    have since changed are dropped. */
+    Lock lock(this->stateMutex);
+    auto& chains = this->dspChains;
+    chains.erase(std::remove_if(chains.begin(), chains.end(),
+        [](const DspChain::Ptr& chain) {
+            return !chain->Attached() && chain->Stale();
+        }), chains.end());
+    for (auto& chain : chains) {
+        if (!chain->Attached() && !chain->Stale()) {
+            return chain;
+        }
+    }
+    auto chain = std::make_shared<DspChain>();
+    this->dspChains.push_back(chain);
+    return chain;
+}
+
 void CrossfadeTransport::PlayerContext::TransferTo(PlayerContext& to) noexcept {
     to.player = player;
     to.output = output;
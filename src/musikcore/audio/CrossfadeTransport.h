@@ -129,6 +129,7 @@ namespace musik { namespace core { namespace audio {
             void SetPlaybackState(musik::core::sdk::PlaybackState state);
 
             void OnCrossfaderEmptied();
+            DspChain::Ptr AcquireDspChain();
 
             void OnPlayerBuffered(Player* player) override;
             void OnPlayerStarted(Player* player) override;
@@ -143,6 +144,7 @@ namespace musik { namespace core { namespace audio {
             Crossfader crossfader;
             PlayerContext active;
             PlayerContext next;
+            std::vector<DspChain::Ptr> dspChains;
             double volume;
             bool muted;
     };
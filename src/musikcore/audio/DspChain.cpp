@@ -0,0 +1,147 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "pch.hpp"
+
+#include <musikcore/audio/DspChain.h>
+#include <musikcore/audio/Streams.h>
+#include <musikcore/debug.h>
+
+#include <chrono>
+
+using namespace musik::core::audio;
+using namespace musik::core::sdk;
+
+static const std::string TAG = "DspChain";
+
+/* how often stats are logged while the chain is in use; they're also logged
+whenever a stream detaches. */
+static const auto kLogInterval = std::chrono::seconds(60);
+
+static std::atomic<int> currentGeneration(0);
+
+DspChain::DspChain()
+: dsps(streams::GetDspPlugins())
+, lastLogged(std::chrono::steady_clock::now())
+, attached(0)
+, generation(currentGeneration.load()) {
+    this->timings.reset(new Timing[this->dsps.size()]);
+}
+
+void DspChain::Process(IBuffer* buffer) {
+    if (this->dsps.empty()) {
+        return;
+    }
+
+    /* uncontended for gapless playback; only serializes if two streams share
+    a chain at the same time. */
+    std::unique_lock<std::mutex> lock(this->processMutex);
+
+    for (size_t i = 0; i < this->dsps.size(); i++) {
+        auto const start = std::chrono::steady_clock::now();
+        this->dsps[i]->Process(buffer);
+        auto const micros = (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        Timing& timing = this->timings[i];
+        timing.buffers.fetch_add(1, std::memory_order_relaxed);
+        timing.totalMicros.fetch_add(micros, std::memory_order_relaxed);
+        if (micros > timing.maxMicros.load(std::memory_order_relaxed)) {
+            timing.maxMicros.store(micros, std::memory_order_relaxed);
+        }
+    }
+
+    /* logging only enqueues the line, so this is cheap enough to do here */
+    auto const now = std::chrono::steady_clock::now();
+    if (now - this->lastLogged >= kLogInterval) {
+        this->lastLogged = now;
+        this->LogStats();
+    }
+}
+
+void DspChain::Attach() {
+    ++this->attached;
+}
+
+void DspChain::Detach() {
+    --this->attached;
+    this->LogStats();
+}
+
+void DspChain::Invalidate() {
+    currentGeneration.fetch_add(1);
+}
+
+bool DspChain::Stale() const noexcept {
+    return this->generation != currentGeneration.load();
+}
+
+void DspChain::LogStats() {
+    for (auto& stats : this->GetStats()) {
+        if (stats.buffers > 0) {
+            musik::debug::info(TAG, u8fmt(
+                "dsp %d: %llu buffers, avg %lluus, max %lluus",
+                (int) stats.index,
+                (unsigned long long) stats.buffers,
+                (unsigned long long) (stats.totalMicros / stats.buffers),
+                (unsigned long long) stats.maxMicros));
+        }
+    }
+
+    /* decoders are resolved once per stream, so their counters are logged
+    on the same schedule. */
+    auto const probes = streams::GetDecoderProbeStats();
+    if (probes.probes > 0) {
+        musik::debug::info(TAG, u8fmt(
+            "decoder probes: %llu total, %llu cache hits, %llu sniff hits, %llu misses",
+            (unsigned long long) probes.probes,
+            (unsigned long long) probes.cacheHits,
+            (unsigned long long) probes.sniffHits,
+            (unsigned long long) probes.misses));
+    }
+}
+
+std::vector<DspChain::Stats> DspChain::GetStats() {
+    std::vector<Stats> result;
+    for (size_t i = 0; i < this->dsps.size(); i++) {
+        Timing& timing = this->timings[i];
+        result.push_back({
+            i,
+            timing.buffers.load(),
+            timing.totalMicros.load(),
+            timing.maxMicros.load()
+        });
+    }
+    return result;
+}
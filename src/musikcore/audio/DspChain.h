@@ -0,0 +1,102 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <musikcore/config.h>
+#include <musikcore/sdk/IDSP.h>
+#include <musikcore/sdk/IBuffer.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace musik { namespace core { namespace audio {
+
+    /* an ordered set of DSP plugin instances that outlives individual tracks.
+    transports own these and hand them to each Stream they create, so plugins
+    are instantiated once per session (off the audio thread), and filter state
+    carries across gapless track boundaries. */
+    class DspChain {
+        public:
+            using Ptr = std::shared_ptr<DspChain>;
+
+            struct Stats {
+                size_t index;
+                uint64_t buffers;
+                uint64_t totalMicros;
+                uint64_t maxMicros;
+            };
+
+            DspChain();
+            DspChain(const DspChain&) = delete;
+            DspChain& operator=(const DspChain&) = delete;
+
+            void Process(musik::core::sdk::IBuffer* buffer);
+
+            void Attach();
+            void Detach();
+            bool Attached() const noexcept { return this->attached > 0; }
+
+            size_t Count() const noexcept { return this->dsps.size(); }
+            std::vector<Stats> GetStats();
+
+            /* called when DSP plugins are enabled, disabled, or reconfigured.
+            existing chains keep running, but report themselves as stale so
+            transports replace them the next time they create a stream. */
+            static void Invalidate();
+            bool Stale() const noexcept;
+
+        private:
+            void LogStats();
+
+            struct Timing {
+                std::atomic<uint64_t> buffers{ 0 };
+                std::atomic<uint64_t> totalMicros{ 0 };
+                std::atomic<uint64_t> maxMicros{ 0 };
+            };
+
+            using DspPtr = std::shared_ptr<musik::core::sdk::IDSP>;
+
+            std::vector<DspPtr> dsps;
+            std::unique_ptr<Timing[]> timings;
+            std::mutex processMutex;
+            std::chrono::steady_clock::time_point lastLogged;
+            std::atomic<int> attached;
+            int generation;
+    };
+
+} } }
@@ -38,10 +38,17 @@
 #include <musikcore/audio/GaplessTransport.h>
 #include <musikcore/plugin/PluginFactory.h>
 #include <musikcore/audio/Outputs.h>
+#include <musikcore/support/Trace.h>
+#include <musikcore/support/Preferences.h>
+#include <musikcore/support/PreferenceKeys.h>
 #include <algorithm>
 
+#define PREFILL_NEXT_TRACK_MIXPOINT 1002
+
 using namespace musik::core::audio;
 using namespace musik::core::sdk;
+using namespace musik::core::prefs;
+using musik::core::Preferences;
 
 static std::string TAG = "GaplessTransport";
 
@@ -51,8 +58,13 @@ GaplessTransport::GaplessTransport()
 , activePlayer(nullptr)
 , nextPlayer(nullptr)
 , nextCanStart(false)
+, prefillDeferred(false)
 , muted(false) {
     this->output = outputs::SelectedOutput();
+
+    auto prefs = Preferences::ForComponent(components::Playback);
+    this->prefillSeconds = std::max(0.0, prefs->GetDouble(keys::GaplessPrefillSeconds, 3.0));
+    this->prefillLeadSeconds = std::max(0.0, prefs->GetDouble(keys::GaplessPrefillLeadSeconds, 15.0));
 }
 
 GaplessTransport::~GaplessTransport() {
@@ -83,8 +95,12 @@ void GaplessTransport::PrepareNextTrack(const std::string& uri, Gain gain) {
                 uri,
                 this->output, Player::DestroyMode::NoDrain,
                 this,
-                gain);
+                gain,
+                this->GetDspChain());
             startNext = this->nextCanStart;
+            if (!startNext) {
+                this->SchedulePrefill();
+            }
         }
     }
 
@@ -93,17 +109,64 @@ void GaplessTransport::PrepareNextTrack(const std::string& uri, Gain gain) {
     }
 }
 
+/* the next player opens its stream as soon as it's created, but decoding the
+first few seconds of it is deferred until the active track is within the lead
+time of its end. that way slow storage or decoder warm-up can't open a gap
+at the transition, and we don't sit on a full prefill for the whole track. */
+void GaplessTransport::SchedulePrefill() {
+    LockT lock(this->stateMutex);
+
+    this->prefillDeferred = false;
+
+    if (!this->nextPlayer || this->prefillSeconds <= 0.0) {
+        return;
+    }
+
+    if (this->activePlayer) {
+        /* the active track's duration isn't known until its stream is open.
+        try again once it is; see OnPlayerBuffered(). */
+        if (this->activePlayer->GetStreamState() == StreamState::Buffering) {
+            this->prefillDeferred = true;
+            return;
+        }
+
+        const double duration = this->activePlayer->GetDuration();
+        const double at = duration - this->prefillLeadSeconds;
+        if (duration > 0.0 && at > this->activePlayer->GetPosition()) {
+            this->activePlayer->AddMixPoint(PREFILL_NEXT_TRACK_MIXPOINT, at);
+            return;
+        }
+    }
+
+    /* unknown duration, or we're already inside the lead time */
+    this->nextPlayer->Prefill(this->prefillSeconds);
+}
+
 void GaplessTransport::Start(const std::string& uri, Gain gain, StartMode mode) {
+    trace::Span span("GaplessTransport::Start");
     musik::debug::info(TAG, "starting track at " + uri);
     Player* newPlayer = Player::Create(
         uri,
         this->output,
         Player::DestroyMode::NoDrain,
         this,
-        gain);
+        gain,
+        this->GetDspChain());
     this->StartWithPlayer(newPlayer, mode);
 }
 
+DspChain::Ptr GaplessTransport::GetDspChain() {
+    /* one chain for every track we play: plugins are created once, and their
+    state flows from one track into the next. if the plugins were changed
+    since, the tracks we're already playing finish with the old chain, and
+    the new one takes over at the next track boundary. */
+    LockT lock(this->stateMutex);
+    if (!this->dsps || this->dsps->Stale()) {
+        this->dsps = std::make_shared<DspChain>();
+    }
+    return this->dsps;
+}
+
 void GaplessTransport::StartWithPlayer(Player* newPlayer, StartMode mode) {
     if (newPlayer) {
         bool playingNext = false;
@@ -115,6 +178,9 @@ void GaplessTransport::StartWithPlayer(Player* newPlayer, StartMode mode) {
             if (newPlayer != nextPlayer) {
                 this->ResetNextPlayer();
             }
+            else if (this->activePlayer) {
+                newPlayer->ExpectHandoff(); /* measures the gap, if any */
+            }
 
             this->ResetActivePlayer();
 
@@ -290,6 +356,13 @@ void GaplessTransport::SetNextCanStart(bool nextCanStart) {
 }
 
 void GaplessTransport::OnPlayerBuffered(Player* player) {
+    {
+        LockT lock(this->stateMutex);
+        if (player == this->activePlayer && this->prefillDeferred) {
+            this->SchedulePrefill();
+        }
+    }
+
     if (player == this->activePlayer) {
         this->RaiseStreamEvent(StreamState::Buffered, player);
         this->SetPlaybackState(PlaybackState::Prepared);
@@ -376,6 +449,15 @@ void GaplessTransport::OnPlayerDestroying(Player *player) {
     }
 }
 
+void GaplessTransport::OnPlayerMixPoint(Player* player, int id, double time) {
+    if (id == PREFILL_NEXT_TRACK_MIXPOINT) {
+        LockT lock(this->stateMutex);
+        if (player == this->activePlayer && this->nextPlayer) {
+            this->nextPlayer->Prefill(this->prefillSeconds);
+        }
+    }
+}
+
 void GaplessTransport::SetPlaybackState(PlaybackState state) {
     bool changed = false;
 
@@ -99,9 +99,12 @@ namespace musik { namespace core { namespace audio {
             void OnPlayerFinished(Player* player) override;
             void OnPlayerOpenFailed(Player* player) override;
             void OnPlayerDestroying(Player* player) override;
+            void OnPlayerMixPoint(Player* player, int id, double time) override;
 
             void ResetActivePlayer();
             void ResetNextPlayer();
+            void SchedulePrefill();
+            DspChain::Ptr GetDspChain();
 
             musik::core::sdk::PlaybackState playbackState;
             musik::core::sdk::StreamState activePlayerState;
@@ -109,8 +112,12 @@ namespace musik { namespace core { namespace audio {
             std::shared_ptr<musik::core::sdk::IOutput> output;
             Player* activePlayer;
             Player* nextPlayer;
+            DspChain::Ptr dsps;
+            double prefillSeconds;
+            double prefillLeadSeconds;
             double volume;
             bool nextCanStart;
+            bool prefillDeferred;
             bool muted;
     };
 
@@ -55,6 +55,8 @@ namespace musik { namespace core { namespace audio {
             virtual void Interrupt() = 0;
             virtual int GetCapabilities() = 0;
             virtual bool Eof() = 0;
+            virtual bool Prefill(double seconds) = 0;
+            virtual double BufferFill() = 0;
             virtual void Release() = 0;
     };
 
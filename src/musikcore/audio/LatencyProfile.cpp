@@ -0,0 +1,131 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "pch.hpp"
+
+#include <musikcore/audio/LatencyProfile.h>
+#include <musikcore/debug.h>
+#include <musikcore/support/Preferences.h>
+#include <musikcore/support/PreferenceKeys.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+using namespace musik::core::audio;
+using namespace musik::core::prefs;
+using musik::core::Preferences;
+
+#define TAG "LatencyProfile"
+
+/* this many underruns within the window bumps the profile up one level */
+static const int kUnderrunThreshold = 3;
+static const int64_t kUnderrunWindowMs = 30 * 1000;
+
+static std::mutex stateMutex;
+static int configured = -1;
+static int escalation = 0;
+static int recentUnderruns = 0;
+static int64_t windowStartMs = 0;
+
+static int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static LatencyProfile::Settings settingsFor(LatencyProfile::Type type) {
+    switch (type) {
+        case LatencyProfile::Type::LowLatency: return { type, 512, 1.0 };
+        case LatencyProfile::Type::PowerSaving: return { type, 8192, 10.0 };
+        default: return { LatencyProfile::Type::Balanced, 2048, 5.0 };
+    }
+}
+
+/* must be called with stateMutex held. if the user picked a different profile
+since we last looked, forget about any automatic adjustments. */
+static int effectiveLevel() {
+    auto prefs = Preferences::ForComponent(components::Playback);
+    const int current = std::max(0, std::min((int) LatencyProfile::Type::PowerSaving,
+        prefs->GetInt(keys::LatencyProfile, (int) LatencyProfile::Type::Balanced)));
+
+    if (current != configured) {
+        configured = current;
+        escalation = 0;
+        recentUnderruns = 0;
+    }
+
+    return std::min((int) LatencyProfile::Type::PowerSaving, configured + escalation);
+}
+
+LatencyProfile::Settings LatencyProfile::Current() {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    return settingsFor(static_cast<Type>(effectiveLevel()));
+}
+
+void LatencyProfile::ReportUnderrun() {
+    std::unique_lock<std::mutex> lock(stateMutex);
+
+    const int level = effectiveLevel();
+    const int64_t now = nowMs();
+
+    if (now - windowStartMs > kUnderrunWindowMs) {
+        windowStartMs = now;
+        recentUnderruns = 0;
+    }
+
+    ++recentUnderruns;
+
+    musik::debug::warning(TAG, u8fmt(
+        "output underrun with profile %s (%d recently)",
+        Name(static_cast<Type>(level)),
+        recentUnderruns));
+
+    if (recentUnderruns >= kUnderrunThreshold && level < (int) Type::PowerSaving) {
+        ++escalation;
+        recentUnderruns = 0;
+        windowStartMs = now;
+        musik::debug::warning(TAG, u8fmt(
+            "too many underruns; new streams will use profile %s",
+            Name(static_cast<Type>(level + 1))));
+    }
+}
+
+const char* LatencyProfile::Name(Type type) {
+    switch (type) {
+        case Type::LowLatency: return "low-latency";
+        case Type::PowerSaving: return "power-saving";
+        default: return "balanced";
+    }
+}
@@ -36,6 +36,7 @@
 
 #include "PlaybackService.h"
 
+#include <musikcore/audio/DspChain.h>
 #include <musikcore/audio/MasterTransport.h>
 #include <musikcore/library/LocalLibraryConstants.h>
 #include <musikcore/library/track/Track.h>
@@ -46,6 +47,7 @@
 #include <musikcore/support/PreferenceKeys.h>
 #include <musikcore/support/Playback.h>
 #include <musikcore/support/LastFm.h>
+#include <musikcore/support/Trace.h>
 
 using namespace musik::core::library;
 using namespace musik::core;
@@ -65,6 +67,10 @@ using Editor = PlaybackService::Editor;
 
 #define PREVIOUS_GRACE_PERIOD 2.0f
 
+/* below this many pending edits we always persist just the edits, even if
+the queue itself is smaller. */
+#define MIN_QUEUE_EDITS_BEFORE_REWRITE (size_t) 64
+
 #define MESSAGE_STREAM_EVENT 1000
 #define MESSAGE_PLAYBACK_EVENT 1001
 #define MESSAGE_PREPARE_NEXT_TRACK 1002
@@ -149,6 +155,7 @@ PlaybackService::PlaybackService(
 , transport(transport)
 , playlist(library)
 , unshuffled(library)
+, queueEditsValid(false)
 , repeatMode(RepeatMode::None)
 , messageQueue(messageQueue)
 , timeChangeMode(TimeChangeMode::Seek)
@@ -276,6 +283,7 @@ void PlaybackService::ToggleShuffle() {
 
     this->playlist.ClearCache();
     this->unshuffled.ClearCache();
+    this->InvalidateQueueEdits();
     bool shuffled = false;
 
     if (this->unshuffled.Count() > 0) { /* shuffled -> unshuffled */
@@ -458,6 +466,9 @@ void PlaybackService::ProcessMessage(IMessage &message) {
         }
     }
     else if (type == MESSAGE_RELOAD_OUTPUT) {
+        /* settings that require an output reload may also affect DSPs */
+        DspChain::Invalidate();
+
         const auto state = this->GetPlaybackState();
         const auto index = this->GetIndex();
         const double time = this->GetPosition();
@@ -645,6 +656,7 @@ bool PlaybackService::HotSwap(const TrackList& tracks, size_t index) {
         temp.CopyFrom(tracks);
         this->playlist.Swap(temp);
         this->unshuffled.Clear();
+        this->InvalidateQueueEdits();
         this->index = found ? index : NO_POSITION;
         this->nextIndex = NO_POSITION;
     }
@@ -667,6 +679,7 @@ void PlaybackService::Play(const TrackList& tracks, size_t index) {
             temp.CopyFrom(tracks);
             this->playlist.Swap(temp);
             this->unshuffled.Clear();
+            this->InvalidateQueueEdits();
         }
     }
 
@@ -717,6 +730,7 @@ void PlaybackService::CopyFrom(const TrackList& source) {
     std::unique_lock<std::recursive_mutex> lock(this->playlistMutex);
 
     this->playlist.CopyFrom(source);
+    this->InvalidateQueueEdits();
     this->index = NO_POSITION;
     this->nextIndex = NO_POSITION;
 
@@ -745,6 +759,7 @@ void PlaybackService::CopyFrom(const musik::core::sdk::ITrackList* source) {
         for (size_t i = 0; i < source->Count(); i++) {
             this->playlist.Add(source->GetId(i));
         }
+        this->InvalidateQueueEdits();
 
         this->index = NO_POSITION;
         this->nextIndex = NO_POSITION;
@@ -758,7 +773,48 @@ void PlaybackService::CopyFrom(const musik::core::sdk::ITrackList* source) {
     }
 }
 
+bool PlaybackService::TakeQueueEdits(QueueEdits& edits, TrackList& tracks) {
+    std::unique_lock<std::recursive_mutex> lock(this->playlistMutex);
+
+    if (this->queueEditsValid) {
+        edits.swap(this->queueEdits);
+        this->queueEdits.clear();
+        return true;
+    }
+
+    tracks.CopyFrom(this->playlist);
+    this->ResetQueueEdits();
+    return false;
+}
+
+void PlaybackService::ResetQueueEdits() {
+    std::unique_lock<std::recursive_mutex> lock(this->playlistMutex);
+    this->queueEdits.clear();
+    this->queueEditsValid = true;
+}
+
+void PlaybackService::RecordQueueEdit(QueueEdit::Type type, int64_t a, int64_t b) {
+    std::unique_lock<std::recursive_mutex> lock(this->playlistMutex);
+    if (this->queueEditsValid) {
+        /* past this point it's cheaper to just rewrite the whole thing */
+        if (this->queueEdits.size() >= std::max(MIN_QUEUE_EDITS_BEFORE_REWRITE, this->playlist.Count())) {
+            this->InvalidateQueueEdits();
+        }
+        else {
+            this->queueEdits.push_back({ type, a, b });
+        }
+    }
+}
+
+void PlaybackService::InvalidateQueueEdits() {
+    std::unique_lock<std::recursive_mutex> lock(this->playlistMutex);
+    this->queueEdits.clear();
+    this->queueEditsValid = false;
+}
+
 void PlaybackService::PlayAt(size_t index, ITransport::StartMode mode) {
+    trace::Span span("PlaybackService::Play", (int64_t) index);
+
     index = std::min(this->Count(), index);
 
     std::string uri = this->UriAtIndex(index);
@@ -1028,6 +1084,8 @@ PlaybackService::Editor::~Editor() {
 
 bool PlaybackService::Editor::Insert(int64_t id, size_t index) {
     if ((this->edited = this->tracks->Insert(id, index))) {
+        playback.RecordQueueEdit(QueueEdit::Type::Insert, id, (int64_t) index);
+
         if (index == this->playIndex) {
             ++this->playIndex;
         }
@@ -1043,6 +1101,8 @@ bool PlaybackService::Editor::Insert(int64_t id, size_t index) {
 
 bool PlaybackService::Editor::Swap(size_t index1, size_t index2) {
     if ((this->edited = this->tracks->Swap(index1, index2))) {
+        playback.RecordQueueEdit(QueueEdit::Type::Swap, (int64_t) index1, (int64_t) index2);
+
         if (index1 == this->playIndex) {
             this->playIndex = index2;
             this->nextTrackInvalidated = true;
@@ -1059,6 +1119,8 @@ bool PlaybackService::Editor::Swap(size_t index1, size_t index2) {
 
 bool PlaybackService::Editor::Move(size_t from, size_t to) {
     if ((this->edited = this->tracks->Move(from, to))) {
+        playback.RecordQueueEdit(QueueEdit::Type::Move, (int64_t) from, (int64_t) to);
+
         if (from == this->playIndex) {
             this->playIndex = to;
         }
@@ -1077,6 +1139,8 @@ bool PlaybackService::Editor::Move(size_t from, size_t to) {
 
 bool PlaybackService::Editor::Delete(size_t index) {
     if ((this->edited = this->tracks->Delete(index))) {
+        playback.RecordQueueEdit(QueueEdit::Type::Delete, (int64_t) index);
+
         if (this->playback.Count() == 0) {
             this->playIndex = NO_POSITION;
         }
@@ -1096,6 +1160,7 @@ bool PlaybackService::Editor::Delete(size_t index) {
 
 void PlaybackService::Editor::Add(const int64_t id) {
     this->tracks->Add(id);
+    playback.RecordQueueEdit(QueueEdit::Type::Add, id);
 
     if (this->playback.Count() - 1 == this->playIndex + 1) {
         this->nextTrackInvalidated = true;
@@ -1107,6 +1172,7 @@ void PlaybackService::Editor::Add(const int64_t id) {
 void PlaybackService::Editor::Clear() {
     playback.playlist.Clear();
     playback.unshuffled.Clear();
+    playback.RecordQueueEdit(QueueEdit::Type::Clear);
     this->playIndex = -1;
     this->nextTrackInvalidated = true;
     this->edited = true;
@@ -133,6 +133,30 @@ namespace musik { namespace core { namespace audio {
                     &this->playlist, [](const musik::core::TrackList*) {});
             }
 
+            /* edits made to the play queue since it was last persisted; used by
+            PersistedPlayQueueQuery to save only what changed. */
+            struct QueueEdit {
+                enum class Type : int {
+                    Add = 1, Insert = 2, Swap = 3, Move = 4, Delete = 5, Clear = 6
+                };
+                Type type;
+                int64_t a, b;
+            };
+
+            using QueueEdits = std::vector<QueueEdit>;
+
+            /* moves pending edits into `edits` and returns true, or, if they can't
+            be replayed against what was last persisted (the queue was replaced or
+            shuffled), copies the whole queue into `tracks` and returns false. */
+            bool TakeQueueEdits(QueueEdits& edits, musik::core::TrackList& tracks);
+
+            /* the play queue and its persisted form are now the same. */
+            void ResetQueueEdits();
+
+            /* the persisted form can no longer be patched with edits (e.g. a
+            save failed); the next save rewrites the whole queue. */
+            void InvalidateQueueEdits();
+
             /* required to make changes to the playlist. this little data structure
             privately owns a lock to the internal data structure and will release
             that lock when it's destructed. */
@@ -192,6 +216,8 @@ namespace musik { namespace core { namespace audio {
 
             void PlayAt(size_t index, ITransport::StartMode mode);
 
+            void RecordQueueEdit(QueueEdit::Type type, int64_t a = 0, int64_t b = 0);
+
             musik::core::TrackPtr TrackAtIndexWithTimeout(size_t index);
 
             std::string UriAtIndex(size_t index);
@@ -200,6 +226,8 @@ namespace musik { namespace core { namespace audio {
             musik::core::TrackList playlist;
             musik::core::TrackList unshuffled;
             std::recursive_mutex playlistMutex;
+            QueueEdits queueEdits;
+            bool queueEditsValid;
 
             std::vector<std::shared_ptr<musik::core::sdk::IPlaybackRemote>> remotes;
             std::shared_ptr<musik::core::Preferences> playbackPrefs;
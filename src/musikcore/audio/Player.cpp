@@ -38,15 +38,22 @@
 #include <musikcore/debug.h>
 #include <musikcore/audio/Stream.h>
 #include <musikcore/audio/Player.h>
+#include <musikcore/audio/LatencyProfile.h>
 #include <musikcore/audio/Visualizer.h>
+#include <musikcore/io/IoScheduler.h>
 #include <musikcore/plugin/PluginFactory.h>
 #include <musikcore/sdk/constants.h>
+#include <musikcore/sdk/IOutputStats.h>
+#include <musikcore/support/Trace.h>
 
 #include <algorithm>
 #include <math.h>
 #include <future>
+#include <deque>
+#include <unordered_map>
 
 #define MAX_PREBUFFER_QUEUE_COUNT 8
+#define MAX_IDLE_PLAYER_WORKERS 4
 #define FFT_N 512
 #define PI 3.14159265358979323846
 
@@ -103,6 +110,128 @@ namespace musik {
                 float* deinterleaved;
                 kiss_fft_cpx* scratch;
             };
+
+            /* players are short-lived -- transports create one per track -- and
+            spinning up a new thread for each one adds latency when skipping
+            quickly through a queue. instead, players are run by a set of
+            persistent workers that park themselves when their player finishes. */
+            class PlayerWorkerPool {
+                public:
+                    void Run(Player* player) {
+                        std::unique_lock<std::mutex> lock(this->mutex);
+                        this->queue.push_back(player);
+                        if (this->idle < (int) this->queue.size()) {
+                            ++this->idle; /* new workers start out idle */
+                            std::thread(&PlayerWorkerPool::WorkerLoop, this).detach();
+                        }
+                        this->condition.notify_one();
+                    }
+
+                private:
+                    void WorkerLoop() {
+                        std::unique_lock<std::mutex> lock(this->mutex);
+                        while (true) {
+                            while (!this->queue.size()) {
+                                if (this->idle > MAX_IDLE_PLAYER_WORKERS) {
+                                    --this->idle;
+                                    return;
+                                }
+                                this->condition.wait(lock);
+                            }
+
+                            Player* player = this->queue.front();
+                            this->queue.pop_front();
+                            --this->idle;
+
+                            lock.unlock();
+                            playerThreadLoop(player);
+                            lock.lock();
+
+                            ++this->idle;
+                        }
+                    }
+
+                    std::mutex mutex;
+                    std::condition_variable condition;
+                    std::deque<Player*> queue;
+                    int idle{ 0 };
+            };
+
+            /* counts the buffers each output holds on behalf of any player,
+            and when it last ran out of them. players take turns on a shared
+            output during gapless playback, so this is what lets the incoming
+            player tell whether the output ran dry during the hand-off.
+            entries live as long as some player uses the output, or it still
+            holds buffers, so a new output at a reused address starts fresh. */
+            class OutputActivity {
+                public:
+                    void Attach(IOutput* output) {
+                        std::unique_lock<std::mutex> lock(this->mutex);
+                        ++this->outputs[output].players;
+                    }
+
+                    void Detach(IOutput* output) {
+                        std::unique_lock<std::mutex> lock(this->mutex);
+                        auto it = this->outputs.find(output);
+                        if (it != this->outputs.end()) {
+                            --it->second.players;
+                            this->Prune(it);
+                        }
+                    }
+
+                    /* returns the time (trace::Now()) the output last ran out of
+                    buffers, or 0 if it still has some. */
+                    uint64_t Queued(IOutput* output) {
+                        std::unique_lock<std::mutex> lock(this->mutex);
+                        auto& entry = this->outputs[output];
+                        const uint64_t idleSince = entry.pending ? 0 : entry.idleSince;
+                        ++entry.pending;
+                        return idleSince;
+                    }
+
+                    void Processed(IOutput* output) {
+                        std::unique_lock<std::mutex> lock(this->mutex);
+                        auto it = this->outputs.find(output);
+                        if (it != this->outputs.end()) {
+                            auto& entry = it->second;
+                            if (entry.pending > 0 && --entry.pending == 0) {
+                                entry.idleSince = trace::Now();
+                            }
+                            this->Prune(it);
+                        }
+                    }
+
+                private:
+                    struct Entry {
+                        int players{ 0 };
+                        int pending{ 0 };
+                        uint64_t idleSince{ 0 };
+                    };
+
+                    using Map = std::unordered_map<IOutput*, Entry>;
+
+                    /* must be called with the lock held */
+                    void Prune(Map::iterator it) {
+                        if (it->second.players <= 0 && it->second.pending <= 0) {
+                            this->outputs.erase(it);
+                        }
+                    }
+
+                    std::mutex mutex;
+                    Map outputs;
+            };
+
+            static OutputActivity& Activity() {
+                static OutputActivity* activity = new OutputActivity();
+                return *activity;
+            }
+
+            /* intentionally leaked: workers are detached and may still be
+            parked on the condition when static destructors run. */
+            static PlayerWorkerPool& WorkerPool() {
+                static PlayerWorkerPool* pool = new PlayerWorkerPool();
+                return *pool;
+            }
         }
     }
 }
@@ -112,9 +241,21 @@ Player* Player::Create(
     std::shared_ptr<IOutput> output,
     DestroyMode destroyMode,
     EventListener *listener,
-    Gain gain)
+    Gain gain,
+    DspChain::Ptr dsps)
 {
-    return new Player(url, output, destroyMode, listener, gain);
+    trace::Span span("Player::Create");
+    return new Player(url, output, destroyMode, listener, gain, dsps);
+}
+
+/* buffer sizes come from the current latency profile */
+static IStreamPtr createStream(DspChain::Ptr dsps) {
+    const auto profile = LatencyProfile::Current();
+    return Stream::Create(
+        profile.samplesPerChannel,
+        profile.bufferLengthSeconds,
+        StreamFlags::None,
+        dsps);
 }
 
 Player::Player(
@@ -122,20 +263,24 @@ Player::Player(
     std::shared_ptr<IOutput> output,
     DestroyMode destroyMode,
     EventListener *listener,
-    Gain gain)
-: internalState(Player::Idle)
-, streamState(StreamState::Buffering)
-, stream(Stream::Create())
+    Gain gain,
+    DspChain::Ptr dsps)
+: destroyRequested(false)
+, output(output)
+, stream(createStream(dsps))
 , url(url)
+, nextMixPoint(-1.0)
 , currentPosition(0)
-, output(output)
-, notifiedStarted(false)
 , seekToPosition(-1)
-, nextMixPoint(-1.0)
-, pendingBufferCount(0)
+, prefillSeconds(0.0)
+, handoff(false)
+, streamState(StreamState::Buffering)
+, internalState(Player::Idle)
+, notifiedStarted(false)
 , destroyMode(destroyMode)
-, fftContext(nullptr)
-, gain(gain) {
+, gain(gain)
+, pendingBufferCount(0)
+, fftContext(nullptr) {
     musik::debug::info(TAG, "new instance created");
 
     this->spectrum = new float[FFT_N / 2];
@@ -148,11 +293,15 @@ Player::Player(
         listeners.push_back(listener);
     }
 
-    /* each player instance is driven by a background thread. start it. */
-    this->thread = new std::thread(std::bind(&musik::core::audio::playerThreadLoop, this));
+    Activity().Attach(this->output.get());
+
+    /* each player instance is driven by a background thread. hand it off to
+    the worker pool. */
+    WorkerPool().Run(this);
 }
 
 Player::~Player() {
+    Activity().Detach(this->output.get());
     delete[] this->spectrum;
     delete fftContext;
 }
@@ -166,6 +315,24 @@ void Player::Play() {
     }
 }
 
+/* asks an idle player to decode the first `seconds` of its stream ahead of
+time, so a gapless transition doesn't wait on the decoder (or slow storage). */
+void Player::Prefill(double seconds) {
+    std::unique_lock<std::mutex> lock(this->queueMutex);
+
+    if (this->internalState == Player::Idle && seconds > this->prefillSeconds.load()) {
+        this->prefillSeconds.store(seconds);
+        this->writeToOutputCondition.notify_all();
+    }
+}
+
+/* tells the player it's taking over an output another player is still feeding,
+i.e. a gapless transition. when it writes its first buffer it checks whether
+the output ran out of audio in between, and reports how long for. */
+void Player::ExpectHandoff() {
+    this->handoff.store(true);
+}
+
 void Player::Destroy() {
     {
         if (this->stream) {
@@ -174,15 +341,13 @@ void Player::Destroy() {
 
         std::unique_lock<std::mutex> lock(this->queueMutex);
 
-        if (this->internalState == Player::Quit && !this->thread) {
+        if (this->internalState == Player::Quit && this->destroyRequested) {
             return; /* already terminated (or terminating) */
         }
 
         this->internalState = Player::Quit;
         this->writeToOutputCondition.notify_all();
-        this->thread->detach();
-        delete this->thread;
-        this->thread = nullptr;
+        this->destroyRequested = true;
     }
 }
 
@@ -296,20 +461,56 @@ void musik::core::audio::playerThreadLoop(Player* player) {
         gain = player->gain.peak;
     }
 
-    if (player->stream->OpenStream(player->url, player->output.get())) {
+    const int64_t traceId = (int64_t) (intptr_t) player;
+    bool wroteFirstBuffer = false;
+
+    /* false until the output has been handed its first buffer (again, after
+    a seek). while true, finding the output with nothing of ours queued means
+    it ran dry. */
+    bool primed = false;
+
+    /* outputs that count their own underruns catch the ones we can't see
+    from here, e.g. a device cycle that came while a buffer was in flight. */
+    IOutputStats* outputStats = dynamic_cast<IOutputStats*>(player->output.get());
+    uint64_t outputUnderruns = outputStats ? outputStats->Underruns() : 0;
+
+    trace::Begin("Stream::OpenStream", traceId);
+    const bool opened = player->stream->OpenStream(player->url, player->output.get());
+    trace::End("Stream::OpenStream", traceId);
+
+    if (opened) {
         for (Listener* l : player->Listeners()) {
             player->streamState = StreamState::Buffered;
             l->OnPlayerBuffered(player);
         }
 
-        /* wait until we enter the Playing or Quit state */
+        /* wait until we enter the Playing or Quit state. if we're asked to
+        prefill in the meantime, decode ahead one chunk at a time, dropping
+        the lock in between so Play() never waits on the decoder. */
+        double prefilled = 0.0;
         {
             std::unique_lock<std::mutex> lock(player->queueMutex);
             while (player->internalState == Player::Idle) {
+                const double requested = player->prefillSeconds.load();
+                if (requested > prefilled) {
+                    lock.unlock();
+                    const bool more = player->stream->Prefill(requested);
+                    lock.lock();
+                    if (!more) {
+                        prefilled = requested;
+                        musik::debug::info(TAG, u8fmt("prefilled %.2fs of %s", requested, player->url.c_str()));
+                    }
+                    continue;
+                }
                 player->writeToOutputCondition.wait(lock);
             }
         }
 
+        const uint64_t playRequestedAt = trace::Now();
+
+        /* when the output last ran dry, as of our first buffer; see ExpectHandoff() */
+        uint64_t handoffIdleSince = 0;
+
         /* we're ready to go.... */
         bool finished = false;
 
@@ -343,6 +544,7 @@ void musik::core::audio::playerThreadLoop(Player* player) {
 
                 player->stream->SetPosition(seek);
                 player->seekToPosition.exchange(-1.0);
+                primed = false;
             }
 
             /* let's see if we can find some samples to play */
@@ -351,7 +553,24 @@ void musik::core::audio::playerThreadLoop(Player* player) {
 
                 buffer = player->stream->GetNextProcessedOutputBuffer();
 
+                /* let the io scheduler know how far ahead of the output we
+                are, so it can back off background reads if we fall behind. */
+                if (primed && player->internalState == Player::Playing) {
+                    musik::core::io::IoScheduler::Instance().ReportPlaybackBuffer(
+                        player->stream->BufferFill());
+                }
+
                 if (buffer) {
+                    const uint64_t underruns = outputStats ? outputStats->Underruns() : 0;
+
+                    if (primed && player->internalState == Player::Playing &&
+                        (player->pendingBufferCount == 0 || underruns > outputUnderruns))
+                    {
+                        LatencyProfile::ReportUnderrun();
+                    }
+
+                    outputUnderruns = underruns;
+
                     /* apply replay gain, if specified */
                     if (gain != 1.0f) {
                         float* samples = buffer->BufferPointer();
@@ -361,6 +580,11 @@ void musik::core::audio::playerThreadLoop(Player* player) {
                     }
 
                     ++player->pendingBufferCount;
+
+                    const uint64_t idleSince = Activity().Queued(player->output.get());
+                    if (!wroteFirstBuffer) {
+                        handoffIdleSince = idleSince;
+                    }
                 }
             }
 
@@ -370,10 +594,43 @@ void musik::core::audio::playerThreadLoop(Player* player) {
                 /* if this result is negative it's an error code defined by the sdk's
                 OutputPlay enum. if it's a positive number it's the number of milliseconds
                 we should wait until automatically trying to play the buffer again. */
+                const uint64_t playStart = wroteFirstBuffer ? 0 : trace::Now();
                 OutputState playResult = player->output->Play(buffer, player);
 
+                if (!wroteFirstBuffer && playResult == OutputState::BufferWritten) {
+                    const uint64_t now = trace::Now();
+                    trace::Complete("IOutput::Play (first)", playStart, now - playStart, traceId);
+                    wroteFirstBuffer = true;
+
+                    /* time between being told to play and handing the output
+                    its first buffer. for gapless transitions this is the window
+                    the previous track's queued buffers have to cover. */
+                    musik::debug::info(TAG, u8fmt(
+                        "first buffer written %.2fms after play (%.2fs prefilled)",
+                        (double) (now - playRequestedAt) / 1000.0, prefilled));
+
+                    /* a gapless hand-off should find the output still busy with
+                    the previous track. if it already ran dry, whatever it had
+                    buffered in the device (its latency) played out in the
+                    meantime, and the rest was silence. */
+                    if (player->handoff.load()) {
+                        const double gapMs = handoffIdleSince == 0 ? 0.0 : std::max(0.0,
+                            (double) (now - handoffIdleSince) / 1000.0 - player->output->Latency() * 1000.0);
+                        if (gapMs > 0.0) {
+                            trace::Complete("Player::GaplessGap", handoffIdleSince, now - handoffIdleSince, traceId);
+                            musik::debug::warning(TAG, u8fmt(
+                                "gapless transition to %s left a %.2fms gap (%.2fs prefilled)",
+                                player->url.c_str(), gapMs, prefilled));
+                        }
+                        else {
+                            musik::debug::info(TAG, "gapless transition had no gap");
+                        }
+                    }
+                }
+
                 if (playResult == OutputState::BufferWritten) {
                     buffer = nullptr; /* reset so we pick up a new one next iteration */
+                    primed = true;
                 }
                 else {
                     /* if the buffer was unable to be processed, we'll try again after
@@ -561,6 +818,7 @@ void Player::OnBufferProcessed(IBuffer *buffer) {
         lets the stream know it can be recycled. */
         --pendingBufferCount;
         this->stream->OnBufferProcessedByPlayer((Buffer*)buffer);
+        Activity().Processed(this->output.get());
 
         /* if we're seeking this value will be non-negative, so we shouldn't touch
         the current time. */
@@ -36,6 +36,7 @@
 
 #include <musikcore/config.h>
 #include <musikcore/audio/IStream.h>
+#include <musikcore/audio/DspChain.h>
 #include <musikcore/sdk/constants.h>
 #include <musikcore/sdk/IOutput.h>
 #include <musikcore/sdk/IBufferProvider.h>
@@ -82,7 +83,8 @@ namespace musik { namespace core { namespace audio {
                 std::shared_ptr<musik::core::sdk::IOutput> output,
                 DestroyMode destroyMode,
                 EventListener *listener,
-                Gain gain = Gain());
+                Gain gain = Gain(),
+                DspChain::Ptr dsps = DspChain::Ptr());
 
             virtual void OnBufferProcessed(musik::core::sdk::IBuffer *buffer);
 
@@ -90,6 +92,8 @@ namespace musik { namespace core { namespace audio {
             void Attach(EventListener *listener);
 
             void Play();
+            void Prefill(double seconds);
+            void ExpectHandoff();
             void Destroy();
             void Destroy(DestroyMode mode);
 
@@ -115,7 +119,8 @@ namespace musik { namespace core { namespace audio {
                 std::shared_ptr<musik::core::sdk::IOutput> output,
                 DestroyMode finishMode,
                 EventListener *listener,
-                Gain gain);
+                Gain gain,
+                DspChain::Ptr dsps);
 
             virtual ~Player();
 
@@ -144,7 +149,7 @@ namespace musik { namespace core { namespace audio {
             int State();
             ListenerList Listeners();
 
-            std::thread* thread;
+            bool destroyRequested;
 
             OutputPtr output;
             IStreamPtr stream;
@@ -165,6 +170,8 @@ namespace musik { namespace core { namespace audio {
             double nextMixPoint;
             std::atomic<double> currentPosition;
             std::atomic<double> seekToPosition;
+            std::atomic<double> prefillSeconds;
+            std::atomic<bool> handoff;
             std::atomic<musik::core::sdk::StreamState> streamState;
             std::atomic<int> internalState;
             bool notifiedStarted;
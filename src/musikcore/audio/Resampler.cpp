@@ -0,0 +1,275 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "pch.hpp"
+
+#include <musikcore/audio/Resampler.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #include <xmmintrin.h>
+    #define RESAMPLER_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define RESAMPLER_NEON 1
+#endif
+
+using namespace musik::core::audio;
+
+/* number of fractional positions between two input frames we precompute
+filter coefficients for. we linearly interpolate between adjacent rows. */
+static const int kPhases = 256;
+
+struct FilterSpec {
+    int taps;
+    double rolloff;
+    double beta;
+};
+
+static FilterSpec specFor(Resampler::Quality quality) {
+    switch (quality) {
+        case Resampler::Quality::Fast: return { 16, 0.85, 6.0 };
+        case Resampler::Quality::Best: return { 64, 0.95, 10.0 };
+        default: return { 32, 0.91, 8.0 };
+    }
+}
+
+/* zeroth order modified bessel function of the first kind */
+static double besselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    const double y = x * x / 4.0;
+    for (int k = 1; k < 50 && term > sum * 1e-12; k++) {
+        term *= y / ((double) k * (double) k);
+        sum += term;
+    }
+    return sum;
+}
+
+static double sinc(double x) {
+    if (std::fabs(x) < 1e-9) {
+        return 1.0;
+    }
+    const double px = 3.14159265358979323846 * x;
+    return std::sin(px) / px;
+}
+
+static float dot(const float* a, const float* b, int n) {
+    int i = 0;
+    float result = 0.0f;
+
+#if defined(RESAMPLER_SSE)
+    __m128 sum = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4) {
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    result = _mm_cvtss_f32(sum);
+#elif defined(RESAMPLER_NEON)
+    float32x4_t sum = vdupq_n_f32(0.0f);
+    for (; i + 4 <= n; i += 4) {
+        sum = vmlaq_f32(sum, vld1q_f32(a + i), vld1q_f32(b + i));
+    }
+    float32x2_t half = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+    result = vget_lane_f32(vpadd_f32(half, half), 0);
+#endif
+
+    for (; i < n; i++) {
+        result += a[i] * b[i];
+    }
+
+    return result;
+}
+
+/* out[i] = a[i] + t * (b[i] - a[i]) */
+static void lerp(float* out, const float* a, const float* b, float t, int n) {
+    int i = 0;
+
+#if defined(RESAMPLER_SSE)
+    const __m128 vt = _mm_set1_ps(t);
+    for (; i + 4 <= n; i += 4) {
+        const __m128 va = _mm_loadu_ps(a + i);
+        const __m128 vb = _mm_loadu_ps(b + i);
+        _mm_storeu_ps(out + i, _mm_add_ps(va, _mm_mul_ps(vt, _mm_sub_ps(vb, va))));
+    }
+#elif defined(RESAMPLER_NEON)
+    for (; i + 4 <= n; i += 4) {
+        const float32x4_t va = vld1q_f32(a + i);
+        const float32x4_t vb = vld1q_f32(b + i);
+        vst1q_f32(out + i, vmlaq_n_f32(va, vsubq_f32(vb, va), t));
+    }
+#endif
+
+    for (; i < n; i++) {
+        out[i] = a[i] + t * (b[i] - a[i]);
+    }
+}
+
+Resampler::Resampler(int channels, long inputRate, long outputRate, Quality quality)
+: channels(channels)
+, inputRate(inputRate)
+, outputRate(outputRate)
+, historyFrames(0)
+, window(0)
+, fraction(0) {
+    const FilterSpec spec = specFor(quality);
+    this->taps = spec.taps;
+
+    /* when downsampling the cutoff has to move below the new nyquist */
+    const double ratio = std::min(1.0, (double) outputRate / (double) inputRate);
+    const double cutoff = spec.rolloff * ratio;
+    const double half = (double) (this->taps / 2);
+    const double norm = besselI0(spec.beta);
+
+    /* row `p` holds the coefficients for an output frame `p / kPhases` of the
+    way between input frames. the extra row lets us interpolate past the last
+    phase without a special case. */
+    this->table.resize((kPhases + 1) * this->taps);
+    for (int p = 0; p <= kPhases; p++) {
+        float* row = this->table.data() + p * this->taps;
+        const double offset = (double) p / (double) kPhases;
+        double sum = 0.0;
+        for (int k = 0; k < this->taps; k++) {
+            const double x = (double) k - (half - 1.0) - offset;
+            const double r = x / half;
+            const double w = (r <= -1.0 || r >= 1.0)
+                ? 0.0 : besselI0(spec.beta * std::sqrt(1.0 - r * r)) / norm;
+            const double value = cutoff * sinc(cutoff * x) * w;
+            row[k] = (float) value;
+            sum += value;
+        }
+        /* unity gain at dc for every phase */
+        for (int k = 0; k < this->taps; k++) {
+            row[k] = (float) (row[k] / sum);
+        }
+    }
+
+    this->coefficients.resize(this->taps);
+    this->history.resize(channels);
+    this->Reset();
+}
+
+void Resampler::Reset() {
+    /* prime with enough silence that the first output frame is centered on
+    the first input frame. */
+    this->historyFrames = this->taps / 2 - 1;
+    for (auto& channel : this->history) {
+        channel.assign(std::max((size_t) this->historyFrames, channel.size()), 0.0f);
+    }
+    this->window = 0;
+    this->fraction = 0;
+}
+
+void Resampler::Append(const float* input, int frames) {
+    const size_t required = (size_t) (this->historyFrames + frames);
+    for (int c = 0; c < this->channels; c++) {
+        auto& channel = this->history[c];
+        if (channel.size() < required) {
+            channel.resize(required);
+        }
+        float* dst = channel.data() + this->historyFrames;
+        const float* src = input + c;
+        for (int i = 0; i < frames; i++) {
+            dst[i] = *src;
+            src += this->channels;
+        }
+    }
+    this->historyFrames += frames;
+}
+
+int Resampler::Drain(Buffer* output) {
+    output->SetChannels(this->channels);
+    output->SetSampleRate(this->outputRate);
+
+    /* upper bound on the number of frames we can produce */
+    const long positions = std::max(0, this->historyFrames - this->taps - this->window + 1);
+    const long perPosition = (this->outputRate + this->inputRate - 1) / this->inputRate;
+    output->SetSamples((positions * perPosition + 1) * this->channels);
+
+    float* dst = output->BufferPointer();
+    const float* rows = this->table.data();
+    float* coefficients = this->coefficients.data();
+    int produced = 0;
+
+    while (this->window + this->taps <= this->historyFrames) {
+        const double phase = (double) this->fraction * kPhases / (double) this->outputRate;
+        const int row = std::min((int) phase, kPhases - 1);
+        lerp(
+            coefficients,
+            rows + row * this->taps,
+            rows + (row + 1) * this->taps,
+            (float) (phase - row),
+            this->taps);
+
+        for (int c = 0; c < this->channels; c++) {
+            *dst++ = dot(this->history[c].data() + this->window, coefficients, this->taps);
+        }
+
+        ++produced;
+
+        this->fraction += this->inputRate;
+        this->window += (int) (this->fraction / this->outputRate);
+        this->fraction %= this->outputRate;
+    }
+
+    /* slide the unconsumed tail to the front; this is always less than one
+    filter's worth of frames. */
+    const int consumed = std::min(this->window, this->historyFrames);
+    if (consumed > 0) {
+        const int remain = this->historyFrames - consumed;
+        for (auto& channel : this->history) {
+            memmove(channel.data(), channel.data() + consumed, remain * sizeof(float));
+        }
+        this->historyFrames = remain;
+        this->window -= consumed;
+    }
+
+    output->SetSamples(produced * this->channels);
+    return produced;
+}
+
+int Resampler::Process(const float* input, int frames, Buffer* output) {
+    if (frames > 0) {
+        this->Append(input, frames);
+    }
+    return this->Drain(output);
+}
+
+int Resampler::Flush(Buffer* output) {
+    std::vector<float> silence((this->taps / 2) * this->channels, 0.0f);
+    return this->Process(silence.data(), this->taps / 2, output);
+}
@@ -0,0 +1,96 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <musikcore/config.h>
+#include <musikcore/audio/Buffer.h>
+
+#include <memory>
+#include <vector>
+
+namespace musik { namespace core { namespace audio {
+
+    /* converts interleaved float audio from one sample rate to another using a
+    windowed-sinc polyphase filter. used by Stream so every track reaches the
+    output at a single, fixed rate, regardless of what the decoder produces. */
+    class Resampler {
+        public:
+            using Ptr = std::shared_ptr<Resampler>;
+
+            /* higher quality means more filter taps, a steeper rolloff, and
+            more cpu time. */
+            enum class Quality : int {
+                Fast = 0,
+                Balanced = 1,
+                Best = 2
+            };
+
+            Resampler(int channels, long inputRate, long outputRate, Quality quality);
+            Resampler(const Resampler&) = delete;
+            Resampler& operator=(const Resampler&) = delete;
+
+            /* resamples `frames` interleaved frames from `input`, replacing the
+            contents of `output`. returns the number of frames written, which
+            may be zero while the filter is filling. */
+            int Process(const float* input, int frames, Buffer* output);
+
+            /* pushes the samples still held by the filter through to `output`.
+            call once after the last Process() call for a stream. */
+            int Flush(Buffer* output);
+
+            /* discards filter history; used after a seek. */
+            void Reset();
+
+            int Channels() const noexcept { return this->channels; }
+            long InputRate() const noexcept { return this->inputRate; }
+            long OutputRate() const noexcept { return this->outputRate; }
+
+        private:
+            void Append(const float* input, int frames);
+            int Drain(Buffer* output);
+
+            int channels;
+            long inputRate;
+            long outputRate;
+            int taps;
+            std::vector<float> table; /* (phases + 1) rows of `taps` coefficients */
+            std::vector<float> coefficients; /* interpolated row, reused per frame */
+            std::vector<std::vector<float>> history; /* planar, one per channel */
+            int historyFrames;
+            int window; /* offset of the filter window into `history` */
+            long fraction; /* output position between input frames, in 1/outputRate units */
+    };
+
+} } }
@@ -37,16 +37,22 @@
 #include "Stream.h"
 #include "Streams.h"
 #include <musikcore/debug.h>
+#include <musikcore/io/PrefetchDataStream.h>
+#include <musikcore/support/Trace.h>
+#include <musikcore/support/Preferences.h>
+#include <musikcore/support/PreferenceKeys.h>
 
 using namespace musik::core::audio;
 using namespace musik::core::sdk;
 using namespace musik::core::io;
+using namespace musik::core::prefs;
+using musik::core::Preferences;
 
 static std::string TAG = "Stream";
 
 #define MIN_BUFFER_COUNT 30
 
-Stream::Stream(int samplesPerChannel, double bufferLengthSeconds, StreamFlags options)
+Stream::Stream(int samplesPerChannel, double bufferLengthSeconds, StreamFlags options, DspChain::Ptr dsps)
 : options(options)
 , samplesPerChannel(samplesPerChannel)
 , bufferLengthSeconds(bufferLengthSeconds)
@@ -58,34 +64,42 @@ Stream::Stream(int samplesPerChannel, double bufferLengthSeconds, StreamFlags op
 , decoderSamplesRemain(0)
 , done(false)
 , capabilities(0)
-, rawBuffer(nullptr) {
+, resamplerQuality(Resampler::Quality::Balanced)
+, targetSampleRate(0)
+, resamplerFlushed(false) {
+    /* streams normally share their owner's DspChain; if we weren't given one
+    we create a private chain, which is only used for this track. */
     if (((int) this->options & (int) StreamFlags::NoDSP) == 0) {
-        dsps = streams::GetDspPlugins();
+        this->dsps = dsps ? dsps : std::make_shared<DspChain>();
+        this->dsps->Attach();
     }
 
     this->decoderBuffer = new Buffer();
     this->decoderBuffer->SetSamples(0);
+    this->resampledBuffer = new Buffer();
+    this->resampledBuffer->SetSamples(0);
+    this->sourceBuffer = this->decoderBuffer;
 }
 
 Stream::~Stream() {
-    delete[] rawBuffer;
-    delete this->decoderBuffer;
-
-    for (Buffer* buffer : this->recycledBuffers) {
-        delete buffer;
+    if (this->dsps) {
+        this->dsps->Detach();
     }
 
-    for (Buffer* buffer : this->filledBuffers) {
-        delete buffer;
-    }
+    delete this->decoderBuffer;
+    delete this->resampledBuffer;
+
+    /* recycled and filled buffers are owned by the slab. hand it back so the
+    next track can reuse it. */
+    BufferSlab::Recycle(this->slab);
 }
 
-IStreamPtr Stream::Create(int samplesPerChannel, double bufferLengthSeconds, StreamFlags options) {
-    return IStreamPtr(new Stream(samplesPerChannel, bufferLengthSeconds, options));
+IStreamPtr Stream::Create(int samplesPerChannel, double bufferLengthSeconds, StreamFlags options, DspChain::Ptr dsps) {
+    return IStreamPtr(new Stream(samplesPerChannel, bufferLengthSeconds, options, dsps));
 }
 
 musik::core::audio::IStream* Stream::CreateUnmanaged(int samplesPerChannel, double bufferLengthSeconds, StreamFlags options) {
-    return new Stream(samplesPerChannel, bufferLengthSeconds, options);
+    return new Stream(samplesPerChannel, bufferLengthSeconds, options, DspChain::Ptr());
 }
 
 double Stream::SetPosition(double requestedSeconds) {
@@ -105,6 +119,11 @@ double Stream::SetPosition(double requestedSeconds) {
         }
 
         this->filledBuffers.clear();
+
+        if (this->resampler) {
+            this->resampler->Reset();
+            this->resamplerFlushed = false;
+        }
     }
 
     return actualSeconds;
@@ -133,16 +152,27 @@ bool Stream::OpenStream(std::string uri, IOutput* output) {
     this->decoder = streams::GetDecoderForDataStream(this->dataStream);
 
     if (this->decoder) {
-        /* if the output has a default/preferred sample rate, let the decoder know
-        before sending samples. this way the decoder can resample the audio itself
-        if it likes. */
+        /* if the output has a default/preferred sample rate (or the user asked
+        for a fixed one), let the decoder know before sending samples. this way
+        the decoder can resample the audio itself if it likes; if it doesn't,
+        we'll do it ourselves. */
         if (output) {
-            int defaultOutputSampleRate = output->GetDefaultSampleRate();
-            if (defaultOutputSampleRate > 0) {
-                this->decoder->SetPreferredSampleRate(defaultOutputSampleRate);
+            auto prefs = Preferences::ForComponent(components::Playback);
+            this->targetSampleRate = output->GetDefaultSampleRate();
+            if (this->targetSampleRate <= 0) {
+                this->targetSampleRate = prefs->GetInt(keys::ResamplerSampleRate, 0);
+            }
+            this->resamplerQuality = static_cast<Resampler::Quality>(std::max(0, std::min(2,
+                prefs->GetInt(keys::ResamplerQuality, (int) Resampler::Quality::Balanced))));
+            if (this->targetSampleRate > 0) {
+                this->decoder->SetPreferredSampleRate(this->targetSampleRate);
             }
         }
-        if (this->dataStream->CanPrefetch()) {
+        /* a read ahead wrapper says it can't be prefetched so it's never
+        wrapped twice, but the stream underneath it could be. */
+        if (this->dataStream->CanPrefetch() ||
+            dynamic_cast<musik::core::io::PrefetchDataStream*>(this->dataStream.get()))
+        {
             this->capabilities |= (int) musik::core::sdk::Capability::Prebuffer;
             this->RefillInternalBuffers();
         }
@@ -165,26 +195,66 @@ void Stream::OnBufferProcessedByPlayer(IBuffer* buffer) {
 bool Stream::GetNextBufferFromDecoder() {
     /* ask the decoder for some data */
     if (!this->decoder->GetBuffer(this->decoderBuffer)) {
+        /* the resampler holds on to the last few frames of the stream; push
+        them through before we report we're done. */
+        if (this->resampler && !this->resamplerFlushed) {
+            this->resamplerFlushed = true;
+            if (this->resampler->Flush(this->resampledBuffer) > 0) {
+                this->sourceBuffer = this->resampledBuffer;
+                return true;
+            }
+        }
         return false;
     }
 
+    this->sourceBuffer = this->decoderBuffer;
+
+    const long rate = this->decoderBuffer->SampleRate();
+    const int channels = this->decoderBuffer->Channels();
+
+    /* the decoder didn't honor our preferred sample rate, so convert it here.
+    this way every track reaches the output at the same rate, and it doesn't
+    have to be torn down and reopened between tracks. */
+    if (this->targetSampleRate > 0 && rate != this->targetSampleRate && channels > 0) {
+        if (!this->resampler ||
+            this->resampler->InputRate() != rate ||
+            this->resampler->Channels() != channels)
+        {
+            musik::debug::info(TAG, u8fmt(
+                "resampling %ld -> %ld (quality %d)",
+                rate, this->targetSampleRate, (int) this->resamplerQuality));
+
+            this->resampler = std::make_shared<Resampler>(
+                channels, rate, this->targetSampleRate, this->resamplerQuality);
+        }
+
+        this->resampler->Process(
+            this->decoderBuffer->BufferPointer(),
+            this->decoderBuffer->Samples() / channels,
+            this->resampledBuffer);
+
+        this->sourceBuffer = this->resampledBuffer;
+    }
+
     /* ensure our internal state is initialized */
-    if (!this->rawBuffer) {
-        this->decoderSampleRate = this->decoderBuffer->SampleRate();
-        this->decoderChannels = this->decoderBuffer->Channels();
+    if (!this->slab) {
+        this->decoderSampleRate = this->sourceBuffer->SampleRate();
+        this->decoderChannels = this->sourceBuffer->Channels();
         this->samplesPerBuffer = samplesPerChannel * decoderChannels;
 
         this->bufferCount = std::max(MIN_BUFFER_COUNT, (int)(this->bufferLengthSeconds *
             (double)(this->decoderSampleRate / this->samplesPerBuffer)));
 
-        this->rawBuffer = new float[bufferCount * this->samplesPerBuffer];
-        int offset = 0;
+        /* the slab may have been used by a previous track (possibly with a
+        different sample rate), so reset every buffer we take from it. */
+        this->slab = BufferSlab::Acquire(this->decoderChannels, this->samplesPerChannel, this->bufferCount);
         for (int i = 0; i < bufferCount; i++) {
-            auto buffer = new Buffer(this->rawBuffer + offset, this->samplesPerBuffer);
+            auto buffer = this->slab->At(i);
             buffer->SetSampleRate(this->decoderSampleRate);
             buffer->SetChannels(this->decoderChannels);
+            buffer->SetSamples(this->samplesPerBuffer);
+            buffer->SetPosition(0.0);
             this->recycledBuffers.push_back(buffer);
-            offset += this->samplesPerBuffer;
         }
     }
 
@@ -208,8 +278,8 @@ IBuffer* Stream::GetNextProcessedOutputBuffer() {
         Buffer* buffer = this->filledBuffers.front();
         this->filledBuffers.pop_front();
 
-        for (std::shared_ptr<IDSP> dsp : this->dsps) {
-            dsp->Process(buffer);
+        if (this->dsps) {
+            this->dsps->Process(buffer);
         }
 
         return buffer;
@@ -218,11 +288,57 @@ IBuffer* Stream::GetNextProcessedOutputBuffer() {
     return nullptr;
 }
 
+/* decodes ahead, without running the dsp chain, so the first `seconds` of
+audio are ready before we're asked for them. does a single chunk of work per
+call, so the caller can bail between chunks; returns false once the target
+is met, the buffers are full, or the stream ended. */
+bool Stream::Prefill(double seconds) {
+    if (this->done || !this->decoder) {
+        return false;
+    }
+
+    if (this->slab) {
+        const double buffered =
+            (double) this->filledBuffers.size() *
+            (double) this->samplesPerChannel /
+            (double) this->decoderSampleRate;
+
+        /* RefillInternalBuffers() always leaves one buffer for the remainder */
+        if (buffered >= seconds || this->recycledBuffers.size() <= 1) {
+            return false;
+        }
+    }
+
+    const size_t before = this->filledBuffers.size();
+    this->RefillInternalBuffers();
+    return !this->done && this->filledBuffers.size() > before;
+}
+
+/* the fraction of our buffers that hold decoded audio, either waiting to be
+handed to the player or already queued in the output. */
+double Stream::BufferFill() {
+    if (!this->slab || this->bufferCount <= 0) {
+        return 1.0;
+    }
+
+    if (this->done) {
+        return 1.0; /* nothing left to read, so nothing to protect */
+    }
+
+    return
+        (double) (this->bufferCount - (int) this->recycledBuffers.size()) /
+        (double) this->bufferCount;
+}
+
 void Stream::RefillInternalBuffers() {
+    /* the very first refill includes decoder warm-up; it's the one worth tracing. */
+    const bool first = !this->slab;
+    const uint64_t traceStart = first ? trace::Now() : 0;
+
     int recycled = (int) this->recycledBuffers.size();
     int count = 0;
 
-    if (!this->rawBuffer) { /* not initialized */
+    if (!this->slab) { /* not initialized */
         count = -1;
     }
     else {
@@ -247,11 +363,11 @@ void Stream::RefillInternalBuffers() {
                 break;
             }
 
-            if (this->decoderBuffer->Samples() == 0) {
+            if (this->sourceBuffer->Samples() == 0) {
                 continue;
             }
 
-            this->decoderSamplesRemain = this->decoderBuffer->Samples();
+            this->decoderSamplesRemain = this->sourceBuffer->Samples();
             this->decoderSampleOffset = 0;
         }
 
@@ -286,7 +402,7 @@ void Stream::RefillInternalBuffers() {
         if (targetSamplesRemain > 0) {
             long samplesToCopy = std::min(this->decoderSamplesRemain, targetSamplesRemain);
             if (samplesToCopy > 0) {
-                float* src = this->decoderBuffer->BufferPointer() + this->decoderSampleOffset;
+                float* src = this->sourceBuffer->BufferPointer() + this->decoderSampleOffset;
                 target->Copy(src, samplesToCopy, targetSampleOffset);
 
                 this->decoderPosition += samplesToCopy;
@@ -303,4 +419,8 @@ void Stream::RefillInternalBuffers() {
             }
         }
     }
-}
\ No newline at end of file
+
+    if (first) {
+        trace::Complete("Stream::RefillInternalBuffers", traceStart, trace::Now() - traceStart);
+    }
+}
@@ -37,6 +37,9 @@
 #include <musikcore/config.h>
 #include <musikcore/io/DataStreamFactory.h>
 #include <musikcore/audio/Buffer.h>
+#include <musikcore/audio/BufferSlab.h>
+#include <musikcore/audio/DspChain.h>
+#include <musikcore/audio/Resampler.h>
 #include <musikcore/audio/IStream.h>
 #include <musikcore/sdk/IDecoder.h>
 #include <musikcore/sdk/IOutput.h>
@@ -59,7 +62,8 @@ namespace musik { namespace core { namespace audio {
             static IStreamPtr Create(
                 int samplesPerChannel = 2048,
                 double bufferLengthSeconds = 5,
-                StreamFlags options = StreamFlags::None);
+                StreamFlags options = StreamFlags::None,
+                DspChain::Ptr dsps = DspChain::Ptr());
 
             static IStream* CreateUnmanaged(
                 int samplesPerChannel = 2048,
@@ -70,7 +74,8 @@ namespace musik { namespace core { namespace audio {
             Stream(
                 int samplesPerChannel,
                 double bufferLengthSeconds,
-                StreamFlags options);
+                StreamFlags options,
+                DspChain::Ptr dsps);
 
         public:
             virtual ~Stream();
@@ -83,6 +88,8 @@ namespace musik { namespace core { namespace audio {
             void Interrupt() override;
             int GetCapabilities() override;
             bool Eof() override { return this->done; }
+            bool Prefill(double seconds) override;
+            double BufferFill() override;
             void Release() override { delete this; }
 
         private:
@@ -92,8 +99,6 @@ namespace musik { namespace core { namespace audio {
 
             typedef std::deque<Buffer*> BufferList;
             typedef std::shared_ptr<IDecoder> DecoderPtr;
-            typedef std::shared_ptr<IDSP> DspPtr;
-            typedef std::vector<DspPtr> Dsps;
 
             long decoderSampleRate;
             long decoderChannels;
@@ -104,6 +109,8 @@ namespace musik { namespace core { namespace audio {
             BufferList filledBuffers;
 
             Buffer* decoderBuffer;
+            Buffer* resampledBuffer;
+            Buffer* sourceBuffer; /* either decoderBuffer or resampledBuffer */
             long decoderSampleOffset;
             long decoderSamplesRemain;
             uint64_t decoderPosition;
@@ -116,10 +123,15 @@ namespace musik { namespace core { namespace audio {
             double bufferLengthSeconds;
             int capabilities;
 
-            float* rawBuffer;
+            BufferSlab::Ptr slab;
 
             DecoderPtr decoder;
-            Dsps dsps;
+            DspChain::Ptr dsps;
+
+            Resampler::Ptr resampler;
+            Resampler::Quality resamplerQuality;
+            long targetSampleRate;
+            bool resamplerFlushed;
     };
 
 } } }
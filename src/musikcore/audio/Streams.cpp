@@ -39,7 +39,12 @@
 #include <musikcore/sdk/IDecoderFactory.h>
 #include <musikcore/sdk/IEncoderFactory.h>
 #include <musikcore/plugin/PluginFactory.h>
+#include <musikcore/support/Trace.h>
 #include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
 
 #define TAG "Streams"
 
@@ -76,52 +81,215 @@ static void init() {
     }
 }
 
+using FactoryPtr = std::shared_ptr<IDecoderFactory>;
+
+static std::mutex factoryCacheLock;
+static std::unordered_map<std::string, FactoryPtr> factoryCache;
+
+static struct {
+    std::atomic<uint64_t> cacheHits{ 0 };
+    std::atomic<uint64_t> sniffHits{ 0 };
+    std::atomic<uint64_t> probes{ 0 };
+    std::atomic<uint64_t> misses{ 0 };
+} probeStats;
+
+/* number of bytes we read from the front of a stream to identify it */
+static const int kSniffBytes = 64;
+
+static std::string normalizeType(const char* type) {
+    std::string result = type ? type : "";
+    std::transform(result.begin(), result.end(), result.begin(), [](char c) {
+        return (char) tolower((unsigned char) c);
+    });
+    return result;
+}
+
+static bool matches(const unsigned char* data, int size, int offset, const char* magic) {
+    const int length = (int) strlen(magic);
+    return size >= offset + length && memcmp(data + offset, magic, length) == 0;
+}
+
+/* identifies common container formats by their magic bytes. returns a file
+extension that decoder factories understand, or an empty string. */
+static std::string sniffType(IDataStream* dataStream) {
+    if (!dataStream->Seekable() || dataStream->Position() != 0) {
+        return "";
+    }
+
+    unsigned char header[kSniffBytes];
+    const int size = (int) dataStream->Read(header, kSniffBytes);
+    dataStream->SetPosition(0);
+
+    if (size <= 0) {
+        return "";
+    }
+
+    if (matches(header, size, 0, "fLaC")) { return ".flac"; }
+    if (matches(header, size, 0, "OggS")) {
+        if (matches(header, size, 28, "OpusHead")) { return ".opus"; }
+        if (matches(header, size, 28, "\x7f" "FLAC")) { return ".flac"; }
+        return ".ogg";
+    }
+    if (matches(header, size, 0, "RIFF") && matches(header, size, 8, "WAVE")) { return ".wav"; }
+    if (matches(header, size, 0, "FORM") && (matches(header, size, 8, "AIFF") || matches(header, size, 8, "AIFC"))) { return ".aiff"; }
+    if (matches(header, size, 4, "ftyp")) { return ".m4a"; }
+    if (matches(header, size, 0, "wvpk")) { return ".wv"; }
+    if (matches(header, size, 0, "MAC ")) { return ".ape"; }
+    if (matches(header, size, 0, "MThd")) { return ".mid"; }
+    if (matches(header, size, 0, "ID3")) { return ".mp3"; }
+    if (size >= 2 && header[0] == 0xff && (header[1] & 0xe0) == 0xe0) {
+        /* mpeg frame sync. adts aac uses the same sync word, but with the
+        layer bits cleared. */
+        return ((header[1] & 0x06) == 0) ? ".aac" : ".mp3";
+    }
+
+    return "";
+}
+
+static FactoryPtr cachedFactory(const std::string& type) {
+    std::unique_lock<std::mutex> lock(factoryCacheLock);
+    auto it = factoryCache.find(type);
+    return it == factoryCache.end() ? FactoryPtr() : it->second;
+}
+
+static void rememberFactory(const std::string& type, FactoryPtr factory) {
+    if (type.size() && factory) {
+        std::unique_lock<std::mutex> lock(factoryCacheLock);
+        factoryCache[type] = factory;
+    }
+}
+
+/* drops `factory` from the cache if it failed to open a stream of `type`,
+so the next lookup goes back to asking every factory. */
+static void forgetFactory(const std::string& type, FactoryPtr factory) {
+    std::unique_lock<std::mutex> lock(factoryCacheLock);
+    auto it = factoryCache.find(type);
+    if (it != factoryCache.end() && it->second == factory) {
+        factoryCache.erase(it);
+    }
+}
+
+/* returns the cached factory for `type`, or the first one that claims to
+handle it. */
+static FactoryPtr resolveFactory(const std::string& type) {
+    FactoryPtr result = cachedFactory(type);
+    if (!result) {
+        for (auto factory : decoders) {
+            if (factory->CanHandle(type.c_str())) {
+                result = factory;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+static IDecoder* openWithFactory(FactoryPtr factory, IDataStream* dataStream) {
+    IDecoder* decoder = factory->CreateDecoder();
+
+    if (!decoder) {
+        /* shouldn't ever happen, the factory said it can handle this file */
+        return nullptr;
+    }
+
+    /* ask the decoder to open the data stream. if it returns true we're
+    good to start pulling data out of it! */
+    if (!decoder->Open(dataStream)) {
+        decoder->Release();
+        dataStream->SetPosition(0); /* rewind for the next candidate */
+        return nullptr;
+    }
+
+    rememberFactory(normalizeType(dataStream->Type()), factory);
+    return decoder;
+}
+
 namespace musik { namespace core { namespace audio {
 
     namespace streams {
         IDecoder* GetDecoderForDataStream(IDataStream* dataStream) {
+            trace::Span span("streams::GetDecoderForDataStream");
+
             init();
 
-            IDecoder* decoder = nullptr;
+            const std::string uri = dataStream->Uri();
+            const std::string type = normalizeType(dataStream->Type());
 
-            /* find a DecoderFactory we can use for this type of data*/
-            DecoderFactoryList::iterator factories = decoders.begin();
-            DecoderFactoryList::iterator end = decoders.end();
-            std::shared_ptr<IDecoderFactory> factory;
+            std::vector<FactoryPtr> attempted;
 
-            for (; factories != end && !factory; ++factories) {
-                if ((*factories)->CanHandle(dataStream->Type())) {
-                    factory = (*factories);
-                    break;
+            auto tryFactory = [&](FactoryPtr factory) -> IDecoder* {
+                if (!factory || std::find(attempted.begin(), attempted.end(), factory) != attempted.end()) {
+                    return nullptr;
                 }
-            }
-
-            const std::string uri = dataStream->Uri();
+                attempted.push_back(factory);
+                ++probeStats.probes;
+                IDecoder* decoder = openWithFactory(factory, dataStream);
+                if (!decoder) {
+                    ++probeStats.misses;
+                }
+                return decoder;
+            };
 
-            if (!factory) {
-                /* nothing can decode this type of file */
-                musik::debug::error(TAG, "nothing could open " + uri);
-                return nullptr;
+            /* fast path: we've already seen this type, and know who handles it */
+            FactoryPtr cached = cachedFactory(type);
+            IDecoder* decoder = tryFactory(cached);
+            if (decoder) {
+                ++probeStats.cacheHits;
+                musik::debug::info(TAG, "found a decoder for " + uri);
+                return decoder;
+            }
+            else if (cached) {
+                forgetFactory(type, cached);
             }
 
-            decoder = factory->CreateDecoder();
+            /* the type may be missing, wrong, or ambiguous (e.g. a generic mime
+            type from a web server). take a quick look at the content. */
+            const std::string sniffed = sniffType(dataStream);
+            if (sniffed.size() && sniffed != type) {
+                FactoryPtr resolved = resolveFactory(sniffed);
+                decoder = tryFactory(resolved);
+                if (decoder) {
+                    ++probeStats.sniffHits;
+                    rememberFactory(sniffed, resolved);
+                    musik::debug::info(TAG, "found a decoder for " + uri + " by content");
+                    return decoder;
+                }
+                else if (resolved) {
+                    forgetFactory(sniffed, resolved);
+                }
+            }
 
-            if (!decoder) {
-                /* shouldn't ever happen, the factory said it can handle this file */
-                return nullptr;
+            /* slow path: ask every factory that claims to handle the type. */
+            for (auto factory : decoders) {
+                if (factory->CanHandle(type.c_str()) ||
+                    (sniffed.size() && factory->CanHandle(sniffed.c_str())))
+                {
+                    decoder = tryFactory(factory);
+                    if (decoder) {
+                        musik::debug::info(TAG, "found a decoder for " + uri);
+                        return decoder;
+                    }
+                }
             }
 
-            /* ask the decoder to open the data stream. if it returns true we're
-            good to start pulling data out of it! */
-            if (!decoder->Open(dataStream)) {
+            if (attempted.size()) {
                 musik::debug::error(TAG, "open ok, but decode failed " + uri);
-                decoder->Release();
-                return nullptr;
+            }
+            else {
+                /* nothing can decode this type of file */
+                musik::debug::error(TAG, "nothing could open " + uri);
             }
 
-            musik::debug::info(TAG, "found a decoder for " + uri);
+            return nullptr;
+        }
 
-            return decoder;
+        DecoderProbeStats GetDecoderProbeStats() {
+            DecoderProbeStats result;
+            result.cacheHits = probeStats.cacheHits;
+            result.sniffHits = probeStats.sniffHits;
+            result.probes = probeStats.probes;
+            result.misses = probeStats.misses;
+            return result;
         }
 
         IEncoder* GetEncoderForType(const char* type) {
@@ -47,6 +47,15 @@
 namespace musik { namespace core { namespace audio {
 
     namespace streams {
+        /* counters describing how decoders were resolved. a `miss` is a decoder
+        that was created, but failed to open the stream. */
+        struct DecoderProbeStats {
+            uint64_t cacheHits{ 0 };
+            uint64_t sniffHits{ 0 };
+            uint64_t probes{ 0 };
+            uint64_t misses{ 0 };
+        };
+
         std::shared_ptr<musik::core::sdk::IDecoder>
             GetDecoderForDataStream(musik::core::io::DataStreamFactory::DataStreamPtr dataStream);
 
@@ -56,6 +65,8 @@ namespace musik { namespace core { namespace audio {
         musik::core::sdk::IEncoder* GetEncoderForType(const char* type);
 
         std::vector<std::shared_ptr<musik::core::sdk::IDSP > > GetDspPlugins();
+
+        DecoderProbeStats GetDecoderProbeStats();
     };
 
 } } }
@@ -318,6 +318,14 @@ mcsdk_export mcsdk_track_list mcsdk_svc_metadata_query_tracks_by_external_id(mcs
     return mcsdk_track_list { METADATA(mp)->QueryTracksByExternalId(external_ids, external_id_count) };
 }
 
+mcsdk_export size_t mcsdk_svc_metadata_query_tracks_by_ids(mcsdk_svc_metadata mp, const int64_t* track_ids, size_t track_id_count, mcsdk_track* result) {
+    return METADATA(mp)->QueryTracksByIds(track_ids, track_id_count, reinterpret_cast<ITrack**>(result));
+}
+
+mcsdk_export size_t mcsdk_svc_metadata_query_tracks_by_external_ids(mcsdk_svc_metadata mp, const char** external_ids, size_t external_id_count, mcsdk_track* result) {
+    return METADATA(mp)->QueryTracksByExternalIds(external_ids, external_id_count, reinterpret_cast<ITrack**>(result));
+}
+
 mcsdk_export mcsdk_value_list mcsdk_svc_metadata_list_categories(mcsdk_svc_metadata mp) {
     return mcsdk_value_list { METADATA(mp)->ListCategories() };
 }
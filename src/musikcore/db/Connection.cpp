@@ -128,7 +128,7 @@ void Connection::Initialize(unsigned int cache) {
     sqlite3_exec(this->connection, "PRAGMA optimize", nullptr, nullptr, nullptr);           // Optimize the database when applicable
     sqlite3_exec(this->connection, "PRAGMA synchronous=NORMAL", nullptr, nullptr, nullptr); // NORMAL useful for auto-checkpointing with WAL
     sqlite3_exec(this->connection, "PRAGMA page_size=4096", nullptr, nullptr, nullptr);	    // According to windows standard page size
-    sqlite3_exec(this->connection, "PRAGMA auto_vacuum=0", nullptr, nullptr, nullptr);	    // No autovaccum.
+    sqlite3_exec(this->connection, "PRAGMA auto_vacuum=INCREMENTAL", nullptr, nullptr, nullptr); // Free pages are reclaimed by the indexer, a few at a time.
     sqlite3_exec(this->connection, "PRAGMA journal_mode=WAL", nullptr, nullptr, nullptr);   // Allow reading while writing (write-ahead-logging)
 
     if (cache != 0) {
@@ -53,9 +53,10 @@ void ScopedTransaction::Cancel() noexcept {
     this->canceled = true;
 }
 
-void ScopedTransaction::CommitAndRestart() {
-    this->End();
+bool ScopedTransaction::CommitAndRestart() {
+    const bool result = this->End();
     this->Begin();
+    return result;
 }
 
 void ScopedTransaction::Begin() {
@@ -69,18 +70,22 @@ void ScopedTransaction::Begin() {
     ++this->connection->transactionCounter;
 }
 
-void ScopedTransaction::End() {
+bool ScopedTransaction::End() {
+    int result = Okay;
+
     --this->connection->transactionCounter;
 
     if (this->connection->transactionCounter == 0) {
         if (this->canceled) {
-            this->connection->Execute("ROLLBACK TRANSACTION");
+            result = this->connection->Execute("ROLLBACK TRANSACTION");
         }
         else {
-            this->connection->Execute("COMMIT TRANSACTION");
+            result = this->connection->Execute("COMMIT TRANSACTION");
             //this->connection->Checkpoint();
         }
     }
 
     this->canceled = false;
+
+    return result == Okay;
 }
@@ -49,11 +49,14 @@ namespace musik { namespace core { namespace db {
             ~ScopedTransaction();
 
             void Cancel() noexcept;
-            void CommitAndRestart();
+
+            /* returns false if this ended an outermost transaction, and the
+            COMMIT (or ROLLBACK, if canceled) failed */
+            bool CommitAndRestart();
 
         private:
             inline void Begin();
-            inline void End();
+            inline bool End();
 
             Connection *connection;
             bool canceled;
@@ -38,6 +38,8 @@
 #include <musikcore/config.h>
 #include <musikcore/plugin/PluginFactory.h>
 #include <musikcore/io/LocalFileStream.h>
+#include <musikcore/io/PrefetchDataStream.h>
+#include <musikcore/support/Trace.h>
 
 using namespace musik::core::io;
 using namespace musik::core::sdk;
@@ -63,6 +65,16 @@ DataStreamFactory* DataStreamFactory::Instance() {
     return instance;
 }
 
+/* read ahead on the IoScheduler's threads, so the decoder doesn't stall on
+i/o. only used for local files: plugin streams are returned as-is, because
+their decoders may downcast them. */
+static IDataStream* prefetch(IDataStream* stream, OpenFlags flags) {
+    if (flags == OpenFlags::Read && stream->CanPrefetch()) {
+        return new PrefetchDataStream(stream);
+    }
+    return stream;
+}
+
 IDataStream* DataStreamFactory::OpenDataStream(const char* uri, OpenFlags flags) {
     typedef musik::core::PluginFactory::ReleaseDeleter<IDataStream> StreamDeleter;
 
@@ -79,9 +91,16 @@ IDataStream* DataStreamFactory::OpenDataStream(const char* uri, OpenFlags flags)
         }
 
         /* no plugins accepted it? try to open as a local file */
-        IDataStream* regularFile = new LocalFileStream();
+        LocalFileStream* regularFile = new LocalFileStream();
         if (regularFile->Open(uri, flags)) {
-            return regularFile;
+            /* a mapped file that's already in the page cache can be read in
+            place without ever touching the disk, so a read ahead would just
+            be an extra copy. anything colder, or unmapped, could fault or
+            block in the decoder, so read it ahead. */
+            if (regularFile->IsResident()) {
+                return regularFile;
+            }
+            return prefetch(regularFile, flags);
         }
         else {
             regularFile->Release();
@@ -91,7 +110,13 @@ IDataStream* DataStreamFactory::OpenDataStream(const char* uri, OpenFlags flags)
     return nullptr;
 }
 
+void DataStreamFactory::Register(std::shared_ptr<IDataStreamFactory> factory) {
+    auto& factories = DataStreamFactory::Instance()->dataStreamFactories;
+    factories.insert(factories.begin(), factory);
+}
+
 DataStreamPtr DataStreamFactory::OpenSharedDataStream(const char *uri, OpenFlags flags) {
+    trace::Span span("DataStreamFactory::OpenSharedDataStream");
     auto stream = OpenDataStream(uri, flags);
     return stream ? DataStreamPtr(stream, StreamDeleter()) : DataStreamPtr();
 }
@@ -48,6 +48,10 @@ namespace musik { namespace core { namespace io {
             static DataStreamPtr OpenSharedDataStream(const char *uri, OpenFlags flags);
             static musik::core::sdk::IDataStream* OpenDataStream(const char* uri, OpenFlags flags);
 
+            /* adds a factory that isn't provided by a plugin, ahead of the plugin
+            ones. not thread safe; call before any streams are opened. */
+            static void Register(std::shared_ptr<musik::core::sdk::IDataStreamFactory> factory);
+
         private:
             typedef std::vector<std::shared_ptr<musik::core::sdk::IDataStreamFactory> > DataStreamFactoryVector;
 
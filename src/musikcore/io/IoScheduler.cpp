@@ -0,0 +1,251 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "pch.hpp"
+
+#include <musikcore/io/IoScheduler.h>
+#include <musikcore/debug.h>
+#include <musikcore/support/Preferences.h>
+#include <musikcore/support/PreferenceKeys.h>
+
+#include <algorithm>
+
+using namespace musik::core::io;
+using namespace musik::core::prefs;
+using musik::core::Preferences;
+
+#define TAG "IoScheduler"
+
+/* start holding background i/o back once fewer than this fraction of the
+playing stream's buffers are decoded ahead... */
+static const double kLowWatermark = 0.25;
+
+/* ...and let it run freely again once we've recovered to this much. the gap
+between the two keeps us from flapping around a single threshold. */
+static const double kHighWatermark = 0.5;
+
+/* while throttled, background work isn't stopped outright, just admitted
+at most once per interval across all threads. */
+static const auto kThrottledInterval = std::chrono::milliseconds(250);
+
+/* the player reports every buffer; if we stop hearing from it playback has
+stopped or paused, and there's nothing left to protect. */
+static const auto kStaleReport = std::chrono::seconds(2);
+
+static thread_local IoScheduler::Class currentClass = IoScheduler::Class::Playback;
+
+static inline bool isBackground(IoScheduler::Class ioClass) noexcept {
+    return ioClass == IoScheduler::Class::Indexer || ioClass == IoScheduler::Class::Analyzer;
+}
+
+IoScheduler::Scope::Scope(Class ioClass) noexcept
+: previous(currentClass) {
+    currentClass = ioClass;
+}
+
+IoScheduler::Scope::~Scope() noexcept {
+    currentClass = this->previous;
+}
+
+IoScheduler::Class IoScheduler::CurrentClass() noexcept {
+    return currentClass;
+}
+
+IoScheduler& IoScheduler::Instance() {
+    /* intentionally leaked; the worker threads live as long as the process. */
+    static IoScheduler* instance = new IoScheduler();
+    return *instance;
+}
+
+IoScheduler::IoScheduler() {
+    auto prefs = Preferences::ForComponent(components::Settings);
+    const int count = std::max(1, std::min(16, prefs->GetInt(keys::IoMaxConcurrentReads, 4)));
+
+    musik::debug::info(TAG, u8fmt("starting with %d concurrent reads", count));
+
+    for (int i = 0; i < count; i++) {
+        this->threads.emplace_back(std::thread(std::bind(&IoScheduler::ThreadProc, this)));
+        this->threads.back().detach();
+    }
+}
+
+void IoScheduler::Submit(Task task, Class ioClass) {
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->tasks[(size_t) ioClass].push_back(std::move(task));
+        if (this->throttled && isBackground(ioClass)) {
+            ++this->delayed;
+        }
+    }
+    this->condition.notify_one();
+}
+
+void IoScheduler::ReportPlaybackBuffer(double fill) {
+    bool released = false;
+
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        const auto now = Clock::now();
+        this->lastReport = now;
+
+        if (!this->throttled) {
+            if (fill < kLowWatermark) {
+                this->throttled = true;
+                this->throttledAt = now;
+                this->nextBackground = now + kThrottledInterval;
+                this->lowestFill = fill;
+                this->delayed = 0;
+
+                musik::debug::warning(TAG, u8fmt(
+                    "playback buffer at %.0f%%, throttling background i/o",
+                    fill * 100.0));
+            }
+        }
+        else {
+            this->lowestFill = std::min(this->lowestFill, fill);
+            if (fill >= kHighWatermark) {
+                this->Release("playback recovered");
+                released = true;
+            }
+        }
+    }
+
+    if (released) {
+        this->condition.notify_all();
+    }
+}
+
+void IoScheduler::WaitIfThrottled(Class ioClass) {
+    if (!isBackground(ioClass) || !this->throttled) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    bool counted = false;
+    while (true) {
+        const auto now = Clock::now();
+        if (this->AdmitBackgroundLocked(now)) {
+            return;
+        }
+        if (!counted) {
+            ++this->delayed;
+            counted = true;
+        }
+        this->condition.wait_until(lock, this->nextBackground);
+    }
+}
+
+/* must be called with the mutex held */
+void IoScheduler::Release(const char* reason) {
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        Clock::now() - this->throttledAt);
+
+    this->throttled = false;
+
+    musik::debug::info(TAG, u8fmt(
+        "background i/o released after %lldms (%s); lowest buffer %.0f%%, %d background requests delayed",
+        (long long) elapsed.count(),
+        reason,
+        this->lowestFill * 100.0,
+        (int) this->delayed));
+}
+
+/* must be called with the mutex held */
+bool IoScheduler::ThrottledLocked(Clock::time_point now) {
+    if (this->throttled && now - this->lastReport > kStaleReport) {
+        this->Release("no longer playing");
+    }
+    return this->throttled;
+}
+
+/* must be called with the mutex held. returns true if a background request
+may go ahead now, and if so spends the current throttled interval on it. */
+bool IoScheduler::AdmitBackgroundLocked(Clock::time_point now) {
+    if (!this->ThrottledLocked(now)) {
+        return true;
+    }
+    if (now >= this->nextBackground) {
+        this->nextBackground = now + kThrottledInterval;
+        return true;
+    }
+    return false;
+}
+
+/* must be called with the mutex held */
+bool IoScheduler::BackgroundPendingLocked() const noexcept {
+    return
+        !this->tasks[(size_t) Class::Indexer].empty() ||
+        !this->tasks[(size_t) Class::Analyzer].empty();
+}
+
+/* must be called with the mutex held */
+bool IoScheduler::Next(Task& task) {
+    const auto now = Clock::now();
+    for (size_t i = 0; i < kClassCount; i++) {
+        auto& queue = this->tasks[i];
+        if (queue.empty()) {
+            continue;
+        }
+        if (isBackground((Class) i) && !this->AdmitBackgroundLocked(now)) {
+            continue;
+        }
+        task = std::move(queue.front());
+        queue.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void IoScheduler::ThreadProc() {
+    while (true) {
+        Task task;
+
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            while (!this->Next(task)) {
+                if (this->BackgroundPendingLocked()) {
+                    /* there may be background work we're holding back; come
+                    back when it's allowed to run, or throttling ends. */
+                    this->condition.wait_until(lock, this->nextBackground);
+                }
+                else {
+                    this->condition.wait(lock);
+                }
+            }
+        }
+
+        task();
+    }
+}
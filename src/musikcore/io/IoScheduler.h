@@ -0,0 +1,127 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <musikcore/config.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace musik { namespace core { namespace io {
+
+    /* a small, process-wide pool of threads that perform blocking reads on
+    behalf of streams. the number of threads is the global limit on how many
+    reads we have outstanding at once, so a busy consumer can't saturate the
+    disk on its own.
+
+    work is tagged with a class. the player reports how full its output
+    buffers are, and while playback is running low the background classes
+    (indexer, analyzer) are held back so their reads don't compete with the
+    active stream for the same disk. */
+    class IoScheduler {
+        public:
+            using Task = std::function<void()>;
+
+            enum class Class: int {
+                Playback = 0,
+                Interactive = 1,
+                Indexer = 2,
+                Analyzer = 3
+            };
+
+            /* tags all i/o started on the calling thread, for the lifetime
+            of the scope, with the specified class. */
+            class Scope {
+                public:
+                    Scope(Class ioClass) noexcept;
+                    ~Scope() noexcept;
+                    DELETE_COPY_AND_ASSIGNMENT_DEFAULTS(Scope)
+                private:
+                    Class previous;
+            };
+
+            DELETE_COPY_AND_ASSIGNMENT_DEFAULTS(IoScheduler)
+
+            static IoScheduler& Instance();
+            static Class CurrentClass() noexcept;
+
+            void Submit(Task task, Class ioClass = CurrentClass());
+            size_t Concurrency() const noexcept { return this->threads.size(); }
+
+            /* called by the player with the fraction (0..1) of the active
+            stream's buffers that are decoded and waiting to be played. */
+            void ReportPlaybackBuffer(double fill);
+
+            /* background callers that do their own blocking i/o (e.g. tag
+            readers) call this between files; returns immediately unless
+            playback is being starved. */
+            void WaitIfThrottled(Class ioClass = CurrentClass());
+
+            bool Throttled() const noexcept { return this->throttled.load(); }
+
+        private:
+            using Clock = std::chrono::steady_clock;
+            static constexpr size_t kClassCount = 4;
+
+            IoScheduler();
+
+            void ThreadProc();
+            bool Next(Task& task);
+            bool ThrottledLocked(Clock::time_point now);
+            bool AdmitBackgroundLocked(Clock::time_point now);
+            bool BackgroundPendingLocked() const noexcept;
+            void Release(const char* reason);
+
+            std::vector<std::thread> threads;
+            std::array<std::deque<Task>, kClassCount> tasks;
+            std::mutex mutex;
+            std::condition_variable condition;
+
+            std::atomic<bool> throttled { false };
+            Clock::time_point throttledAt;
+            Clock::time_point nextBackground;
+            Clock::time_point lastReport;
+            double lowestFill { 1.0 };
+            size_t delayed { 0 };
+    };
+
+} } }
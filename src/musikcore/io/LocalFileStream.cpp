@@ -40,17 +40,183 @@
 #include <musikcore/support/Common.h>
 #include <musikcore/config.h>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <filesystem>
 
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <csetjmp>
+#include <csignal>
+#include <atomic>
+#include <mutex>
+#endif
+
 static const std::string TAG = "LocalFileStream";
 
+/* how far ahead of the read position we ask the OS to start paging in after
+opening or seeking. sequential access hints take care of the rest. */
+static const long kReadaheadBytes = 512 * 1024;
+
 using namespace musik::core::io;
 using namespace musik::core::sdk;
 
+/* if a mapped file is truncated or rewritten underneath us (tag editors do
+this all the time), touching the pages that went away raises SIGBUS on POSIX,
+or an EXCEPTION_IN_PAGE_ERROR on Windows. all reads from the mapping go through
+guardedCopy(), and spans are checked with guardedProbe() before they're lent
+out, which turns that fault into a failed read instead of killing the process. */
+#ifdef WIN32
+static bool guardedCopy(void* dst, const char* src, size_t count) noexcept {
+    __try {
+        memcpy(dst, src, count);
+        return true;
+    }
+    __except (GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR
+        ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH)
+    {
+        return false;
+    }
+}
+
+static bool guardedProbe(const char* src, size_t count, size_t pageSize) noexcept {
+    __try {
+        for (size_t i = 0; i < count; i += pageSize) {
+            (void) *(volatile const char*) (src + i);
+        }
+        (void) *(volatile const char*) (src + count - 1);
+        return true;
+    }
+    __except (GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR
+        ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH)
+    {
+        return false;
+    }
+}
+
+static size_t systemPageSize() noexcept {
+    static const size_t size = []() {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return (size_t) info.dwPageSize;
+    }();
+    return size;
+}
+
+static void installBusErrorHandler() noexcept {
+}
+#else
+static thread_local sigjmp_buf* volatile mappedReadGuard = nullptr;
+static struct sigaction previousBusErrorAction;
+
+static void onBusError(int signal, siginfo_t* info, void* context) {
+    if (mappedReadGuard) {
+        siglongjmp(*mappedReadGuard, 1);
+    }
+
+    /* not one of ours. defer to whatever was installed before us; if that was
+    the default action, restore it and return so the faulting instruction runs
+    again and the process goes down the way it normally would. */
+    if (previousBusErrorAction.sa_flags & SA_SIGINFO) {
+        previousBusErrorAction.sa_sigaction(signal, info, context);
+    }
+    else if (previousBusErrorAction.sa_handler != SIG_DFL &&
+        previousBusErrorAction.sa_handler != SIG_IGN)
+    {
+        previousBusErrorAction.sa_handler(signal);
+    }
+    else {
+        struct sigaction action = {};
+        action.sa_handler = SIG_DFL;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGBUS, &action, nullptr);
+    }
+}
+
+static void installBusErrorHandler() noexcept {
+    static std::once_flag once;
+    std::call_once(once, []() {
+        /* SA_NODEFER leaves SIGBUS unblocked while we're in the handler, so
+        jumping out of it doesn't have to restore the signal mask, and arming
+        the guard doesn't have to save it: no syscalls on the read path. */
+        struct sigaction action = {};
+        action.sa_sigaction = onBusError;
+        action.sa_flags = SA_SIGINFO | SA_NODEFER;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGBUS, &action, &previousBusErrorAction);
+    });
+}
+
+/* true if the first `length` bytes of the mapping are already in the page
+cache, i.e. reading them won't fault to disk. */
+static bool isResident(void* address, size_t length) noexcept {
+    static const size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    const size_t pages = (length + pageSize - 1) / pageSize;
+#ifdef __linux__
+    std::vector<unsigned char> vec(pages);
+#else
+    std::vector<char> vec(pages);
+#endif
+    if (mincore(address, length, vec.data()) != 0) {
+        return false;
+    }
+    for (auto page : vec) {
+        if ((page & 1) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool guardedCopy(void* dst, const char* src, size_t count) noexcept {
+    sigjmp_buf jump;
+    if (sigsetjmp(jump, 0) != 0) {
+        mappedReadGuard = nullptr;
+        return false;
+    }
+    /* the fences keep the compiler from moving the copy outside of the
+    window where the guard is armed. */
+    mappedReadGuard = &jump;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    memcpy(dst, src, count);
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    mappedReadGuard = nullptr;
+    return true;
+}
+
+/* touches every page of the span, so any that went away fault here, under
+the guard, instead of in whoever we lend it to. */
+static bool guardedProbe(const char* src, size_t count, size_t pageSize) noexcept {
+    sigjmp_buf jump;
+    if (sigsetjmp(jump, 0) != 0) {
+        mappedReadGuard = nullptr;
+        return false;
+    }
+    mappedReadGuard = &jump;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    for (size_t i = 0; i < count; i += pageSize) {
+        (void) *(volatile const char*) (src + i);
+    }
+    (void) *(volatile const char*) (src + count - 1);
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    mappedReadGuard = nullptr;
+    return true;
+}
+
+static size_t systemPageSize() noexcept {
+    static const size_t size = (size_t) sysconf(_SC_PAGESIZE);
+    return size;
+}
+#endif
+
 LocalFileStream::LocalFileStream() noexcept
 : file(nullptr)
-, filesize(-1) {
+, mapped(nullptr)
+, mappedPosition(0)
+, filesize(-1)
+, resident(false) {
 }
 
 LocalFileStream::~LocalFileStream() noexcept {
@@ -108,6 +274,15 @@ bool LocalFileStream::Open(const char *filename, OpenFlags flags) {
         }
 
         this->extension = file.extension().u8string();
+
+        /* read-only streams are mapped into memory, so decoders pull data
+        straight from the page cache instead of through stdio. if that
+        doesn't work out for some reason, fall back to regular file io. */
+        if (flags == OpenFlags::Read && this->filesize > 0 && this->Map(filename)) {
+            this->flags = flags;
+            return true;
+        }
+
 #ifdef WIN32
         std::wstring u16fn = u8to16(this->uri);
         std::wstring u16flags = u8to16(openFlags);
@@ -132,7 +307,95 @@ void LocalFileStream::Interrupt() noexcept {
 
 }
 
+bool LocalFileStream::Map(const char* filename) {
+    const size_t size = (size_t) this->filesize;
+    const char* data = nullptr;
+
+#ifdef WIN32
+    std::wstring u16fn = u8to16(filename);
+
+    HANDLE handle = CreateFileW(
+        u16fn.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr);
+
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping) {
+        data = (const char*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping); /* the view keeps the mapping alive */
+    }
+
+    CloseHandle(handle);
+#else
+    const int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    void* result = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (result != MAP_FAILED) {
+        data = (const char*) result;
+        this->resident = isResident(result, std::min(size, (size_t) kReadaheadBytes));
+        madvise(result, size, MADV_SEQUENTIAL);
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+
+    close(fd); /* the mapping holds its own reference */
+#endif
+
+    if (!data) {
+        debug::warning(TAG, "unable to map " + this->uri + ", using buffered io");
+        return false;
+    }
+
+    installBusErrorHandler();
+
+    this->mappedPosition = 0;
+    this->mapped = data;
+    this->Readahead(0);
+    return true;
+}
+
+void LocalFileStream::Unmap() noexcept {
+    auto mapped = this->mapped.exchange(nullptr);
+    if (mapped) {
+#ifdef WIN32
+        UnmapViewOfFile(mapped);
+#else
+        munmap((void*) mapped, (size_t) this->filesize);
+#endif
+    }
+}
+
+void LocalFileStream::Readahead(PositionType position) noexcept {
+#ifndef WIN32
+    const char* mapped = this->mapped.load();
+    if (mapped && position < this->filesize) {
+        /* madvise wants a page aligned address */
+        static const long pageSize = sysconf(_SC_PAGESIZE);
+        const long start = position - (position % pageSize);
+        const long length = std::min(kReadaheadBytes, this->filesize - start);
+        madvise((void*) (mapped + start), (size_t) length, MADV_WILLNEED);
+    }
+#endif
+}
+
 bool LocalFileStream::Close() noexcept {
+    if (this->mapped.load()) {
+        this->Unmap();
+        return true;
+    }
+
     auto file = this->file.exchange(nullptr);
     if (file) {
         if (fclose(file) == 0) {
@@ -147,7 +410,52 @@ void LocalFileStream::Release() noexcept {
     delete this;
 }
 
+const char* LocalFileStream::Borrow(PositionType bytes, PositionType* borrowed) noexcept {
+    const char* mapped = this->mapped.load();
+
+    if (borrowed) {
+        *borrowed = 0;
+    }
+
+    if (!mapped || bytes < 0) {
+        return nullptr;
+    }
+
+    const PositionType position = this->mappedPosition.load();
+    const PositionType count = std::max(0L, std::min(bytes, this->filesize - position));
+
+    if (count > 0 && !guardedProbe(mapped + position, (size_t) count, systemPageSize())) {
+        /* same as Read(): what's left of the file is gone, so it's the end. */
+        debug::error(TAG, "file changed on disk while mapped: " + this->uri);
+        this->mappedPosition = this->filesize;
+        return mapped + this->filesize;
+    }
+
+    this->mappedPosition = position + count;
+
+    if (borrowed) {
+        *borrowed = count;
+    }
+
+    return mapped + position;
+}
+
 PositionType LocalFileStream::Read(void* buffer, PositionType readBytes) noexcept {
+    const char* mapped = this->mapped.load();
+    if (mapped) {
+        const PositionType position = this->mappedPosition.load();
+        const PositionType count = std::max(0L, std::min(readBytes, this->filesize - position));
+        if (count > 0 && !guardedCopy(buffer, mapped + position, (size_t) count)) {
+            /* the file shrank or went away while we were playing it. there's
+            nothing sensible left to read, so behave as if we hit the end. */
+            debug::error(TAG, "file changed on disk while mapped: " + this->uri);
+            this->mappedPosition = this->filesize;
+            return 0;
+        }
+        this->mappedPosition = position + count;
+        return count;
+    }
+
     if (!this->file.load()) {
         return 0;
     }
@@ -171,6 +479,15 @@ PositionType LocalFileStream::Write(void* buffer, PositionType writeBytes) noexc
 
 
 bool LocalFileStream::SetPosition(PositionType position) noexcept {
+    if (this->mapped.load()) {
+        if (position < 0 || position > this->filesize) {
+            return false;
+        }
+        this->mappedPosition = position;
+        this->Readahead(position);
+        return true;
+    }
+
     if (!this->file.load()) {
         return false;
     }
@@ -179,6 +496,10 @@ bool LocalFileStream::SetPosition(PositionType position) noexcept {
 }
 
 PositionType LocalFileStream::Position() noexcept {
+    if (this->mapped.load()) {
+        return this->mappedPosition;
+    }
+
     if (!this->file.load()) {
         return -1;
     }
@@ -187,6 +508,10 @@ PositionType LocalFileStream::Position() noexcept {
 }
 
 bool LocalFileStream::Eof() noexcept {
+    if (this->mapped.load()) {
+        return this->mappedPosition >= this->filesize;
+    }
+
     return !this->file.load() || feof(this->file) != 0;
 }
 
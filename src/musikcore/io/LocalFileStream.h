@@ -35,12 +35,12 @@
 #pragma once
 
 #include <musikcore/config.h>
-#include <musikcore/sdk/IDataStream.h>
+#include <musikcore/sdk/IMappedDataStream.h>
 #include <atomic>
 
 namespace musik { namespace core { namespace io {
 
-    class LocalFileStream : public musik::core::sdk::IDataStream {
+    class LocalFileStream : public musik::core::sdk::IMappedDataStream {
         public:
             using PositionType = musik::core::sdk::PositionType;
             using OpenFlags = musik::core::sdk::OpenFlags;
@@ -67,12 +67,28 @@ namespace musik { namespace core { namespace io {
             const char* Uri() noexcept override;
             bool CanPrefetch() noexcept override { return true; }
 
+            /* IMappedDataStream */
+            const char* Borrow(PositionType bytes, PositionType* borrowed) noexcept override;
+
+            bool IsMapped() const noexcept { return this->mapped.load() != nullptr; }
+
+            /* true if the file is mapped, and the start of it was already in
+            the page cache when it was opened. reading it won't stall on disk. */
+            bool IsResident() const noexcept { return this->IsMapped() && this->resident; }
+
         private:
+            bool Map(const char* filename);
+            void Unmap() noexcept;
+            void Readahead(PositionType position) noexcept;
+
             OpenFlags flags { OpenFlags::None };
             std::string extension;
             std::string uri;
             std::atomic<FILE*> file;
+            std::atomic<const char*> mapped;
+            std::atomic<PositionType> mappedPosition;
             long filesize;
+            bool resident;
     };
 
 } } }
\ No newline at end of file
@@ -0,0 +1,270 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "pch.hpp"
+
+#include <musikcore/io/PrefetchDataStream.h>
+#include <musikcore/io/IoScheduler.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace musik::core::io;
+using namespace musik::core::sdk;
+
+/* each read issued to the wrapped stream asks for this much... */
+static const PositionType kChunkSize = 256 * 1024;
+
+/* ...and we stop reading ahead once this much is buffered. */
+static const PositionType kMaxBuffered = 4 * kChunkSize;
+
+struct PrefetchDataStream::State {
+    struct Chunk {
+        PositionType offset;
+        std::vector<char> data;
+    };
+
+    ~State() {
+        if (this->stream) {
+            this->stream->Release();
+        }
+    }
+
+    IDataStream* stream { nullptr };
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<Chunk> chunks; /* contiguous, starting at or before `position` */
+    PositionType position { 0 }; /* the consumer's read position */
+    PositionType fetchPosition { 0 }; /* where the next read ahead starts */
+    size_t generation { 0 }; /* bumped on seek, so stale reads get dropped */
+    IoScheduler::Class ioClass { IoScheduler::Class::Playback }; /* of the opening thread */
+    bool seekable { false };
+    bool fetching { false };
+    bool eof { false };
+    bool closed { false };
+};
+
+using State = PrefetchDataStream::State;
+
+/* must be called with state->mutex held. the wrapped stream is only ever
+touched by the single outstanding fetch, so it doesn't need to be thread
+safe itself. */
+static void scheduleFetch(std::shared_ptr<State> state) {
+    if (state->fetching || state->eof || state->closed) {
+        return;
+    }
+
+    if (state->fetchPosition - state->position >= kMaxBuffered) {
+        return;
+    }
+
+    state->fetching = true;
+
+    const size_t generation = state->generation;
+    const PositionType offset = state->fetchPosition;
+
+    IoScheduler::Instance().Submit([state, generation, offset]() {
+        State::Chunk chunk { offset, std::vector<char>((size_t) kChunkSize) };
+
+        PositionType count = 0;
+        if (state->stream->Position() == offset || state->stream->SetPosition(offset)) {
+            count = state->stream->Read(chunk.data.data(), kChunkSize);
+        }
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+
+        state->fetching = false;
+
+        if (generation == state->generation && !state->closed) {
+            if (count > 0) {
+                chunk.data.resize((size_t) count);
+                state->chunks.push_back(std::move(chunk));
+                state->fetchPosition = offset + count;
+            }
+            else {
+                state->eof = true;
+            }
+        }
+
+        scheduleFetch(state);
+        state->condition.notify_all();
+    },
+    state->ioClass);
+}
+
+PrefetchDataStream::PrefetchDataStream(IDataStream* stream)
+: state(std::make_shared<State>()) {
+    this->state->stream = stream;
+    this->state->ioClass = IoScheduler::CurrentClass();
+    this->state->seekable = stream->Seekable();
+    this->state->position = this->state->fetchPosition = stream->Position();
+
+    std::unique_lock<std::mutex> lock(this->state->mutex);
+    scheduleFetch(this->state);
+}
+
+PrefetchDataStream::~PrefetchDataStream() noexcept {
+    this->Close();
+}
+
+bool PrefetchDataStream::Open(const char *uri, OpenFlags flags) {
+    return false; /* wraps streams that are already open */
+}
+
+bool PrefetchDataStream::Close() noexcept {
+    std::unique_lock<std::mutex> lock(this->state->mutex);
+    this->state->closed = true;
+    this->state->chunks.clear();
+    this->state->condition.notify_all();
+    return true;
+}
+
+void PrefetchDataStream::Interrupt() noexcept {
+    this->state->stream->Interrupt();
+    this->Close();
+}
+
+void PrefetchDataStream::Release() noexcept {
+    delete this;
+}
+
+PositionType PrefetchDataStream::Read(void* buffer, PositionType readBytes) {
+    auto& state = *this->state;
+    std::unique_lock<std::mutex> lock(state.mutex);
+
+    PositionType copied = 0;
+    char* target = static_cast<char*>(buffer);
+
+    while (copied < readBytes && !state.closed) {
+        if (!state.chunks.empty()) {
+            auto& front = state.chunks.front();
+            const PositionType start = state.position - front.offset;
+            const PositionType available = (PositionType) front.data.size() - start;
+
+            if (available <= 0) {
+                state.chunks.pop_front();
+                continue;
+            }
+
+            const PositionType count = std::min(available, readBytes - copied);
+            memcpy(target + copied, front.data.data() + start, (size_t) count);
+            copied += count;
+            state.position += count;
+
+            if (count == available) {
+                state.chunks.pop_front();
+            }
+
+            scheduleFetch(this->state);
+            continue;
+        }
+
+        if (state.eof) {
+            break;
+        }
+
+        /* we caught up with the read ahead; wait for it. */
+        scheduleFetch(this->state);
+        state.condition.wait(lock);
+    }
+
+    return copied;
+}
+
+PositionType PrefetchDataStream::Write(void* buffer, PositionType writeBytes) noexcept {
+    return 0;
+}
+
+bool PrefetchDataStream::SetPosition(PositionType position) {
+    auto& state = *this->state;
+    std::unique_lock<std::mutex> lock(state.mutex);
+
+    if (state.closed || position < 0) {
+        return false;
+    }
+
+    /* a stream that can't seek can only be "seeked" to where it already is */
+    if (!state.seekable && position != state.position) {
+        return false;
+    }
+
+    /* short seeks within what we've already buffered are free */
+    if (!state.chunks.empty() &&
+        position >= state.chunks.front().offset &&
+        position < state.fetchPosition)
+    {
+        while (position >= state.chunks.front().offset + (PositionType) state.chunks.front().data.size()) {
+            state.chunks.pop_front();
+        }
+        state.position = position;
+        return true;
+    }
+
+    state.chunks.clear();
+    state.position = state.fetchPosition = position;
+    state.eof = false;
+    ++state.generation;
+    scheduleFetch(this->state);
+    return true;
+}
+
+PositionType PrefetchDataStream::Position() {
+    std::unique_lock<std::mutex> lock(this->state->mutex);
+    return this->state->position;
+}
+
+bool PrefetchDataStream::Eof() {
+    std::unique_lock<std::mutex> lock(this->state->mutex);
+    return this->state->closed || (this->state->eof && this->state->chunks.empty());
+}
+
+long PrefetchDataStream::Length() {
+    return this->state->stream->Length();
+}
+
+bool PrefetchDataStream::Seekable() {
+    return this->state->stream->Seekable();
+}
+
+const char* PrefetchDataStream::Type() {
+    return this->state->stream->Type();
+}
+
+const char* PrefetchDataStream::Uri() {
+    return this->state->stream->Uri();
+}
+
+bool PrefetchDataStream::CanPrefetch() {
+    return false; /* already reading ahead; never wrap us again */
+}
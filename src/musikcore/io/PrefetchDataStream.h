@@ -0,0 +1,84 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <musikcore/config.h>
+#include <musikcore/sdk/IDataStream.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace musik { namespace core { namespace io {
+
+    /* wraps a readable IDataStream and keeps reading ahead of the consumer on
+    the IoScheduler's threads, so decoding and disk io overlap instead of
+    taking turns. takes ownership of the wrapped stream. */
+    class PrefetchDataStream : public musik::core::sdk::IDataStream {
+        public:
+            using PositionType = musik::core::sdk::PositionType;
+            using OpenFlags = musik::core::sdk::OpenFlags;
+
+            DELETE_COPY_AND_ASSIGNMENT_DEFAULTS(PrefetchDataStream)
+
+            PrefetchDataStream(musik::core::sdk::IDataStream* stream);
+            virtual ~PrefetchDataStream() noexcept;
+
+            bool Open(const char *uri, OpenFlags flags) override;
+            bool Close() noexcept override;
+            void Interrupt() noexcept override;
+            void Release() noexcept override;
+            bool Readable() noexcept override { return true; }
+            bool Writable() noexcept override { return false; }
+            PositionType Read(void* buffer, PositionType readBytes) override;
+            PositionType Write(void* buffer, PositionType writeBytes) noexcept override;
+            bool SetPosition(PositionType position) override;
+            PositionType Position() override;
+            bool Eof() override;
+            long Length() override;
+            bool Seekable() override;
+            const char* Type() override;
+            const char* Uri() override;
+            bool CanPrefetch() override;
+
+            struct State;
+
+        private:
+            std::shared_ptr<State> state;
+    };
+
+} } }
@@ -53,17 +53,22 @@
 #include <musikcore/sdk/IAnalyzer.h>
 #include <musikcore/sdk/IIndexerSource.h>
 #include <musikcore/audio/Stream.h>
+#include <musikcore/io/IoScheduler.h>
 #include <musikcore/support/ThreadGroup.h>
 
 #include <filesystem>
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <functional>
+#include <unordered_map>
+#include <unordered_set>
 
 #define STRESS_TEST_DB 0
 
 constexpr const char* TAG = "Indexer";
 constexpr size_t TRANSACTION_INTERVAL = 300;
+constexpr size_t DELETE_BATCH_SIZE = 500;
 static FILE* logFile = nullptr;
 
 #ifdef __arm__
@@ -82,6 +87,7 @@ using namespace musik::core::audio;
 using namespace musik::core::library;
 using namespace musik::core::db;
 using namespace musik::core::library::query;
+using musik::core::io::IoScheduler;
 
 using Thread = std::unique_ptr<std::thread>;
 
@@ -89,6 +95,111 @@ using TagReaderDestroyer = PluginFactory::ReleaseDeleter<ITagReader>;
 using DecoderDeleter = PluginFactory::ReleaseDeleter<IDecoderFactory>;
 using SourceDeleter = PluginFactory::ReleaseDeleter<IIndexerSource>;
 
+/* free pages are only reclaimed once there are at least this many of them,
+and they make up at least 1/kVacuumFreePageRatio of the file. */
+constexpr int64_t kVacuumMinFreePages = 1024;
+constexpr int64_t kVacuumFreePageRatio = 10;
+constexpr int64_t kVacuumPagesPerStep = 2048;
+
+/* connection-local (temp) triggers that record every artist, album, genre,
+etc. that lost a reference while syncing. SyncCleanup() only needs to look
+at those rows, instead of scanning every table for orphans. */
+static const char* kChangeTrackingSchema[] = {
+    "CREATE TEMP TABLE IF NOT EXISTS sync_changes ("
+        "type TEXT, "
+        "id INTEGER, "
+        "PRIMARY KEY (type, id)) WITHOUT ROWID",
+
+    /* note: rows with NULL ids are skipped by OR IGNORE */
+    "CREATE TEMP TRIGGER IF NOT EXISTS sync_tracks_deleted "
+    "AFTER DELETE ON main.tracks BEGIN "
+        "INSERT OR IGNORE INTO sync_changes VALUES "
+            "('track', old.id), "
+            "('artist', old.visual_artist_id), "
+            "('artist', old.album_artist_id), "
+            "('genre', old.visual_genre_id), "
+            "('album', old.album_id), "
+            "('directory', old.directory_id); "
+    "END",
+
+    "CREATE TEMP TRIGGER IF NOT EXISTS sync_tracks_updated "
+    "AFTER UPDATE OF visual_artist_id, album_artist_id, visual_genre_id, album_id, directory_id "
+    "ON main.tracks BEGIN "
+        "INSERT OR IGNORE INTO sync_changes VALUES "
+            "('artist', old.visual_artist_id), "
+            "('artist', old.album_artist_id), "
+            "('genre', old.visual_genre_id), "
+            "('album', old.album_id), "
+            "('directory', old.directory_id); "
+    "END",
+
+    "CREATE TEMP TRIGGER IF NOT EXISTS sync_track_artists_deleted "
+    "AFTER DELETE ON main.track_artists BEGIN "
+        "INSERT OR IGNORE INTO sync_changes VALUES ('artist', old.artist_id); "
+    "END",
+
+    "CREATE TEMP TRIGGER IF NOT EXISTS sync_track_genres_deleted "
+    "AFTER DELETE ON main.track_genres BEGIN "
+        "INSERT OR IGNORE INTO sync_changes VALUES ('genre', old.genre_id); "
+    "END",
+
+    "CREATE TEMP TRIGGER IF NOT EXISTS sync_track_meta_deleted "
+    "AFTER DELETE ON main.track_meta BEGIN "
+        "INSERT OR IGNORE INTO sync_changes VALUES ('meta_value', old.meta_value_id); "
+    "END",
+
+    "CREATE TEMP TRIGGER IF NOT EXISTS sync_meta_values_deleted "
+    "AFTER DELETE ON main.meta_values BEGIN "
+        "INSERT OR IGNORE INTO sync_changes VALUES ('meta_key', old.meta_key_id); "
+    "END",
+
+    "CREATE TEMP TRIGGER IF NOT EXISTS sync_playlist_tracks_deleted "
+    "AFTER DELETE ON main.playlist_tracks BEGIN "
+        "INSERT OR IGNORE INTO sync_changes VALUES ('playlist', old.playlist_id); "
+    "END",
+};
+
+/* order matters: removing child rows marks more categories as changed. */
+static const char* kIncrementalCleanup[] = {
+    "DELETE FROM track_artists WHERE track_id IN (SELECT id FROM sync_changes WHERE type='track') AND track_id NOT IN (SELECT id FROM tracks)",
+    "DELETE FROM track_genres WHERE track_id IN (SELECT id FROM sync_changes WHERE type='track') AND track_id NOT IN (SELECT id FROM tracks)",
+    "DELETE FROM track_meta WHERE track_id IN (SELECT id FROM sync_changes WHERE type='track') AND track_id NOT IN (SELECT id FROM tracks)",
+    "DELETE FROM replay_gain WHERE track_id IN (SELECT id FROM sync_changes WHERE type='track') AND track_id NOT IN (SELECT id FROM tracks)",
+
+    "DELETE FROM artists WHERE id IN (SELECT id FROM sync_changes WHERE type='artist') "
+        "AND NOT EXISTS (SELECT 1 FROM tracks WHERE visual_artist_id=artists.id) "
+        "AND NOT EXISTS (SELECT 1 FROM tracks WHERE album_artist_id=artists.id) "
+        "AND NOT EXISTS (SELECT 1 FROM track_artists WHERE artist_id=artists.id)",
+
+    "DELETE FROM genres WHERE id IN (SELECT id FROM sync_changes WHERE type='genre') "
+        "AND NOT EXISTS (SELECT 1 FROM tracks WHERE visual_genre_id=genres.id) "
+        "AND NOT EXISTS (SELECT 1 FROM track_genres WHERE genre_id=genres.id)",
+
+    "DELETE FROM albums WHERE id IN (SELECT id FROM sync_changes WHERE type='album') "
+        "AND NOT EXISTS (SELECT 1 FROM tracks WHERE album_id=albums.id)",
+
+    "DELETE FROM meta_values WHERE id IN (SELECT id FROM sync_changes WHERE type='meta_value') "
+        "AND NOT EXISTS (SELECT 1 FROM track_meta WHERE meta_value_id=meta_values.id)",
+
+    "DELETE FROM meta_keys WHERE id IN (SELECT id FROM sync_changes WHERE type='meta_key') "
+        "AND NOT EXISTS (SELECT 1 FROM meta_values WHERE meta_key_id=meta_keys.id)",
+
+    "DELETE FROM directories WHERE id IN (SELECT id FROM sync_changes WHERE type='directory') "
+        "AND NOT EXISTS (SELECT 1 FROM tracks WHERE directory_id=directories.id)",
+};
+
+static void startChangeTracking(db::Connection& db) {
+    for (auto sql : kChangeTrackingSchema) {
+        db.Execute(sql);
+    }
+    db.Execute("DELETE FROM sync_changes");
+}
+
+static int64_t pragmaValue(db::Connection& connection, const char* pragma) {
+    db::Statement stmt(pragma, connection);
+    return (stmt.Step() == db::Row) ? stmt.ColumnInt64(0) : 0;
+}
+
 static void openLogFile() {
     if (!logFile) {
         std::string path = GetDataDirectory() + "/indexer_log.txt";
@@ -279,6 +390,8 @@ void Indexer::Synchronize(const SyncContext& context, asio::io_service* io) {
     }
 
     /* refresh sources */
+    this->fileSources.clear();
+
     for (auto it : this->sources) {
         if (this->Bail()) {
             break;
@@ -288,11 +401,21 @@ void Indexer::Synchronize(const SyncContext& context, asio::io_service* io) {
             continue; /* asked to scan a specific source, and this isn't it. */
         }
 
-        this->currentSource = it;
-        if (this->SyncSource(it.get(), paths) == ScanRollback) {
-            this->trackTransaction->Cancel();
+        /* sources that support it get their files from the walk below,
+        instead of walking the same directories again themselves. */
+        auto fileSource = dynamic_cast<IIndexerFileSource*>(it.get());
+        if (fileSource) {
+            if (this->BeginFileSource(fileSource, paths)) {
+                this->fileSources.push_back(fileSource);
+            }
+        }
+        else {
+            this->currentSource = it;
+            if (this->SyncSource(it.get(), paths) == ScanRollback) {
+                this->trackTransaction->Cancel();
+            }
+            this->trackTransaction->CommitAndRestart();
         }
-        this->trackTransaction->CommitAndRestart();
 
         if (sourceId != 0) {
             break; /* done with the one we were asked to scan */
@@ -301,8 +424,11 @@ void Indexer::Synchronize(const SyncContext& context, asio::io_service* io) {
 
     this->currentSource.reset();
 
-    /* process local files */
-    if (type != SyncType::Sources) {
+    /* process local files. this is a single walk: each file is offered to
+    the tag readers and to any file sources that want it. */
+    this->scanLocalFiles = type != SyncType::Sources;
+
+    if (this->scanLocalFiles || this->fileSources.size()) {
         if (logFile) {
             fprintf(logFile, "\n\nSYNCING LOCAL FILES:\n");
         }
@@ -322,6 +448,23 @@ void Indexer::Synchronize(const SyncContext& context, asio::io_service* io) {
 }
 
 void Indexer::FinalizeSync(const SyncContext& context) {
+    /* by now the indexer pool has drained, so anything the walk offered
+    to the file sources has been processed. */
+    this->FinishFileSources();
+
+    /* artwork is saved on a pool of its own, on this connection. it has to
+    land before anything below deletes or renumbers albums. */
+    {
+        const auto flushStart = std::chrono::steady_clock::now();
+        const size_t albums = IndexerTrack::FlushThumbnails(this->dbConnection);
+        const double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - flushStart).count();
+
+        musik::debug::info(TAG, u8fmt(
+            "artwork saved for %d albums, waited %.2fs for the artwork pool",
+            (int) albums, seconds));
+    }
+
     /* remove undesired entries from db (files themselves will remain) */
     musik::debug::info(TAG, "cleanup 1/2");
 
@@ -337,14 +480,16 @@ void Indexer::FinalizeSync(const SyncContext& context) {
     musik::debug::info(TAG, "cleanup 2/2");
 
     if (!this->Bail()) {
-        this->SyncCleanup();
+        /* a rebuild is our chance to catch anything the change tracking
+        couldn't see, e.g. rows orphaned by an older version of the app. */
+        this->SyncCleanup(type == SyncType::Rebuild);
     }
 
     /* optimize and sort */
     musik::debug::info(TAG, "optimizing");
 
     if (!this->Bail()) {
-        this->SyncOptimize();
+        this->SyncOptimize(type == SyncType::Rebuild);
     }
 
     /* run analyzers. */
@@ -380,6 +525,11 @@ void Indexer::ReadMetadataFromFile(
 
         bool saveToDb = false;
 
+        /* tag readers do their own blocking reads; hold off while the
+        player is short on buffered audio. */
+        IoScheduler::Scope ioScope(IoScheduler::Class::Indexer);
+        IoScheduler::Instance().WaitIfThrottled();
+
         /* read the tag from the plugin */
         TagStore store(track);
         typedef TagReaderList::iterator Iterator;
@@ -440,6 +590,31 @@ void Indexer::ReadMetadataFromFile(
     this->IncrementTracksScanned();
 }
 
+void Indexer::IndexFileForSource(
+    asio::io_service* io,
+    IIndexerFileSource* source,
+    const std::fs::path& file)
+{
+    if (io && this->Bail()) {
+        if (!io->stopped()) {
+            musik::debug::info(TAG, "run aborted");
+            io->stop();
+        }
+        return;
+    }
+
+    IoScheduler::Scope ioScope(IoScheduler::Class::Indexer);
+    IoScheduler::Instance().WaitIfThrottled();
+
+    try {
+        source->IndexFile(this, file.u8string().c_str());
+    }
+    catch (...) {
+        debug::error(TAG, u8fmt("indexer source %d failed to index %s",
+            source->SourceId(), file.u8string().c_str()));
+    }
+}
+
 inline void Indexer::IncrementTracksScanned(int delta) {
     std::unique_lock<std::mutex> lock(IndexerTrack::sharedWriteMutex);
 
@@ -487,20 +662,37 @@ void Indexer::SyncDirectory(
             else {
                 try {
                     std::string extension = file->path().extension().u8string();
-                    for (auto it : this->tagReaders) {
-                        if (it->CanRead(extension.c_str())) {
+                    if (this->scanLocalFiles) {
+                        for (auto it : this->tagReaders) {
+                            if (it->CanRead(extension.c_str())) {
+                                if (io) {
+                                    io->post(std::bind(
+                                        &Indexer::ReadMetadataFromFile,
+                                        this,
+                                        io,
+                                        file->path(),
+                                        pathIdStr));
+                                }
+                                else {
+                                    this->ReadMetadataFromFile(nullptr, file->path(), pathIdStr);
+                                }
+                                break;
+                            }
+                        }
+                    }
+                    for (auto source : this->fileSources) {
+                        if (source->CanIndexFile(extension.c_str())) {
                             if (io) {
                                 io->post(std::bind(
-                                    &Indexer::ReadMetadataFromFile,
+                                    &Indexer::IndexFileForSource,
                                     this,
                                     io,
-                                    file->path(),
-                                    pathIdStr));
+                                    source,
+                                    file->path()));
                             }
                             else {
-                                this->ReadMetadataFromFile(nullptr, file->path(), pathIdStr);
+                                this->IndexFileForSource(nullptr, source, file->path());
                             }
-                            break;
                         }
                     }
                 }
@@ -559,37 +751,91 @@ ScanResult Indexer::SyncSource(
 
         /* finally, allow the source to update metadata for any tracks that it
         previously indexed, if it needs to. */
-        {
-            if (!this->Bail() && source->NeedsTrackScan()) {
-                db::Statement tracks(
-                    "SELECT id, filename, external_id FROM tracks WHERE source_id=? ORDER BY id",
-                    this->dbConnection);
-
-                tracks.BindInt32(0, source->SourceId());
-                while (tracks.Step() == db::Row) {
-                    TrackPtr track = std::make_shared<IndexerTrack>(tracks.ColumnInt64(0));
-                    track->SetValue(constants::Track::FILENAME, tracks.ColumnText(1));
-
-                    if (logFile) {
-                        fprintf(logFile, "    - %s\n", track->GetString(constants::Track::FILENAME).c_str());
-                    }
+        this->ScanSourceTracks(source);
 
-                    TagStore* store = new TagStore(track);
-                    source->ScanTrack(this, store, tracks.ColumnText(2));
-                    store->Release();
-                }
+        debug::info(TAG, u8fmt("indexer source %d finished", source->SourceId()));
+    }
+    catch (...) {
+        debug::error(TAG, u8fmt("indexer source %d crashed", source->SourceId()));
+    }
+
+    source->OnAfterScan();
+
+    return result;
+}
+
+void Indexer::ScanSourceTracks(IIndexerSource* source) {
+    if (!this->Bail() && source->NeedsTrackScan()) {
+        db::Statement tracks(
+            "SELECT id, filename, external_id FROM tracks WHERE source_id=? ORDER BY id",
+            this->dbConnection);
+
+        tracks.BindInt32(0, source->SourceId());
+        while (tracks.Step() == db::Row) {
+            TrackPtr track = std::make_shared<IndexerTrack>(tracks.ColumnInt64(0));
+            track->SetValue(constants::Track::FILENAME, tracks.ColumnText(1));
+
+            if (logFile) {
+                fprintf(logFile, "    - %s\n", track->GetString(constants::Track::FILENAME).c_str());
             }
+
+            TagStore* store = new TagStore(track);
+            source->ScanTrack(this, store, tracks.ColumnText(2));
+            store->Release();
         }
+    }
+}
 
-        debug::info(TAG, u8fmt("indexer source %d finished", source->SourceId()));
+/* the first half of SyncSource() for sources that let us walk the filesystem
+for them; FinishFileSources() does the rest once the walk is done. */
+bool Indexer::BeginFileSource(
+    IIndexerFileSource* source,
+    const std::vector<std::string>& paths)
+{
+    debug::info(TAG, u8fmt("indexer source %d running (shared walk)...", source->SourceId()));
+
+    if (source->SourceId() == 0) {
+        return false;
+    }
+
+    source->OnBeforeScan();
+
+    std::vector<const char*> pathsList;
+    for (auto& p : paths) {
+        pathsList.push_back(p.c_str());
+    }
+
+    try {
+        source->BeginFileScan(this, pathsList.data(), (unsigned int) pathsList.size());
+        return true;
     }
     catch (...) {
         debug::error(TAG, u8fmt("indexer source %d crashed", source->SourceId()));
     }
 
     source->OnAfterScan();
+    return false;
+}
 
-    return result;
+void Indexer::FinishFileSources() {
+    for (auto source : this->fileSources) {
+        try {
+            source->EndFileScan(this);
+            this->ScanSourceTracks(source);
+            debug::info(TAG, u8fmt("indexer source %d finished", source->SourceId()));
+        }
+        catch (...) {
+            debug::error(TAG, u8fmt("indexer source %d crashed", source->SourceId()));
+        }
+
+        source->OnAfterScan();
+
+        if (this->trackTransaction) {
+            this->trackTransaction->CommitAndRestart();
+        }
+    }
+
+    this->fileSources.clear();
 }
 
 void Indexer::ThreadLoop() {
@@ -620,11 +866,14 @@ void Indexer::ThreadLoop() {
         this->Started();
 
         this->dbConnection.Open(this->dbFilename.c_str(), 0);
+        startChangeTracking(this->dbConnection);
         this->trackTransaction = std::make_shared<db::ScopedTransaction>(this->dbConnection);
 
         const int threadCount = prefs->GetInt(
             prefs::keys::IndexerThreadCount, DEFAULT_MAX_THREADS);
 
+        const auto syncStart = std::chrono::steady_clock::now();
+
         if (threadCount > 1) {
             asio::io_service io;
             asio::io_service::work work(io);
@@ -654,10 +903,29 @@ void Indexer::ThreadLoop() {
             this->Synchronize(context, nullptr);
         }
 
+        /* files read (tags, artwork) per second; the number to watch when
+        tuning the scan pipeline. */
+        {
+            const double seconds = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - syncStart).count();
+
+            musik::debug::info(TAG, u8fmt(
+                "synchronized %d files in %.2fs (%.1f files/s, %d threads)",
+                (int) this->totalUrisScanned,
+                seconds,
+                seconds > 0.0 ? (double) this->totalUrisScanned / seconds : 0.0,
+                threadCount));
+        }
+
         this->FinalizeSync(context);
 
         this->trackTransaction.reset();
 
+        /* outside of the transaction, so we're able to vacuum if necessary */
+        if (!this->Bail()) {
+            this->SyncVacuum();
+        }
+
         this->dbConnection.Close();
 
         if (!this->Bail()) {
@@ -669,6 +937,85 @@ void Indexer::ThreadLoop() {
     }
 }
 
+/* all of the tracks that live in a single directory. SyncDelete() lists the
+directory once, instead of stat'ing each file individually. */
+struct DirectoryCheck {
+    std::string path;
+    int64_t directoryId{ -1 };
+    int64_t storedModified{ 0 };
+    int64_t modified{ 0 };
+    std::vector<std::pair<int64_t, std::string>> tracks; /* (id, filename) */
+    std::vector<int64_t> missing;
+    bool failed{ false }; /* couldn't be listed; leave everything alone */
+};
+
+static int64_t directoryModifiedTime(const std::fs::path& dir) {
+    std::error_code ec;
+    auto time = std::fs::last_write_time(dir, ec);
+    return ec ? 0 : (int64_t) time.time_since_epoch().count();
+}
+
+static void checkDirectory(DirectoryCheck& check, bool skipUnchanged) {
+    /* any error while listing (EACCES, EIO, a stale network mount) means we
+    don't know what's there. bail without removing anything, and don't record
+    the modified time so the directory is checked again next sync. */
+    auto fail = [&check]() {
+        check.failed = true;
+        check.missing.clear();
+    };
+
+    try {
+        const std::fs::path dir(std::fs::u8path(check.path));
+
+        check.modified = directoryModifiedTime(dir);
+
+        /* removing a file from a directory updates the directory's modified
+        time, so if it hasn't changed, neither has the set of files in it. */
+        if (skipUnchanged && check.modified != 0 && check.modified == check.storedModified) {
+            return;
+        }
+
+        std::error_code ec;
+        const bool dirExists = std::fs::exists(dir, ec);
+        if (ec) {
+            return fail();
+        }
+
+        if (!dirExists) {
+            for (auto& track : check.tracks) {
+                check.missing.push_back(track.first);
+            }
+            return;
+        }
+
+        std::unordered_set<std::string> present;
+        for (auto it = std::fs::directory_iterator(dir, ec); !ec && it != std::fs::directory_iterator(); it.increment(ec)) {
+            present.insert(it->path().u8string());
+        }
+
+        if (ec) {
+            return fail();
+        }
+
+        for (auto& track : check.tracks) {
+            if (present.find(track.second) == present.end()) {
+                /* the listing may spell the path differently than we stored
+                it; make sure it's really gone before removing it. */
+                const bool fileExists = std::fs::exists(std::fs::u8path(track.second), ec);
+                if (ec) {
+                    return fail();
+                }
+                if (!fileExists) {
+                    check.missing.push_back(track.first);
+                }
+            }
+        }
+    }
+    catch (...) {
+        fail();
+    }
+}
+
 void Indexer::SyncDelete() {
     /* remove all tracks that no longer reference a valid path entry */
 
@@ -676,57 +1023,136 @@ void Indexer::SyncDelete() {
 
     /* remove files that are no longer on the filesystem. */
 
-    if (prefs->GetBool(prefs::keys::RemoveMissingFiles, true)) {
-        db::Statement stmtRemove("DELETE FROM tracks WHERE id=?", this->dbConnection);
+    if (!prefs->GetBool(prefs::keys::RemoveMissingFiles, true)) {
+        return;
+    }
+
+    const bool skipUnchanged = prefs->GetBool(prefs::keys::IndexerSkipUnchangedDirectories, false);
+
+    /* group tracks by the directory they live in */
+    std::vector<DirectoryCheck> directories;
+    {
+        std::unordered_map<std::string, size_t> index;
 
         db::Statement allTracks(
-            "SELECT t.id, t.filename "
+            "SELECT t.id, t.filename, t.directory_id, d.mtime "
             "FROM tracks t "
+            "LEFT JOIN directories d ON t.directory_id=d.id "
             "WHERE source_id == 0", /* IIndexerSources delete their own tracks */
             this->dbConnection);
 
         while (allTracks.Step() == db::Row && !this->Bail()) {
-            bool remove = false;
             std::string fn = allTracks.ColumnText(1);
+            std::string dir;
 
             try {
-                std::fs::path file(std::fs::u8path(fn));
-                if (!std::fs::exists(file)) {
-                    remove = true;
-                }
+                dir = std::fs::u8path(fn).parent_path().u8string();
             }
             catch (...) {
+                continue;
             }
 
-            if (remove) {
-                stmtRemove.BindInt32(0, allTracks.ColumnInt32(0));
-                stmtRemove.Step();
-                stmtRemove.Reset();
+            auto it = index.find(dir);
+            if (it == index.end()) {
+                it = index.insert({ dir, directories.size() }).first;
+                directories.emplace_back();
+                directories.back().path = dir;
+                if (!allTracks.IsNull(2)) {
+                    directories.back().directoryId = allTracks.ColumnInt64(2);
+                    directories.back().storedModified = allTracks.ColumnInt64(3);
+                }
             }
+
+            directories[it->second].tracks.push_back({ allTracks.ColumnInt64(0), fn });
         }
     }
+
+    /* network storage makes each check a round trip, so fan them out */
+    const int threadCount = std::max(1, std::min(
+        (int) directories.size(),
+        prefs->GetInt(prefs::keys::IndexerThreadCount, DEFAULT_MAX_THREADS)));
+
+    std::atomic<size_t> next(0);
+    auto worker = [this, &directories, &next, skipUnchanged]() {
+        size_t i;
+        while (!this->Bail() && (i = next++) < directories.size()) {
+            checkDirectory(directories[i], skipUnchanged);
+        }
+    };
+
+    {
+        ThreadGroup threadGroup;
+        for (int i = 0; i < threadCount; i++) {
+            threadGroup.create_thread(worker);
+        }
+        threadGroup.join_all();
+    }
+
+    if (this->Bail()) {
+        return;
+    }
+
+    /* remove in batches, rather than one statement per track */
+    std::vector<int64_t> missing;
+    for (auto& check : directories) {
+        missing.insert(missing.end(), check.missing.begin(), check.missing.end());
+    }
+
+    for (size_t i = 0; i < missing.size(); i += DELETE_BATCH_SIZE) {
+        std::string ids;
+        const size_t end = std::min(missing.size(), i + DELETE_BATCH_SIZE);
+        for (size_t j = i; j < end; j++) {
+            ids += (j == i ? "" : ",") + std::to_string(missing[j]);
+        }
+        this->dbConnection.Execute(("DELETE FROM tracks WHERE id IN (" + ids + ")").c_str());
+    }
+
+    /* remember what we saw, so unchanged directories can be skipped next time */
+    db::Statement updateModified("UPDATE directories SET mtime=? WHERE id=?", this->dbConnection);
+    for (auto& check : directories) {
+        if (!check.failed && check.directoryId != -1 && check.modified != check.storedModified) {
+            updateModified.BindInt64(0, check.modified);
+            updateModified.BindInt64(1, check.directoryId);
+            updateModified.Step();
+            updateModified.Reset();
+        }
+    }
+
+    if (missing.size()) {
+        musik::debug::info(TAG, u8fmt(
+            "removed %d missing tracks from %d directories",
+            (int) missing.size(), (int) directories.size()));
+    }
 }
 
-void Indexer::SyncCleanup() {
-    /* remove old artists */
-    this->dbConnection.Execute("DELETE FROM track_artists WHERE track_id NOT IN (SELECT id FROM tracks)");
-    this->dbConnection.Execute("DELETE FROM artists WHERE id NOT IN (SELECT DISTINCT(visual_artist_id) FROM tracks) AND id NOT IN (SELECT DISTINCT(album_artist_id) FROM tracks) AND id NOT IN (SELECT DISTINCT(artist_id) FROM track_artists)");
+void Indexer::SyncCleanup(bool full) {
+    if (full) {
+        /* remove old artists */
+        this->dbConnection.Execute("DELETE FROM track_artists WHERE track_id NOT IN (SELECT id FROM tracks)");
+        this->dbConnection.Execute("DELETE FROM artists WHERE id NOT IN (SELECT DISTINCT(visual_artist_id) FROM tracks) AND id NOT IN (SELECT DISTINCT(album_artist_id) FROM tracks) AND id NOT IN (SELECT DISTINCT(artist_id) FROM track_artists)");
 
-    /* remove old genres */
-    this->dbConnection.Execute("DELETE FROM track_genres WHERE track_id NOT IN (SELECT id FROM tracks)");
-    this->dbConnection.Execute("DELETE FROM genres WHERE id NOT IN (SELECT DISTINCT(visual_genre_id) FROM tracks) AND id NOT IN (SELECT DISTINCT(genre_id) FROM track_genres)");
+        /* remove old genres */
+        this->dbConnection.Execute("DELETE FROM track_genres WHERE track_id NOT IN (SELECT id FROM tracks)");
+        this->dbConnection.Execute("DELETE FROM genres WHERE id NOT IN (SELECT DISTINCT(visual_genre_id) FROM tracks) AND id NOT IN (SELECT DISTINCT(genre_id) FROM track_genres)");
 
-    /* remove old albums */
-    this->dbConnection.Execute("DELETE FROM albums WHERE id NOT IN (SELECT DISTINCT(album_id) FROM tracks)");
+        /* remove old albums */
+        this->dbConnection.Execute("DELETE FROM albums WHERE id NOT IN (SELECT DISTINCT(album_id) FROM tracks)");
 
-    /* orphaned metadata */
-    this->dbConnection.Execute("DELETE FROM track_meta WHERE track_id NOT IN (SELECT id FROM tracks)");
-    this->dbConnection.Execute("DELETE FROM meta_values WHERE id NOT IN (SELECT DISTINCT(meta_value_id) FROM track_meta)");
-    this->dbConnection.Execute("DELETE FROM meta_keys WHERE id NOT IN (SELECT DISTINCT(meta_key_id) FROM meta_values)");
+        /* orphaned metadata */
+        this->dbConnection.Execute("DELETE FROM track_meta WHERE track_id NOT IN (SELECT id FROM tracks)");
+        this->dbConnection.Execute("DELETE FROM meta_values WHERE id NOT IN (SELECT DISTINCT(meta_value_id) FROM track_meta)");
+        this->dbConnection.Execute("DELETE FROM meta_keys WHERE id NOT IN (SELECT DISTINCT(meta_key_id) FROM meta_values)");
 
-    /* orphaned replay gain and directories */
-    this->dbConnection.Execute("DELETE FROM replay_gain WHERE track_id NOT IN (SELECT id FROM tracks)");
-    this->dbConnection.Execute("DELETE FROM directories WHERE id NOT IN (SELECT DISTINCT directory_id FROM tracks)");
+        /* orphaned replay gain and directories */
+        this->dbConnection.Execute("DELETE FROM replay_gain WHERE track_id NOT IN (SELECT id FROM tracks)");
+        this->dbConnection.Execute("DELETE FROM directories WHERE id NOT IN (SELECT DISTINCT directory_id FROM tracks)");
+    }
+    else {
+        /* only look at rows that lost a reference during this sync */
+        for (auto sql : kIncrementalCleanup) {
+            this->dbConnection.Execute(sql);
+        }
+    }
 
     /* NOTE: we used to remove orphaned local library tracks here, but we don't anymore because
     the indexer generates stable external ids by hashing various file and metadata fields */
@@ -749,19 +1175,20 @@ void Indexer::SyncCleanup() {
         }
     }
 
-    this->SyncPlaylistTracksOrder();
-
-    /* optimize and shrink */
-    this->dbConnection.Execute("VACUUM");
+    this->SyncPlaylistTracksOrder(full);
 }
 
-void Indexer::SyncPlaylistTracksOrder() {
+void Indexer::SyncPlaylistTracksOrder(bool full) {
     /* make sure playlist sort orders are always sequential without holes. we
     do this anyway, as playlists are updated, but there's no way to guarantee
-    it stays this way -- plugins, external processes, etc can cause problems */
+    it stays this way -- plugins, external processes, etc can cause problems.
+    unless asked to check everything, only playlists that lost tracks during
+    this sync are renumbered. */
 
     db::Statement playlists(
-        "SELECT DISTINCT id FROM playlists",
+        full
+            ? "SELECT DISTINCT id FROM playlists"
+            : "SELECT DISTINCT id FROM playlists WHERE id IN (SELECT id FROM sync_changes WHERE type='playlist')",
         this->dbConnection);
 
     db::Statement tracks(
@@ -791,6 +1218,11 @@ void Indexer::SyncPlaylistTracksOrder() {
 
         int order = 0;
         for (auto& r : records) {
+            if (r.order == order) {
+                ++order;
+                continue;
+            }
+
             update.ResetAndUnbind();
             update.BindInt32(0, order++);
             update.BindText(1, r.id);
@@ -800,6 +1232,44 @@ void Indexer::SyncPlaylistTracksOrder() {
     }
 }
 
+void Indexer::SyncVacuum() {
+    /* a full VACUUM rewrites the whole database and blocks everyone else
+    while it does. instead, we let free pages accumulate and hand them back
+    to the filesystem in small steps once there are enough of them. */
+    const int64_t pageCount = pragmaValue(this->dbConnection, "PRAGMA page_count");
+    const int64_t freePages = pragmaValue(this->dbConnection, "PRAGMA freelist_count");
+
+    if (freePages < kVacuumMinFreePages || freePages * kVacuumFreePageRatio < pageCount) {
+        return;
+    }
+
+    /* databases created before incremental vacuuming was enabled need to be
+    rebuilt once before incremental_vacuum does anything. */
+    if (pragmaValue(this->dbConnection, "PRAGMA auto_vacuum") != 2) {
+        musik::debug::info(TAG, u8fmt("converting to incremental vacuum (%lld free pages)", (long long) freePages));
+        this->dbConnection.Execute("VACUUM");
+        return;
+    }
+
+    musik::debug::info(TAG, u8fmt("reclaiming %lld free pages", (long long) freePages));
+
+    int64_t remaining = freePages;
+    while (remaining > 0 && !this->Bail()) {
+        const std::string sql = u8fmt("PRAGMA incremental_vacuum(%lld)",
+            (long long) std::min(remaining, kVacuumPagesPerStep));
+
+        db::Statement stmt(sql.c_str(), this->dbConnection);
+        while (stmt.Step() == db::Row) {
+        }
+
+        const int64_t now = pragmaValue(this->dbConnection, "PRAGMA freelist_count");
+        if (now >= remaining) {
+            break; /* no progress */
+        }
+        remaining = now;
+    }
+}
+
 void Indexer::GetPaths(std::vector<std::string>& paths) {
     std::unique_lock<decltype(this->stateMutex)> lock(this->stateMutex);
     std::copy(this->paths.begin(), this->paths.end(), std::back_inserter(paths));
@@ -826,41 +1296,148 @@ std::set<int> Indexer::GetOrphanedSourceIds() {
     return result;
 }
 
-static int optimize(
+/* sort_order values are spaced this far apart, so rows added later can be
+slotted in between their neighbors without renumbering everything. 0 means
+"not placed yet"; it's the column default, so that's what new rows get. */
+constexpr int64_t kSortOrderGap = 1024;
+
+/* renumbers every row in `table` by its normalized `column` value. */
+static void rebalanceSortOrder(
     musik::core::db::Connection &connection,
-    std::string singular,
-    std::string plural)
+    const std::string& table,
+    const std::string& column)
 {
+    std::string select = u8fmt(
+        "SELECT id FROM %s ORDER BY lower(trim(%s))",
+        table.c_str(), column.c_str());
 
-    std::string outer = u8fmt(
-        "SELECT id, lower(trim(name)) AS %s FROM %s ORDER BY %s",
-        singular.c_str(), plural.c_str(), singular.c_str());
+    std::vector<int64_t> ids;
+    {
+        db::Statement stmt(select.c_str(), connection);
+        while (stmt.Step() == db::Row) {
+            ids.push_back(stmt.ColumnInt64(0));
+        }
+    }
 
-    db::Statement outerStmt(outer.c_str(), connection);
+    std::string update = u8fmt("UPDATE %s SET sort_order=? WHERE id=?", table.c_str());
+    db::Statement updateStmt(update.c_str(), connection);
+
+    for (size_t i = 0; i < ids.size(); i++) {
+        updateStmt.BindInt64(0, (int64_t) (i + 1) * kSortOrderGap);
+        updateStmt.BindInt64(1, ids[i]);
+        updateStmt.Step();
+        updateStmt.Reset();
+    }
 
-    std::string inner = u8fmt("UPDATE %s SET sort_order=? WHERE id=?", plural.c_str());
-    db::Statement innerStmt(inner.c_str(), connection);
+    musik::debug::info(TAG, u8fmt("rebalanced sort order for %d %s", (int) ids.size(), table.c_str()));
+}
+
+/* places rows that were added since the last sync between their already
+sorted neighbors. if a gap is too small to fit everything that belongs in
+it, the whole table is renumbered instead. returns the number of rows that
+were updated. */
+static int updateSortOrder(
+    musik::core::db::Connection &connection,
+    const std::string& table,
+    const std::string& column)
+{
+    struct Unplaced { std::string key; int64_t id; };
+    struct Placed { std::string key; int64_t order; };
+
+    std::vector<Unplaced> unplaced;
+    {
+        std::string query = u8fmt(
+            "SELECT id, lower(trim(%s)) AS sort_key FROM %s WHERE sort_order=0 ORDER BY sort_key",
+            column.c_str(), table.c_str());
+
+        db::Statement stmt(query.c_str(), connection);
+        while (stmt.Step() == db::Row) {
+            unplaced.push_back({ stmt.ColumnText(1), stmt.ColumnInt64(0) });
+        }
+    }
 
-    int count = 0;
-    while (outerStmt.Step() == db::Row) {
-        innerStmt.BindInt32(0, count);
-        innerStmt.BindInt64(1, outerStmt.ColumnInt64(0));
-        innerStmt.Step();
-        innerStmt.Reset();
-        ++count;
+    if (unplaced.empty()) {
+        return 0; /* the common case: nothing new */
+    }
+
+    /* everything else is already sorted by sort_order, which means it's
+    also sorted by key. the key is only needed to find the right gap. */
+    std::vector<Placed> placed;
+    {
+        std::string query = u8fmt(
+            "SELECT sort_order, lower(trim(%s)) FROM %s WHERE sort_order>0 ORDER BY sort_order",
+            column.c_str(), table.c_str());
+
+        db::Statement stmt(query.c_str(), connection);
+        while (stmt.Step() == db::Row) {
+            placed.push_back({ stmt.ColumnText(1), stmt.ColumnInt64(0) });
+        }
+    }
+
+    auto compare = [](const std::string& key, const Placed& row) { return key < row.key; };
+
+    std::vector<std::pair<int64_t, int64_t>> updates; /* (id, sort_order) */
+    size_t i = 0;
+    while (i < unplaced.size()) {
+        /* all the new rows that belong in the same gap */
+        const auto gap = std::upper_bound(placed.begin(), placed.end(), unplaced[i].key, compare);
+        size_t end = i + 1;
+        while (end < unplaced.size() &&
+            std::upper_bound(gap, placed.end(), unplaced[end].key, compare) == gap)
+        {
+            ++end;
+        }
+
+        const int64_t count = (int64_t) (end - i);
+        const int64_t lo = (gap == placed.begin()) ? 0 : (gap - 1)->order;
+        const int64_t hi = (gap == placed.end()) ? lo + (count + 1) * kSortOrderGap : gap->order;
+
+        if (hi - lo - 1 < count) {
+            rebalanceSortOrder(connection, table, column);
+            return (int) (placed.size() + unplaced.size());
+        }
+
+        const int64_t step = (hi - lo) / (count + 1);
+        for (int64_t j = 0; j < count; j++) {
+            updates.push_back({ unplaced[i + j].id, lo + step * (j + 1) });
+        }
+
+        i = end;
+    }
+
+    std::string update = u8fmt("UPDATE %s SET sort_order=? WHERE id=?", table.c_str());
+    db::Statement updateStmt(update.c_str(), connection);
+
+    for (auto& u : updates) {
+        updateStmt.BindInt64(0, u.second);
+        updateStmt.BindInt64(1, u.first);
+        updateStmt.Step();
+        updateStmt.Reset();
     }
 
     std::this_thread::yield();
 
-    return count;
+    return (int) updates.size();
 }
 
-void Indexer::SyncOptimize() {
+void Indexer::SyncOptimize(bool full) {
     db::ScopedTransaction transaction(this->dbConnection);
-    optimize(this->dbConnection, "genre", "genres");
-    optimize(this->dbConnection, "artist", "artists");
-    optimize(this->dbConnection, "album", "albums");
-    optimize(this->dbConnection, "content", "meta_values");
+
+    const std::pair<const char*, const char*> tables[] = {
+        { "genres", "name" },
+        { "artists", "name" },
+        { "albums", "name" },
+        { "meta_values", "content" },
+    };
+
+    for (auto& t : tables) {
+        if (full) {
+            rebalanceSortOrder(this->dbConnection, t.first, t.second);
+        }
+        else {
+            updateSortOrder(this->dbConnection, t.first, t.second);
+        }
+    }
 }
 
 void Indexer::ProcessAddRemoveQueue() {
@@ -903,6 +1480,10 @@ void Indexer::RunAnalyzers() {
         return;
     }
 
+    /* streams opened below will read with background priority */
+    IoScheduler::Scope ioScope(IoScheduler::Class::Analyzer);
+    auto& ioScheduler = IoScheduler::Instance();
+
     /* for each track... */
 
     int64_t trackId = 0;
@@ -943,6 +1524,7 @@ void Indexer::RunAnalyzers() {
                         IBuffer* buffer;
 
                         while ((buffer = stream->GetNextProcessedOutputBuffer()) && !runningAnalyzers.empty()) {
+                            ioScheduler.WaitIfThrottled();
                             PluginVector::iterator plugin = runningAnalyzers.begin();
                             while(plugin != runningAnalyzers.end()) {
                                 if ((*plugin)->Analyze(&store, buffer)) {
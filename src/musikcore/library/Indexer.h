@@ -38,6 +38,7 @@
 #include <musikcore/sdk/ITagReader.h>
 #include <musikcore/sdk/IDecoderFactory.h>
 #include <musikcore/sdk/IIndexerWriter.h>
+#include <musikcore/sdk/IIndexerFileSource.h>
 #include <musikcore/sdk/IIndexerNotifier.h>
 #include <musikcore/library/IIndexer.h>
 #include <musikcore/support/Preferences.h>
@@ -127,16 +128,25 @@ namespace musik { namespace core {
             void FinalizeSync(const SyncContext& context);
 
             void SyncDelete();
-            void SyncCleanup();
+            void SyncCleanup(bool full);
+            void SyncVacuum();
 
-            void SyncPlaylistTracksOrder();
+            void SyncPlaylistTracksOrder(bool full);
 
             musik::core::sdk::ScanResult SyncSource(
                 musik::core::sdk::IIndexerSource* source,
                 const std::vector<std::string>& paths);
 
+            bool BeginFileSource(
+                musik::core::sdk::IIndexerFileSource* source,
+                const std::vector<std::string>& paths);
+
+            void FinishFileSources();
+
+            void ScanSourceTracks(musik::core::sdk::IIndexerSource* source);
+
             void ProcessAddRemoveQueue();
-            void SyncOptimize();
+            void SyncOptimize(bool full);
             void RunAnalyzers();
             std::set<int> GetOrphanedSourceIds();
             int RemoveAllForSourceId(int sourceId);
@@ -155,6 +165,11 @@ namespace musik { namespace core {
                 const std::filesystem::path& path,
                 const std::string& pathId);
 
+            void IndexFileForSource(
+                asio::io_service* io,
+                musik::core::sdk::IIndexerFileSource* source,
+                const std::filesystem::path& path);
+
             bool Bail() noexcept;
 
             db::Connection dbConnection;
@@ -174,6 +189,8 @@ namespace musik { namespace core {
             std::shared_ptr<musik::core::db::ScopedTransaction> trackTransaction;
             std::vector<std::string> paths;
             std::shared_ptr<musik::core::sdk::IIndexerSource> currentSource;
+            std::vector<musik::core::sdk::IIndexerFileSource*> fileSources; /* fed by the shared walk */
+            bool scanLocalFiles { true };
     };
 
     typedef std::shared_ptr<Indexer> IndexerPtr;
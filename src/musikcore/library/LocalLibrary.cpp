@@ -37,6 +37,7 @@
 #include <musikcore/library/LocalLibrary.h>
 #include <musikcore/config.h>
 #include <musikcore/library/QueryBase.h>
+#include <musikcore/library/query/TrackListQueryBase.h>
 #include <musikcore/support/Common.h>
 #include <musikcore/support/Preferences.h>
 #include <musikcore/library/Indexer.h>
@@ -53,13 +54,22 @@ namespace fs = std::filesystem;
 
 using namespace musik::core;
 using namespace musik::core::library;
+using namespace musik::core::library::query;
 using namespace musik::core::runtime;
 using namespace std::chrono;
 
-#define DATABASE_VERSION 10
+#define DATABASE_VERSION 11
 #define VERBOSE_LOGGING 1
 #define MESSAGE_QUERY_COMPLETED 5000
 
+/* lower priority queries wait while there is more important work to do,
+but never longer than this. */
+static const auto kMaxQueryStarvation = std::chrono::milliseconds(2000);
+
+static size_t laneFor(const std::shared_ptr<QueryBase>& query) noexcept {
+    return (size_t) query->GetPriority();
+}
+
 class LocalResourceLocator: public ILibrary::IResourceLocator {
     public:
         std::string GetTrackUri(
@@ -98,7 +108,8 @@ LocalLibrary::LocalLibrary(std::string name, int id, MessageQueue* messageQueue)
 : name(name)
 , id(id)
 , exit(false)
-, messageQueue(messageQueue) {
+, messageQueue(messageQueue)
+, interrupting(false) {
     if (this->messageQueue) {
         this->messageQueue->Register(this);
     }
@@ -146,7 +157,13 @@ void LocalLibrary::Close() {
         if (this->thread) {
             thread = this->thread;
             this->thread = nullptr;
-            this->queryQueue.clear();
+            for (auto& lane : this->queryQueue) {
+                lane.clear();
+            }
+            if (this->runningQuery) {
+                this->runningQuery->query->Cancel();
+                this->db.Interrupt();
+            }
             this->exit = true;
         }
     }
@@ -206,12 +223,21 @@ int LocalLibrary::EnqueueAndWait(QueryPtr query, size_t timeoutMs, Callback call
         auto context = std::make_shared<QueryContext>();
         context->query = localQuery;
         context->callback = callback;
+        context->enqueued = steady_clock::now();
 
         if (timeoutMs == kWaitIndefinite) {
+            /* sqlite interrupts every statement that starts before the ones
+            already running have finished, so if we just interrupted the query
+            thread, wait for it to unwind before we start ours. */
+            while (this->interrupting && !this->exit) {
+                this->queueCondition.wait(lock);
+            }
             this->RunQuery(context);
         }
         else {
-            queryQueue.push_back(context);
+            if (!this->Coalesce(context)) {
+                queryQueue[laneFor(localQuery)].push_back(context);
+            }
             queueCondition.notify_all();
 
             if (timeoutMs > 0) {
@@ -234,20 +260,148 @@ int LocalLibrary::EnqueueAndWait(QueryPtr query, size_t timeoutMs, Callback call
     return -1;
 }
 
+bool LocalLibrary::Cancel(int queryId) {
+    std::unique_lock<std::recursive_mutex> lock(this->mutex);
+
+    if (this->runningQuery && this->runningQuery->query->GetId() == queryId) {
+        /* synchronous queries hold the lock while they run, so the query
+        thread is the only one stepping statements right now. synchronous
+        queries started before it unwinds wait for us; see EnqueueAndWait(). */
+        this->runningQuery->query->Cancel();
+        this->interrupting = true;
+        this->db.Interrupt();
+        return true;
+    }
+
+    /* queued queries are moved to the front of the line; QueryBase::Run()
+    will see they were canceled and complete them immediately, so callers
+    still get their callback. */
+    auto& front = this->queryQueue[(size_t) LocalQuery::Priority::Interactive];
+
+    auto cancelCoalesced = [this, &front, queryId](QueryContextPtr context) {
+        auto& coalesced = context->coalesced;
+        for (auto it = coalesced.begin(); it != coalesced.end(); ++it) {
+            if ((*it)->query->GetId() == queryId) {
+                auto canceled = *it;
+                coalesced.erase(it);
+                canceled->query->Cancel();
+                front.push_front(canceled);
+                this->queueCondition.notify_all();
+                return true;
+            }
+        }
+        return false;
+    };
+
+    if (this->runningQuery && cancelCoalesced(this->runningQuery)) {
+        return true;
+    }
+
+    for (auto& lane : this->queryQueue) {
+        for (auto it = lane.begin(); it != lane.end(); ++it) {
+            auto context = *it;
+
+            if (context->query->GetId() == queryId) {
+                auto position = lane.erase(it);
+                if (!context->coalesced.empty()) {
+                    /* the first duplicate takes its place in line */
+                    auto next = context->coalesced.front();
+                    next->coalesced.assign(context->coalesced.begin() + 1, context->coalesced.end());
+                    context->coalesced.clear();
+                    lane.insert(position, next);
+                }
+                context->query->Cancel();
+                front.push_front(context);
+                this->queueCondition.notify_all();
+                return true;
+            }
+
+            if (cancelCoalesced(context)) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool LocalLibrary::Coalesce(QueryContextPtr context) {
+    auto trackListQuery = std::dynamic_pointer_cast<TrackListQueryBase>(context->query);
+    if (!trackListQuery) {
+        return false;
+    }
+
+    for (size_t i = 0; i < kQueryLaneCount; i++) {
+        auto& lane = this->queryQueue[i];
+        for (auto it = lane.begin(); it != lane.end(); ++it) {
+            auto queued = *it;
+            auto other = std::dynamic_pointer_cast<TrackListQueryBase>(queued->query);
+            if (other && !other->IsCanceled() && trackListQuery->IsEquivalentTo(*other)) {
+                queued->coalesced.push_back(context);
+
+                /* the duplicate may be more urgent than the original */
+                const size_t target = laneFor(context->query);
+                if (target < i) {
+                    lane.erase(it);
+                    this->queryQueue[target].push_back(queued);
+                }
+
+                if (VERBOSE_LOGGING) {
+                    musik::debug::info(TAG, u8fmt(
+                        "query '%s' (%d) coalesced with %d",
+                        context->query->Name().c_str(),
+                        context->query->GetId(),
+                        queued->query->GetId()));
+                }
+
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
 LocalLibrary::QueryContextPtr LocalLibrary::GetNextQuery() {
     std::unique_lock<std::recursive_mutex> lock(this->mutex);
-    while (!this->queryQueue.size() && !this->exit) {
+
+    auto empty = [this]() {
+        for (auto& lane : this->queryQueue) {
+            if (!lane.empty()) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    while (empty() && !this->exit) {
         this->queueCondition.wait(lock);
     }
 
     if (this->exit) {
         return QueryContextPtr();
     }
-    else {
-        auto front = queryQueue.front();
-        queryQueue.pop_front();
-        return front;
+
+    /* highest priority first, unless something further back has been
+    waiting for too long. */
+    const auto now = steady_clock::now();
+    size_t next = kQueryLaneCount;
+    for (size_t i = 1; i < kQueryLaneCount && next == kQueryLaneCount; i++) {
+        auto& lane = this->queryQueue[i];
+        if (!lane.empty() && now - lane.front()->enqueued > kMaxQueryStarvation) {
+            next = i;
+        }
+    }
+    for (size_t i = 0; i < kQueryLaneCount && next == kQueryLaneCount; i++) {
+        if (!this->queryQueue[i].empty()) {
+            next = i;
+        }
     }
+
+    auto front = this->queryQueue[next].front();
+    this->queryQueue[next].pop_front();
+    this->runningQuery = front;
+    return front;
 }
 
 void LocalLibrary::ThreadProc() {
@@ -255,6 +409,11 @@ void LocalLibrary::ThreadProc() {
         auto query = GetNextQuery();
         if (query) {
             this->RunQuery(query);
+            {
+                std::unique_lock<std::recursive_mutex> lock(this->mutex);
+                this->runningQuery.reset();
+            }
+            this->CompleteCoalesced(query);
             this->queueCondition.notify_all();
         }
     }
@@ -270,14 +429,17 @@ void LocalLibrary::RunQuery(QueryContextPtr context, bool notify) {
 
         query->Run(this->db);
 
-        if (notify) {
-            if (this->messageQueue) {
-                this->messageQueue->Post(std::make_shared<QueryCompletedMessage>(this, context));
-            }
-            else {
-                this->QueryCompleted(query.get());
+        {
+            std::unique_lock<std::recursive_mutex> lock(this->mutex);
+            if (this->interrupting && context == this->runningQuery) {
+                this->interrupting = false;
+                this->queueCondition.notify_all();
             }
         }
+
+        if (notify) {
+            this->NotifyQueryCompleted(context);
+        }
         else if (context->callback) {
             context->callback(context->query);
         }
@@ -291,6 +453,49 @@ void LocalLibrary::RunQuery(QueryContextPtr context, bool notify) {
     }
 }
 
+void LocalLibrary::NotifyQueryCompleted(QueryContextPtr context) {
+    if (this->messageQueue) {
+        this->messageQueue->Post(std::make_shared<QueryCompletedMessage>(this, context));
+    }
+    else {
+        this->QueryCompleted(context->query.get());
+    }
+}
+
+void LocalLibrary::CompleteCoalesced(QueryContextPtr context) {
+    std::vector<QueryContextPtr> coalesced;
+
+    {
+        std::unique_lock<std::recursive_mutex> lock(this->mutex);
+
+        if (context->coalesced.empty()) {
+            return;
+        }
+
+        if (context->query->GetStatus() == db::IQuery::Canceled) {
+            /* the duplicates still want their results. the first one runs
+            in place of the original, and the others wait on it. */
+            auto next = context->coalesced.front();
+            next->coalesced.assign(context->coalesced.begin() + 1, context->coalesced.end());
+            context->coalesced.clear();
+            this->queryQueue[laneFor(next->query)].push_front(next);
+            this->queueCondition.notify_all();
+            return;
+        }
+
+        coalesced.swap(context->coalesced);
+    }
+
+    auto original = std::dynamic_pointer_cast<TrackListQueryBase>(context->query);
+    for (auto& duplicate : coalesced) {
+        auto query = std::dynamic_pointer_cast<TrackListQueryBase>(duplicate->query);
+        if (original && query) {
+            query->AdoptResult(*original);
+            this->NotifyQueryCompleted(duplicate);
+        }
+    }
+}
+
 void LocalLibrary::SetMessageQueue(musik::core::runtime::IMessageQueue& queue) {
     if (this->messageQueue && this->messageQueue != &queue) {
         this->messageQueue->Unregister(this);
@@ -413,6 +618,10 @@ static void upgradeV9ToV10(db::Connection& db) {
     db.Execute("UPDATE tracks set disc=1 where disc is null or disc like \"\"");
 }
 
+static void upgradeV10ToV11(db::Connection& db) {
+    db.Execute("ALTER TABLE directories ADD COLUMN mtime INTEGER DEFAULT 0");
+}
+
 static void setVersion(db::Connection& db, int version) {
     db.Execute("DELETE FROM version");
     db::Statement stmt("INSERT INTO version VALUES(?)", db);
@@ -514,7 +723,8 @@ void LocalLibrary::CreateDatabase(db::Connection &db){
     db.Execute(
         "CREATE TABLE IF NOT EXISTS directories ("
         "id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "name TEXT NOT NULL)");
+        "name TEXT NOT NULL,"
+        "mtime INTEGER DEFAULT 0)");
 
     /* thumbnails */
     db.Execute(
@@ -625,6 +835,14 @@ void LocalLibrary::CreateDatabase(db::Connection &db){
             "id INTEGER PRIMARY KEY AUTOINCREMENT, "
             "track_id INTEGER)");
 
+    /* edits applied on top of last_session_play_queue, in order */
+    db.Execute(
+        "CREATE TABLE IF NOT EXISTS last_session_play_queue_edits ( "
+            "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+            "type INTEGER NOT NULL, "
+            "a INTEGER NOT NULL DEFAULT 0, "
+            "b INTEGER NOT NULL DEFAULT 0)");
+
     /* upgrade playlist tracks table */
     if (lastVersion == 1) {
         upgradeV1toV2(db);
@@ -662,6 +880,10 @@ void LocalLibrary::CreateDatabase(db::Connection &db){
         upgradeV9ToV10(db);
     }
 
+    if (lastVersion >= 1 && lastVersion < 11) {
+        upgradeV10ToV11(db);
+    }
+
     /* ensure our version is set correctly */
     setVersion(db, DATABASE_VERSION);
 
@@ -684,12 +906,19 @@ void LocalLibrary::DropIndexes(db::Connection &db) {
     db.Execute("DROP INDEX IF EXISTS trackmeta_index2");
     db.Execute("DROP INDEX IF EXISTS metakey_index1");
     db.Execute("DROP INDEX IF EXISTS metavalues_index1");
+    db.Execute("DROP INDEX IF EXISTS metavalues_index5");
 
     db.Execute("DROP INDEX IF EXISTS tracks_external_id_index");
     db.Execute("DROP INDEX IF EXISTS tracks_filename_id_index");
     db.Execute("DROP INDEX IF EXISTS tracks_dirty_index");
     db.Execute("DROP INDEX IF EXISTS tracks_external_id_filetime_index");
     db.Execute("DROP INDEX IF EXISTS tracks_by_source_index");
+    db.Execute("DROP INDEX IF EXISTS tracks_album_id_index");
+    db.Execute("DROP INDEX IF EXISTS tracks_visual_artist_id_index");
+    db.Execute("DROP INDEX IF EXISTS tracks_album_artist_id_index");
+    db.Execute("DROP INDEX IF EXISTS tracks_visual_genre_id_index");
+    db.Execute("DROP INDEX IF EXISTS tracks_directory_id_index");
+    db.Execute("DROP INDEX IF EXISTS replay_gain_track_id_index");
 
     db.Execute("DROP INDEX IF EXISTS playlist_tracks_index_1");
     db.Execute("DROP INDEX IF EXISTS playlist_tracks_index_2");
@@ -716,6 +945,7 @@ void LocalLibrary::CreateIndexes(db::Connection &db) {
     db.Execute("CREATE INDEX IF NOT EXISTS metavalues_index2 ON meta_values (content)");
     db.Execute("CREATE INDEX IF NOT EXISTS metavalues_index3 ON meta_values (id, meta_key_id, content)");
     db.Execute("CREATE INDEX IF NOT EXISTS metavalues_index4 ON meta_values (id, content)");
+    db.Execute("CREATE INDEX IF NOT EXISTS metavalues_index5 ON meta_values (sort_order)");
 
     db.Execute("CREATE INDEX IF NOT EXISTS tracks_external_id_index ON tracks (external_id)");
     db.Execute("CREATE INDEX IF NOT EXISTS tracks_filename_index ON tracks (filename)");
@@ -723,6 +953,14 @@ void LocalLibrary::CreateIndexes(db::Connection &db) {
     db.Execute("CREATE INDEX IF NOT EXISTS tracks_external_id_filetime_index ON tracks (external_id, filetime)");
     db.Execute("CREATE INDEX IF NOT EXISTS tracks_by_source_index ON tracks (id, external_id, filename, source_id)");
 
+    /* used by the indexer to check whether a category row is still referenced */
+    db.Execute("CREATE INDEX IF NOT EXISTS tracks_album_id_index ON tracks (album_id)");
+    db.Execute("CREATE INDEX IF NOT EXISTS tracks_visual_artist_id_index ON tracks (visual_artist_id)");
+    db.Execute("CREATE INDEX IF NOT EXISTS tracks_album_artist_id_index ON tracks (album_artist_id)");
+    db.Execute("CREATE INDEX IF NOT EXISTS tracks_visual_genre_id_index ON tracks (visual_genre_id)");
+    db.Execute("CREATE INDEX IF NOT EXISTS tracks_directory_id_index ON tracks (directory_id)");
+    db.Execute("CREATE INDEX IF NOT EXISTS replay_gain_track_id_index ON replay_gain (track_id)");
+
     db.Execute("CREATE INDEX IF NOT EXISTS playlist_tracks_index_1 ON playlist_tracks (track_external_id,playlist_id,sort_order)");
     db.Execute("CREATE INDEX IF NOT EXISTS playlist_tracks_index_2 ON playlist_tracks (track_external_id,sort_order)");
     db.Execute("CREATE INDEX IF NOT EXISTS playlist_tracks_index_3 ON playlist_tracks (track_external_id)");
@@ -42,10 +42,13 @@
 #include <musikcore/library/IQuery.h>
 #include <musikcore/library/QueryBase.h>
 
+#include <array>
+#include <chrono>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <string>
+#include <vector>
 
 #include <sigslot/sigslot.h>
 
@@ -70,6 +73,7 @@ namespace musik { namespace core { namespace library {
             /* ILibrary */
             int Enqueue(QueryPtr query, Callback cb = Callback()) override;
             int EnqueueAndWait(QueryPtr query, size_t timeoutMs = kWaitIndefinite, Callback cb = Callback()) override;
+            bool Cancel(int queryId) override;
             IIndexer *Indexer() override;
             int Id() override;
             const std::string& Name() override;
@@ -101,18 +105,27 @@ namespace musik { namespace core { namespace library {
             struct QueryContext {
                 LocalQueryPtr query;
                 Callback callback;
+                std::chrono::steady_clock::time_point enqueued;
+                std::vector<std::shared_ptr<QueryContext>> coalesced;
             };
 
             using QueryContextPtr = std::shared_ptr<QueryContext>;
             using QueryList = std::list<QueryContextPtr>;
 
+            /* one lane per LocalQuery::Priority */
+            static const size_t kQueryLaneCount = 3;
+
             LocalLibrary(std::string name, int id, MessageQueue* messageQueue); /* ctor */
 
             void RunQuery(QueryContextPtr context, bool notify = true);
+            void NotifyQueryCompleted(QueryContextPtr context);
+            void CompleteCoalesced(QueryContextPtr context);
+            bool Coalesce(QueryContextPtr context);
             void ThreadProc();
             QueryContextPtr GetNextQuery();
 
-            QueryList queryQueue;
+            std::array<QueryList, kQueryLaneCount> queryQueue;
+            QueryContextPtr runningQuery;
 
             musik::core::runtime::IMessageQueue* messageQueue;
 
@@ -124,6 +137,7 @@ namespace musik { namespace core { namespace library {
             std::condition_variable_any queueCondition;
             std::recursive_mutex mutex;
             std::atomic<bool> exit;
+            bool interrupting;
 
             core::IIndexer *indexer;
             core::db::Connection db;
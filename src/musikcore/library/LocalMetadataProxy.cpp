@@ -47,6 +47,7 @@
 #include <musikcore/library/query/GetPlaylistQuery.h>
 #include <musikcore/library/query/SavePlaylistQuery.h>
 #include <musikcore/library/query/TrackMetadataQuery.h>
+#include <musikcore/library/query/TrackMetadataBatchQuery.h>
 #include <musikcore/library/query/TrackListQueryBase.h>
 #include <musikcore/library/QueryRegistry.h>
 #include <musikcore/library/LibraryFactory.h>
@@ -57,6 +58,8 @@
 #include <musikcore/support/Common.h>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 
 #pragma warning(push, 0)
 #include <nlohmann/json.hpp>
@@ -120,6 +123,10 @@ class ExternalIdListToTrackListQuery : public TrackListQueryBase {
             return this->result;
         }
 
+        const std::map<std::string, int64_t>& GetExternalIdMap() noexcept {
+            return this->externalIdMap;
+        }
+
         Headers GetHeaders() noexcept override {
             return Headers();
         }
@@ -152,7 +159,7 @@ class ExternalIdListToTrackListQuery : public TrackListQueryBase {
             query per ID (we do this because WHERE IN() does not preserve input
             ordering... */
             struct Record { int64_t id; std::string externalId; };
-            std::map<std::string, int64_t> records;
+            std::map<std::string, int64_t>& records = this->externalIdMap;
 
             while (query.Step() == Row) {
                 records[query.ColumnText(1)] = query.ColumnInt64(0);
@@ -179,6 +186,7 @@ class ExternalIdListToTrackListQuery : public TrackListQueryBase {
         ILibraryPtr library;
         const char** externalIds;
         size_t externalIdCount;
+        std::map<std::string, int64_t> externalIdMap;
         std::shared_ptr<TrackList> result;
 };
 
@@ -291,7 +299,8 @@ class RemoveFromPlaylistQuery : public QueryBase {
 /* DATA PROVIDER */
 
 LocalMetadataProxy::LocalMetadataProxy(musik::core::ILibraryPtr library)
-: library(library) {
+: library(library)
+, trackCache(library) {
 
 }
 
@@ -325,38 +334,120 @@ ITrackList* LocalMetadataProxy::QueryTracks(const char* query, int limit, int of
 }
 
 ITrack* LocalMetadataProxy::QueryTrackById(int64_t trackId) {
-    try {
-        const auto target = std::make_shared<LibraryTrack>(trackId, this->library);
-        const auto search = std::make_shared<TrackMetadataQuery>(target, this->library);
-        this->library->EnqueueAndWait(search);
-        if (search->GetStatus() == IQuery::Finished) {
-            return search->Result()->GetSdkValue();
+    ITrack* result = nullptr;
+    this->QueryTracksByIds(&trackId, 1, &result);
+    return result;
+}
+
+ITrack* LocalMetadataProxy::QueryTrackByExternalId(const char* externalId) {
+    ITrack* result = nullptr;
+    if (externalId && strlen(externalId)) {
+        this->QueryTracksByExternalIds(&externalId, 1, &result);
+    }
+    return result;
+}
+
+size_t LocalMetadataProxy::QueryTracksByIds(
+    const int64_t* trackIds, size_t trackIdCount, ITrack** result)
+{
+    if (!trackIds || !result) {
+        return 0;
+    }
+
+    std::vector<TrackPtr> tracks(trackIdCount);
+    std::unordered_set<int64_t> missing;
+
+    for (size_t i = 0; i < trackIdCount; i++) {
+        if (trackIds[i] > 0) {
+            tracks[i] = this->trackCache.GetById(trackIds[i]);
+            if (!tracks[i]) {
+                missing.insert(trackIds[i]);
+            }
         }
     }
-    catch (...) {
-        musik::debug::error(TAG, "QueryTrackById failed");
+
+    /* everything we don't have cached is fetched with a single query */
+    if (missing.size()) {
+        try {
+            const uint64_t generation = this->trackCache.Generation();
+            auto query = std::make_shared<TrackMetadataBatchQuery>(missing, this->library);
+            this->library->EnqueueAndWait(query);
+            if (query->GetStatus() == IQuery::Finished) {
+                auto& loaded = query->Result();
+                for (auto& kv : loaded) {
+                    this->trackCache.Put(kv.second, generation);
+                }
+                for (size_t i = 0; i < trackIdCount; i++) {
+                    if (!tracks[i]) {
+                        auto it = loaded.find(trackIds[i]);
+                        if (it != loaded.end()) {
+                            tracks[i] = it->second;
+                        }
+                    }
+                }
+            }
+        }
+        catch (...) {
+            musik::debug::error(TAG, "QueryTracksByIds failed");
+        }
     }
 
-    return nullptr;
+    size_t found = 0;
+    for (size_t i = 0; i < trackIdCount; i++) {
+        result[i] = tracks[i] ? tracks[i]->GetSdkValue() : nullptr;
+        found += tracks[i] ? 1 : 0;
+    }
+
+    return found;
 }
 
-ITrack* LocalMetadataProxy::QueryTrackByExternalId(const char* externalId) {
-    if (strlen(externalId)) {
+size_t LocalMetadataProxy::QueryTracksByExternalIds(
+    const char** externalIds, size_t externalIdCount, ITrack** result)
+{
+    if (!externalIds || !result) {
+        return 0;
+    }
+
+    /* resolve external ids we haven't seen recently to track ids, then load
+    everything by id. that's at most two round trips, regardless of count. */
+    std::vector<int64_t> ids(externalIdCount, 0);
+    std::vector<const char*> unresolved;
+
+    for (size_t i = 0; i < externalIdCount; i++) {
+        auto track = this->trackCache.GetByExternalId(externalIds[i] ? externalIds[i] : "");
+        if (track) {
+            ids[i] = track->GetId();
+        }
+        else if (externalIds[i] && strlen(externalIds[i])) {
+            unresolved.push_back(externalIds[i]);
+        }
+    }
+
+    if (unresolved.size()) {
         try {
-            auto target = std::make_shared<LibraryTrack>(0, this->library);
-            target->SetValue("external_id", externalId);
-            auto search = std::make_shared<TrackMetadataQuery>(target, this->library);
-            this->library->EnqueueAndWait(search);
-            if (search->GetStatus() == IQuery::Finished) {
-                return search->Result()->GetSdkValue();
+            auto query = std::make_shared<ExternalIdListToTrackListQuery>(
+                this->library, unresolved.data(), unresolved.size());
+
+            this->library->EnqueueAndWait(query);
+
+            if (query->GetStatus() == IQuery::Finished) {
+                auto& resolved = query->GetExternalIdMap();
+                for (size_t i = 0; i < externalIdCount; i++) {
+                    if (!ids[i] && externalIds[i]) {
+                        auto it = resolved.find(externalIds[i]);
+                        if (it != resolved.end()) {
+                            ids[i] = it->second;
+                        }
+                    }
+                }
             }
         }
         catch (...) {
-            musik::debug::error(TAG, "QueryTrackByExternalId failed");
+            musik::debug::error(TAG, "QueryTracksByExternalIds failed");
         }
     }
 
-    return nullptr;
+    return this->QueryTracksByIds(ids.data(), externalIdCount, result);
 }
 
 ITrackList* LocalMetadataProxy::QueryTracksByCategory(
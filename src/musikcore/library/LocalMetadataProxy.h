@@ -35,6 +35,7 @@
 #pragma once
 
 #include <musikcore/library/ILibrary.h>
+#include <musikcore/library/track/TrackCache.h>
 #include <musikcore/sdk/IMetadataProxy.h>
 
 namespace musik { namespace core { namespace library { namespace query {
@@ -74,6 +75,16 @@ namespace musik { namespace core { namespace library { namespace query {
             musik::core::sdk::ITrackList* QueryTracksByExternalId(
                 const char** externalIds, size_t externalIdCount) override;
 
+            size_t QueryTracksByIds(
+                const int64_t* trackIds,
+                size_t trackIdCount,
+                musik::core::sdk::ITrack** result) override;
+
+            size_t QueryTracksByExternalIds(
+                const char** externalIds,
+                size_t externalIdCount,
+                musik::core::sdk::ITrack** result) override;
+
             musik::core::sdk::IValueList* ListCategories() override;
 
             musik::core::sdk::IValueList*
@@ -159,6 +170,7 @@ namespace musik { namespace core { namespace library { namespace query {
 
         private:
             musik::core::ILibraryPtr library;
+            musik::core::TrackCache trackCache;
     };
 
 } } } }
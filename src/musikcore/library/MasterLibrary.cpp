@@ -58,6 +58,10 @@ int MasterLibrary::EnqueueAndWait(QueryPtr query, size_t timeoutMs, Callback cb)
     return this->wrappedLibrary->EnqueueAndWait(query, timeoutMs, cb);
 }
 
+bool MasterLibrary::Cancel(int queryId) {
+    return this->wrappedLibrary->Cancel(queryId);
+}
+
 IIndexer* MasterLibrary::Indexer() {
     return this->wrappedLibrary->Indexer();
 }
@@ -57,6 +57,7 @@ namespace musik { namespace core { namespace library {
 
             int Enqueue(QueryPtr query, Callback cb = Callback()) override;
             int EnqueueAndWait(QueryPtr query, size_t timeoutMs = kWaitIndefinite, Callback cb = Callback()) override;
+            bool Cancel(int queryId) override;
             musik::core::IIndexer *Indexer() override;
             int Id() override;
             const std::string& Name() override;
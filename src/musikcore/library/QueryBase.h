@@ -55,11 +55,22 @@ namespace musik { namespace core { namespace library { namespace query {
                 Regex = 2
             };
 
+            /* LocalLibrary runs queued queries in this order. Interactive
+            queries are ones the user is actively waiting on; Background is
+            for housekeeping (lyrics, play counts); Bulk is for large writes
+            that can wait until everything else is done. */
+            enum class Priority : int {
+                Interactive = 0,
+                Background = 1,
+                Bulk = 2
+            };
+
             QueryBase() noexcept
             : status(IQuery::Idle)
             , options(0)
             , queryId(nextId())
-            , cancel(false) {
+            , cancel(false)
+            , priority(Priority::Interactive) {
             }
 
             bool Run(musik::core::db::Connection &db) {
@@ -70,14 +81,16 @@ namespace musik { namespace core { namespace library { namespace query {
                         return true;
                     }
                     else if (OnRun(db)) {
-                        this->SetStatus(Finished);
+                        /* a query canceled mid-flight may have been interrupted,
+                        in which case whatever it produced is incomplete. */
+                        this->SetStatus(this->IsCanceled() ? Canceled : Finished);
                         return true;
                     }
                 }
                 catch (...) {
                 }
 
-                this->SetStatus(Failed);
+                this->SetStatus(this->IsCanceled() ? Canceled : Failed);
                 return false;
             }
 
@@ -89,6 +102,14 @@ namespace musik { namespace core { namespace library { namespace query {
                 return cancel;
             }
 
+            Priority GetPriority() const noexcept {
+                return this->priority;
+            }
+
+            void SetPriority(Priority priority) noexcept {
+                this->priority = priority;
+            }
+
             /* IQuery */
 
             int GetStatus() override {
@@ -120,7 +141,7 @@ namespace musik { namespace core { namespace library { namespace query {
             }
 
             void Invalidate() override {
-                this->SetStatus(IQuery::Failed);
+                this->SetStatus(this->IsCanceled() ? Canceled : Failed);
             }
 
         protected:
@@ -146,6 +167,7 @@ namespace musik { namespace core { namespace library { namespace query {
             unsigned int queryId;
             unsigned int options;
             volatile bool cancel;
+            std::atomic<Priority> priority;
             std::mutex stateMutex;
     };
 
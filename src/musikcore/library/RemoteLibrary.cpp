@@ -43,6 +43,7 @@
 #include <musikcore/library/IQuery.h>
 #include <musikcore/library/LibraryFactory.h>
 #include <musikcore/library/QueryRegistry.h>
+#include <musikcore/library/QueryBase.h>
 #include <musikcore/runtime/Message.h>
 #include <musikcore/support/NarrowCast.h>
 #include <musikcore/debug.h>
@@ -227,6 +228,39 @@ int RemoteLibrary::EnqueueAndWait(QueryPtr query, size_t timeoutMs, Callback cal
     return -1;
 }
 
+bool RemoteLibrary::Cancel(int queryId) {
+    QueryContextPtr canceled;
+
+    {
+        std::unique_lock<std::recursive_mutex> lock(this->queueMutex);
+        for (auto it = this->queryQueue.begin(); it != this->queryQueue.end(); ++it) {
+            if ((*it)->query->GetId() == queryId) {
+                /* not sent yet, so it never will be. complete it as canceled
+                so the caller still gets its callback. */
+                canceled = *it;
+                auto query = std::dynamic_pointer_cast<musik::core::library::query::QueryBase>(canceled->query);
+                if (query) {
+                    query->Cancel();
+                }
+                canceled->query->Invalidate();
+                this->queryQueue.erase(it);
+                break;
+            }
+        }
+    }
+
+    if (canceled) {
+        this->OnQueryCompleted(canceled);
+        this->syncQueryCondition.notify_all();
+        return true;
+    }
+
+    /* queries already sent to the server can't be recalled. local-only
+    queries were handed off to the local library, so let it have a look. */
+    auto defaultLocalLibrary = LibraryFactory::Instance().DefaultLocalLibrary();
+    return defaultLocalLibrary ? defaultLocalLibrary->Cancel(queryId) : false;
+}
+
 RemoteLibrary::QueryContextPtr RemoteLibrary::GetNextQuery() {
     std::unique_lock<std::recursive_mutex> lock(this->queueMutex);
     while (this->queryQueue.empty() && !this->exit) {
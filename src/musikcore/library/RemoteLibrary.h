@@ -71,6 +71,7 @@ namespace musik { namespace core { namespace library {
             /* ILibrary */
             int Enqueue(QueryPtr query, Callback = Callback()) override;
             int EnqueueAndWait(QueryPtr query, size_t timeoutMs = kWaitIndefinite, Callback = Callback()) override;
+            bool Cancel(int queryId) override;
             musik::core::IIndexer *Indexer() override;
             int Id() override;
             const std::string& Name() override;
@@ -49,6 +49,7 @@ const std::string LyricsQuery::kQueryName = "LyricsQuery";
 
 LyricsQuery::LyricsQuery(const std::string& trackExternalId) {
     this->trackExternalId = trackExternalId;
+    this->SetPriority(Priority::Background);
 }
 
 std::string LyricsQuery::GetResult() {
@@ -47,6 +47,7 @@ const std::string MarkTrackPlayedQuery::kQueryName = "MarkTrackPlayedQuery";
 
 MarkTrackPlayedQuery::MarkTrackPlayedQuery(const int64_t trackId) noexcept {
     this->trackId = trackId;
+    this->SetPriority(Priority::Background);
 }
 
 bool MarkTrackPlayedQuery::OnRun(musik::core::db::Connection &db) {
@@ -42,8 +42,67 @@ using namespace musik::core;
 using namespace musik::core::db;
 using namespace musik::core::library::query;
 
+using QueueEdit = musik::core::audio::PlaybackService::QueueEdit;
+using QueueEdits = musik::core::audio::PlaybackService::QueueEdits;
+
+/* once restoring means replaying at least this many edits, Compact
+rewrites the saved queue. */
+static const int kCompactThreshold = 1024;
+
 const std::string PersistedPlayQueueQuery::kQueryName = "PersistedPlayQueueQuery";
 
+/* reads the saved queue and replays saved edits on top of it. returns
+the number of edits replayed. */
+static size_t loadPersistedQueue(Connection& db, TrackList& tracks) {
+    tracks.Clear();
+
+    {
+        Statement query("SELECT track_id FROM last_session_play_queue ORDER BY id ASC", db);
+        while (query.Step() == db::Row) {
+            tracks.Add(query.ColumnInt64(0));
+        }
+    }
+
+    size_t count = 0;
+
+    Statement edits("SELECT type, a, b FROM last_session_play_queue_edits ORDER BY id ASC", db);
+    while (edits.Step() == db::Row) {
+        const int64_t a = edits.ColumnInt64(1);
+        const int64_t b = edits.ColumnInt64(2);
+        switch (static_cast<QueueEdit::Type>(edits.ColumnInt32(0))) {
+            case QueueEdit::Type::Add: tracks.Add(a); break;
+            case QueueEdit::Type::Insert: tracks.Insert(a, (size_t) b); break;
+            case QueueEdit::Type::Swap: tracks.Swap((size_t) a, (size_t) b); break;
+            case QueueEdit::Type::Move: tracks.Move((size_t) a, (size_t) b); break;
+            case QueueEdit::Type::Delete: tracks.Delete((size_t) a); break;
+            case QueueEdit::Type::Clear: tracks.Clear(); break;
+        }
+        ++count;
+    }
+
+    return count;
+}
+
+/* returns false if anything failed to write */
+static bool writePersistedQueue(Connection& db, const TrackList& tracks) {
+    if (db.Execute("DELETE FROM last_session_play_queue") != db::Okay ||
+        db.Execute("DELETE FROM last_session_play_queue_edits") != db::Okay)
+    {
+        return false;
+    }
+
+    Statement insert("INSERT INTO last_session_play_queue (track_id) VALUES (?)", db);
+    for (size_t i = 0; i < tracks.Count(); i++) {
+        insert.Reset();
+        insert.BindInt64(0, tracks.GetId(i));
+        if (insert.Step() != db::Done) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 PersistedPlayQueueQuery::PersistedPlayQueueQuery(
     musik::core::ILibraryPtr library,
     musik::core::audio::PlaybackService& playback,
@@ -52,37 +111,85 @@ PersistedPlayQueueQuery::PersistedPlayQueueQuery(
 , playback(playback)
 , type(type)
 {
-
+    /* nobody is waiting on these */
+    if (type != Type::Restore) {
+        this->SetPriority(Priority::Bulk);
+    }
 }
 
 bool PersistedPlayQueueQuery::OnRun(musik::core::db::Connection &db) {
     if (this->type == Type::Save) {
-        ScopedTransaction transaction(db);
+        try {
+            ScopedTransaction transaction(db);
 
-        TrackList tracks(this->library);
-        this->playback.CopyTo(tracks);
+            TrackList tracks(this->library);
+            QueueEdits edits;
+            bool written = true;
 
-        {
-            Statement deleteTracks("DELETE FROM last_session_play_queue", db);
-            deleteTracks.Step();
-        }
+            /* usually we only need to append what changed since the last save;
+            if the queue was replaced outright we start over. */
+            if (this->playback.TakeQueueEdits(edits, tracks)) {
+                Statement insert("INSERT INTO last_session_play_queue_edits (type, a, b) VALUES (?, ?, ?)", db);
+                for (auto& edit : edits) {
+                    insert.Reset();
+                    insert.BindInt32(0, (int) edit.type);
+                    insert.BindInt64(1, edit.a);
+                    insert.BindInt64(2, edit.b);
+                    if (insert.Step() != db::Done) {
+                        written = false;
+                        break;
+                    }
+                }
+            }
+            else {
+                written = writePersistedQueue(db, tracks);
+            }
 
-        {
-            Statement insert("INSERT INTO last_session_play_queue (track_id) VALUES (?)", db);
-            for (size_t i = 0; i < tracks.Count(); i++) {
-                insert.Reset();
-                insert.BindInt64(0, tracks.GetId(i));
-                insert.Step();
+            const bool ok = written && !this->IsCanceled();
+            if (!ok) {
+                transaction.Cancel();
+            }
+
+            /* the edits we took are gone from memory. if they didn't make it to
+            disk, later edits can't be replayed on top of what's there, so make
+            the next save start over. */
+            if (!transaction.CommitAndRestart() || !ok) {
+                this->playback.InvalidateQueueEdits();
+                return false;
             }
         }
+        catch (...) {
+            this->playback.InvalidateQueueEdits();
+            throw;
+        }
     }
     else if (this->type == Type::Restore) {
+        TrackList tracks(this->library);
+        loadPersistedQueue(db, tracks);
+
         auto editor = this->playback.Edit();
         editor.Clear();
 
-        Statement query("SELECT track_id FROM last_session_play_queue ORDER BY id ASC", db);
-        while (query.Step() == db::Row) {
-            editor.Add(query.ColumnInt64(0));
+        for (size_t i = 0; i < tracks.Count(); i++) {
+            editor.Add(tracks.GetId(i));
+        }
+
+        /* still holding the editor's lock, so nothing else snuck in */
+        this->playback.ResetQueueEdits();
+    }
+    else if (this->type == Type::Compact) {
+        {
+            Statement count("SELECT COUNT(*) FROM last_session_play_queue_edits", db);
+            if (count.Step() != db::Row || count.ColumnInt32(0) < kCompactThreshold) {
+                return true;
+            }
+        }
+
+        ScopedTransaction transaction(db);
+        TrackList tracks(this->library);
+        loadPersistedQueue(db, tracks);
+        if (!writePersistedQueue(db, tracks)) {
+            transaction.Cancel();
         }
     }
 
@@ -57,6 +57,15 @@ namespace musik { namespace core { namespace library { namespace query {
                 return new PersistedPlayQueueQuery(library, playback, Type::Restore);
             }
 
+            /* folds saved edits back into the saved queue once there are
+            enough of them to slow down Restore. */
+            static PersistedPlayQueueQuery* Compact(
+                musik::core::ILibraryPtr library,
+                musik::core::audio::PlaybackService& playback)
+            {
+                return new PersistedPlayQueueQuery(library, playback, Type::Compact);
+            }
+
             DELETE_CLASS_DEFAULTS(PersistedPlayQueueQuery)
 
             /* IQuery */
@@ -67,7 +76,7 @@ namespace musik { namespace core { namespace library { namespace query {
             bool OnRun(musik::core::db::Connection &db) override;
 
         private:
-            enum class Type { Save, Restore };
+            enum class Type { Save, Restore, Compact };
 
             PersistedPlayQueueQuery(
                 musik::core::ILibraryPtr library,
@@ -74,6 +74,49 @@ namespace musik { namespace core { namespace library { namespace query {
                 return new WrappedTrackList(GetResult());
             }
 
+            /* used by LocalLibrary to coalesce queued duplicates: the hash is
+            a cheap first pass, the serialized form (which includes sort order,
+            limit and offset) decides. queries that can't be serialized are
+            never considered equivalent. */
+            bool IsEquivalentTo(TrackListQueryBase& other) {
+                if (this->Name() != other.Name() ||
+                    this->GetQueryHash() != other.GetQueryHash())
+                {
+                    return false;
+                }
+
+                try {
+                    return this->SerializeQuery() == other.SerializeQuery();
+                }
+                catch (...) {
+                    return false;
+                }
+            }
+
+            /* completes this query with a copy of the results produced by an
+            equivalent one, instead of running it again. */
+            void AdoptResult(TrackListQueryBase& other) {
+                auto result = this->GetResult();
+                auto otherResult = other.GetResult();
+                if (result && otherResult) {
+                    result->CopyFrom(*otherResult);
+                }
+
+                auto headers = this->GetHeaders();
+                auto otherHeaders = other.GetHeaders();
+                if (headers && otherHeaders) {
+                    *headers = *otherHeaders;
+                }
+
+                auto durations = this->GetDurations();
+                auto otherDurations = other.GetDurations();
+                if (durations && otherDurations) {
+                    *durations = *otherDurations;
+                }
+
+                this->SetStatus(other.GetStatus());
+            }
+
         protected:
 
             /* for IMetadataProxy */
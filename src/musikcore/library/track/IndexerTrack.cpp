@@ -43,8 +43,12 @@
 #include <musikcore/db/Statement.h>
 #include <musikcore/library/LocalLibrary.h>
 #include <musikcore/io/DataStreamFactory.h>
+#include <musikcore/support/ThreadGroup.h>
+
+#include <asio/io_service.hpp>
 
 #include <unordered_map>
+#include <unordered_set>
 #include <chrono>
 
 using namespace musik::core;
@@ -65,6 +69,15 @@ using namespace std::chrono;
 std::mutex IndexerTrack::sharedWriteMutex;
 static std::unordered_map<std::string, int64_t> metadataIdCache;
 static std::unordered_map<int, int64_t> thumbnailIdCache; /* albumId:thumbnailId */
+static std::unordered_set<int64_t> pendingThumbnails; /* albumIds with artwork in flight */
+
+/* embedded artwork is checksummed and written to disk on a small pool of its
+own, once per album, so the tag reading threads never wait on it. the pool
+only exists between OnIndexerStarted() and OnIndexerFinished(). */
+static const int THUMBNAIL_THREAD_COUNT = 2;
+static std::unique_ptr<asio::io_service> thumbnailIo;
+static std::unique_ptr<asio::io_service::work> thumbnailWork;
+static std::unique_ptr<ThreadGroup> thumbnailThreads;
 
 /* http://stackoverflow.com/a/2351171 */
 static size_t hash32(const char* str) noexcept {
@@ -78,16 +91,163 @@ static size_t hash32(const char* str) noexcept {
     return h;
 }
 
+static bool albumArtistFallbackDisabled() {
+    static bool disabled =
+        Preferences::ForComponent("settings")
+            ->GetBool(prefs::keys::DisableAlbumArtistFallback, false);
+    return disabled;
+}
+
+/* the same id SaveAlbum() will generate. tag readers ask about thumbnails
+before the track is saved, so apply the album artist fallback here too. */
+static int64_t albumIdFor(IndexerTrack& track) {
+    std::string albumArtist = track.GetString("album_artist");
+    if (albumArtist.empty() && !albumArtistFallbackDisabled()) {
+        albumArtist = track.GetString("artist");
+    }
+    const std::string value = track.GetString("album") + "-" + albumArtist;
+    return (int64_t) hash32(value.c_str());
+}
+
+/* must be called with sharedWriteMutex held */
+static int64_t findOrInsertThumbnail(
+    db::Connection& connection, int size, int64_t sum, bool& inserted)
+{
+    inserted = false;
+
+    db::Statement thumbs("SELECT id FROM thumbnails WHERE filesize=? AND checksum=?", connection);
+    thumbs.BindInt32(0, size);
+    thumbs.BindInt64(1, sum);
+
+    if (thumbs.Step() == db::Row) {
+        return thumbs.ColumnInt64(0); /* thumbnail already exists */
+    }
+
+    db::Statement insertThumb("INSERT INTO thumbnails (filesize,checksum) VALUES (?,?)", connection);
+    insertThumb.BindInt32(0, size);
+    insertThumb.BindInt64(1, sum);
+
+    if (insertThumb.Step() == db::Done) {
+        inserted = true;
+        return connection.LastInsertedId();
+    }
+
+    return 0;
+}
+
+static bool writeThumbnailFile(
+    const std::string& libraryDirectory, int64_t thumbnailId, const char* data, int size)
+{
+    std::string filename =
+        libraryDirectory +
+        "thumbs/" +
+        std::to_string(thumbnailId) +
+        ".jpg";
+
+#ifdef WIN32
+    std::wstring wfilename = u8to16(filename);
+    FILE *thumbFile = _wfopen(wfilename.c_str(), L"wb");
+#else
+    FILE *thumbFile = fopen(filename.c_str(), "wb");
+#endif
+
+    if (!thumbFile) {
+        return false;
+    }
+
+    const size_t written = fwrite(data, sizeof(char), size, thumbFile);
+    fclose(thumbFile);
+    return written == (size_t) size;
+}
+
+/* runs on the thumbnail pool. the checksum and file write happen outside of
+the write lock; only the database updates are serialized with the indexer. */
+void IndexerTrack::SaveAlbumThumbnail(
+    db::Connection* connection,
+    const std::string& libraryDirectory,
+    int64_t albumId,
+    std::shared_ptr<char> data,
+    int size)
+{
+    const int64_t sum = Checksum(data.get(), size);
+
+    int64_t thumbnailId = 0;
+    bool inserted = false;
+
+    {
+        std::unique_lock<std::mutex> lock(sharedWriteMutex);
+        thumbnailId = findOrInsertThumbnail(*connection, size, sum, inserted);
+    }
+
+    const bool written = !inserted ||
+        writeThumbnailFile(libraryDirectory, thumbnailId, data.get(), size);
+
+    std::unique_lock<std::mutex> lock(sharedWriteMutex);
+
+    if (thumbnailId != 0 && !written) {
+        db::Statement removeThumb("DELETE FROM thumbnails WHERE id=?", *connection);
+        removeThumb.BindInt64(0, thumbnailId);
+        removeThumb.Step();
+        thumbnailId = 0;
+    }
+
+    if (thumbnailId != 0) {
+        db::Statement updateAlbum("UPDATE albums SET thumbnail_id=? WHERE id=?", *connection);
+        updateAlbum.BindInt64(0, thumbnailId);
+        updateAlbum.BindInt64(1, albumId);
+        updateAlbum.Step();
+
+        /* tracks of this album saved while we were working */
+        db::Statement updateTracks("UPDATE tracks SET thumbnail_id=? WHERE album_id=?", *connection);
+        updateTracks.BindInt64(0, thumbnailId);
+        updateTracks.BindInt64(1, albumId);
+        updateTracks.Step();
+
+        thumbnailIdCache[(int) albumId] = thumbnailId;
+    }
+
+    /* if we failed, the next track from this album with artwork gets a turn */
+    pendingThumbnails.erase(albumId);
+}
+
 void IndexerTrack::OnIndexerStarted(db::Connection &dbConnection) {
-    /* unused, for now */
+    std::unique_lock<std::mutex> lock(sharedWriteMutex);
+
+    thumbnailIo = std::make_unique<asio::io_service>();
+    thumbnailWork = std::make_unique<asio::io_service::work>(*thumbnailIo);
+    thumbnailThreads = std::make_unique<ThreadGroup>();
+
+    asio::io_service* io = thumbnailIo.get();
+    for (int i = 0; i < THUMBNAIL_THREAD_COUNT; i++) {
+        thumbnailThreads->create_thread([io]() {
+            io->run();
+        });
+    }
 }
 
-void IndexerTrack::OnIndexerFinished(db::Connection &dbConnection) {
-    metadataIdCache.clear();
+size_t IndexerTrack::FlushThumbnails(db::Connection &dbConnection) {
+    /* let any outstanding artwork land before we fix up the tracks below */
+    std::unique_ptr<ThreadGroup> threads;
+
+    {
+        std::unique_lock<std::mutex> lock(sharedWriteMutex);
+        thumbnailWork.reset();
+        threads = std::move(thumbnailThreads);
+    }
+
+    if (threads) {
+        threads->join_all();
+    }
+
+    std::unique_lock<std::mutex> lock(sharedWriteMutex);
+
+    thumbnailIo.reset();
+    pendingThumbnails.clear();
 
     /* if we got some new album art, make sure all of the tracks for the
     album get the updated ID! */
-    std::string query = "UPDATE tracks SET thumbnail_id=? WHERE album_id=?)";
+    const size_t count = thumbnailIdCache.size();
+    std::string query = "UPDATE tracks SET thumbnail_id=? WHERE album_id=?";
     db::ScopedTransaction transaction(dbConnection);
     for (auto it : thumbnailIdCache) {
         db::Statement stmt(query.c_str(), dbConnection);
@@ -97,6 +257,16 @@ void IndexerTrack::OnIndexerFinished(db::Connection &dbConnection) {
     }
 
     thumbnailIdCache.clear();
+
+    return count;
+}
+
+void IndexerTrack::OnIndexerFinished(db::Connection &dbConnection) {
+    /* normally already flushed by the indexer; this is a no-op if so */
+    FlushThumbnails(dbConnection);
+
+    std::unique_lock<std::mutex> lock(sharedWriteMutex);
+    metadataIdCache.clear();
 }
 
 IndexerTrack::IndexerTrack(int64_t trackId)
@@ -106,6 +276,11 @@ IndexerTrack::IndexerTrack(int64_t trackId)
 }
 
 IndexerTrack::~IndexerTrack() {
+    if (this->internalMetadata && this->internalMetadata->thumbnailClaim != -1) {
+        std::unique_lock<std::mutex> lock(sharedWriteMutex);
+        this->ReleaseThumbnailClaim();
+    }
+
     delete this->internalMetadata;
     this->internalMetadata  = nullptr;
 }
@@ -182,12 +357,35 @@ void IndexerTrack::SetThumbnail(const char *data, long size) {
     this->internalMetadata->thumbnailSize = size;
 
     memcpy(this->internalMetadata->thumbnailData, data, size);
+
+    if (size <= 0) {
+        return;
+    }
+
+    /* now that we know we have a picture, claim the album's artwork; readers
+    of its other tracks will be told it's taken care of, so they can skip
+    copying their picture frames. */
+    std::unique_lock<std::mutex> lock(sharedWriteMutex);
+
+    if (!thumbnailIo || this->GetThumbnailId() != 0) {
+        return;
+    }
+
+    const int64_t albumId = albumIdFor(*this);
+
+    if (this->internalMetadata->thumbnailClaim == albumId ||
+        pendingThumbnails.find(albumId) != pendingThumbnails.end())
+    {
+        return;
+    }
+
+    this->ReleaseThumbnailClaim();
+    pendingThumbnails.insert(albumId);
+    this->internalMetadata->thumbnailClaim = albumId;
 }
 
 int64_t IndexerTrack::GetThumbnailId() {
-    std::string key = this->GetString("album") + "-" + this->GetString("album_artist");
-    const size_t id = hash32(key.c_str());
-    auto it = thumbnailIdCache.find((int) id);
+    auto it = thumbnailIdCache.find((int) albumIdFor(*this));
     if (it != thumbnailIdCache.end()) {
         return it->second;
     }
@@ -200,8 +398,60 @@ bool IndexerTrack::ContainsThumbnail() {
     {
         return true;
     }
+
     std::unique_lock<std::mutex> lock(sharedWriteMutex);
-    return this->GetThumbnailId() != 0;
+
+    if (this->GetThumbnailId() != 0) {
+        return true;
+    }
+
+    if (!thumbnailIo) {
+        return false;
+    }
+
+    /* another track of the album already supplied a picture, and claimed the
+    album's artwork; see SetThumbnail(). we don't claim anything here, because
+    our reader may not find a usable picture after all. */
+    const int64_t albumId = albumIdFor(*this);
+    return pendingThumbnails.find(albumId) != pendingThumbnails.end();
+}
+
+/* must be called with sharedWriteMutex held */
+void IndexerTrack::ReleaseThumbnailClaim() {
+    if (this->internalMetadata->thumbnailClaim != -1) {
+        pendingThumbnails.erase(this->internalMetadata->thumbnailClaim);
+        this->internalMetadata->thumbnailClaim = -1;
+    }
+}
+
+/* must be called with sharedWriteMutex held. hands our artwork to the
+thumbnail pool, unless another track of the album already did. */
+void IndexerTrack::QueueThumbnail(
+    db::Connection& connection,
+    const std::string& libraryDirectory,
+    int64_t albumId)
+{
+    auto md = this->internalMetadata;
+
+    if (md->thumbnailClaim == albumId) {
+        md->thumbnailClaim = -1; /* the claim now belongs to the job */
+    }
+    else if (pendingThumbnails.find(albumId) != pendingThumbnails.end()) {
+        return;
+    }
+    else {
+        pendingThumbnails.insert(albumId);
+    }
+
+    std::shared_ptr<char> data(md->thumbnailData, std::default_delete<char[]>());
+    const int size = md->thumbnailSize;
+    md->thumbnailData = nullptr;
+    md->thumbnailSize = 0;
+
+    db::Connection* db = &connection;
+    thumbnailIo->post([db, libraryDirectory, albumId, data, size]() {
+        SaveAlbumThumbnail(db, libraryDirectory, albumId, data, size);
+    });
 }
 
 void IndexerTrack::SetReplayGain(const ReplayGain& replayGain) {
@@ -454,39 +704,14 @@ int64_t IndexerTrack::SaveThumbnail(db::Connection& connection, const std::strin
     int64_t thumbnailId = 0;
 
     if (this->internalMetadata->thumbnailData) {
-        const int64_t sum = Checksum(this->internalMetadata->thumbnailData, this->internalMetadata->thumbnailSize);
-
-        db::Statement thumbs("SELECT id FROM thumbnails WHERE filesize=? AND checksum=?", connection);
-        thumbs.BindInt32(0, this->internalMetadata->thumbnailSize);
-        thumbs.BindInt64(1, sum);
-
-        if (thumbs.Step() == db::Row) {
-            thumbnailId = thumbs.ColumnInt64(0); /* thumbnail already exists */
-        }
-
-        if (thumbnailId == 0) { /* doesn't exist yet, let's insert the record and write the file */
-            db::Statement insertThumb("INSERT INTO thumbnails (filesize,checksum) VALUES (?,?)", connection);
-            insertThumb.BindInt32(0, this->internalMetadata->thumbnailSize);
-            insertThumb.BindInt64(1, sum);
+        const int size = this->internalMetadata->thumbnailSize;
+        const int64_t sum = Checksum(this->internalMetadata->thumbnailData, size);
 
-            if (insertThumb.Step() == db::Done) {
-                thumbnailId = connection.LastInsertedId();
+        bool inserted = false;
+        thumbnailId = findOrInsertThumbnail(connection, size, sum, inserted);
 
-                std::string filename =
-                    libraryDirectory +
-                    "thumbs/" +
-                    std::to_string(thumbnailId) +
-                    ".jpg";
-
-#ifdef WIN32
-                std::wstring wfilename = u8to16(filename);
-                FILE *thumbFile = _wfopen(wfilename.c_str(), L"wb");
-#else
-                FILE *thumbFile = fopen(filename.c_str(), "wb");
-#endif
-                fwrite(this->internalMetadata->thumbnailData, sizeof(char), this->internalMetadata->thumbnailSize, thumbFile);
-                fclose(thumbFile);
-            }
+        if (inserted) { /* didn't exist yet, write the file */
+            writeThumbnailFile(libraryDirectory, thumbnailId, this->internalMetadata->thumbnailData, size);
         }
     }
 
@@ -802,13 +1027,9 @@ void IndexerTrack::SaveDirectory(db::Connection& db, const std::string& filename
 }
 
 bool IndexerTrack::Save(db::Connection &dbConnection, std::string libraryDirectory) {
-    static bool disableAlbumArtistFallback =
-        Preferences::ForComponent("settings")
-            ->GetBool(prefs::keys::DisableAlbumArtistFallback, false);
-
     std::unique_lock<std::mutex> lock(sharedWriteMutex);
 
-    if (!disableAlbumArtistFallback && this->GetString("album_artist") == "") {
+    if (!albumArtistFallbackDisabled() && this->GetString("album_artist") == "") {
         this->SetValue("album_artist", this->GetString("artist").c_str());
     }
 
@@ -832,11 +1053,22 @@ bool IndexerTrack::Save(db::Connection &dbConnection, std::string libraryDirecto
         return false;
     }
 
-    /* see if the metadata reader plugin extracted a thumbnail. if not, we call
-    this->GetThumbnailId() to see if one already exists for the album */
-    int64_t thumbnailId = this->SaveThumbnail(dbConnection, libraryDirectory);
-    if (thumbnailId == 0) {
+    /* while indexing, artwork is resolved once per album: reuse it if we
+    already have it, otherwise whatever the metadata reader plugin extracted
+    is handed to the thumbnail pool once the album row exists. outside of a
+    scan, save the thumbnail inline like we always have. */
+    int64_t thumbnailId = 0;
+    bool queueThumbnail = false;
+
+    if (thumbnailIo) {
         thumbnailId = this->GetThumbnailId();
+        queueThumbnail = thumbnailId == 0 && this->internalMetadata->thumbnailData;
+    }
+    else {
+        thumbnailId = this->SaveThumbnail(dbConnection, libraryDirectory);
+        if (thumbnailId == 0) {
+            thumbnailId = this->GetThumbnailId();
+        }
     }
 
     const int64_t albumId = this->SaveAlbum(dbConnection, thumbnailId);
@@ -875,6 +1107,12 @@ bool IndexerTrack::Save(db::Connection &dbConnection, std::string libraryDirecto
         stmt.Step();
     }
 
+    if (queueThumbnail) {
+        this->QueueThumbnail(dbConnection, libraryDirectory, albumId);
+    }
+
+    this->ReleaseThumbnailClaim();
+
     ProcessNonStandardMetadata(dbConnection);
 
     /* sometimes indexer source plugins save the 'filename' field with a custom,
@@ -957,7 +1195,8 @@ TrackPtr IndexerTrack::Copy() {
 
 IndexerTrack::InternalMetadata::InternalMetadata()
 : thumbnailData(nullptr)
-, thumbnailSize(0) {
+, thumbnailSize(0)
+, thumbnailClaim(-1) {
 }
 
 IndexerTrack::InternalMetadata::~InternalMetadata() {
@@ -84,6 +84,10 @@ namespace musik { namespace core {
             static void OnIndexerStarted(db::Connection &dbConnection);
             static void OnIndexerFinished(db::Connection &dbConnection);
 
+            /* waits for outstanding artwork and points every track of each
+            album that got some at it. returns the number of albums updated. */
+            static size_t FlushThumbnails(db::Connection &dbConnection);
+
         protected:
             friend class Indexer;
             static std::mutex sharedWriteMutex;
@@ -101,6 +105,7 @@ namespace musik { namespace core {
                     std::shared_ptr<musik::core::sdk::ReplayGain> replayGain;
                     char *thumbnailData;
                     int thumbnailSize;
+                    int64_t thumbnailClaim; /* album we're extracting artwork for, or -1 */
             };
 
             InternalMetadata *internalMetadata;
@@ -111,6 +116,20 @@ namespace musik { namespace core {
 
             int64_t GetThumbnailId();
 
+            void QueueThumbnail(
+                db::Connection& connection,
+                const std::string& libraryDirectory,
+                int64_t albumId);
+
+            void ReleaseThumbnailClaim();
+
+            static void SaveAlbumThumbnail(
+                db::Connection* connection,
+                const std::string& libraryDirectory,
+                int64_t albumId,
+                std::shared_ptr<char> data,
+                int size);
+
             int64_t SaveGenre(db::Connection& connection);
 
             int64_t SaveArtist(db::Connection& connection);
@@ -0,0 +1,149 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "pch.hpp"
+
+#include <musikcore/library/track/TrackCache.h>
+#include <musikcore/library/LocalLibraryConstants.h>
+#include <musikcore/library/query/MarkTrackPlayedQuery.h>
+#include <musikcore/library/query/SetTrackRatingQuery.h>
+
+using namespace musik::core;
+using namespace musik::core::library;
+using namespace musik::core::library::query;
+
+TrackCache::TrackCache(ILibraryPtr library, size_t capacity)
+: library(library)
+, capacity(capacity)
+, generation(0) {
+    library->QueryCompleted.connect(this, &TrackCache::OnQueryCompleted);
+    auto indexer = library->Indexer();
+    if (indexer) {
+        indexer->Progress.connect(this, &TrackCache::OnIndexerProgress);
+        indexer->Finished.connect(this, &TrackCache::OnIndexerFinished);
+    }
+}
+
+TrackCache::~TrackCache() {
+}
+
+void TrackCache::Promote(Entry entry) {
+    this->tracks.splice(this->tracks.begin(), this->tracks, entry);
+}
+
+TrackPtr TrackCache::GetById(int64_t id) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    auto it = this->byId.find(id);
+    if (it != this->byId.end()) {
+        this->Promote(it->second);
+        return *it->second;
+    }
+    return TrackPtr();
+}
+
+TrackPtr TrackCache::GetByExternalId(const std::string& externalId) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    auto ext = this->byExternalId.find(externalId);
+    if (ext != this->byExternalId.end()) {
+        auto it = this->byId.find(ext->second);
+        if (it != this->byId.end()) {
+            this->Promote(it->second);
+            return *it->second;
+        }
+    }
+    return TrackPtr();
+}
+
+void TrackCache::Put(TrackPtr track, uint64_t generation) {
+    if (!track) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    if (generation != this->generation) {
+        return; /* invalidated while the track was being loaded */
+    }
+
+    const int64_t id = track->GetId();
+    auto it = this->byId.find(id);
+    if (it != this->byId.end()) {
+        *it->second = track;
+        this->Promote(it->second);
+    }
+    else {
+        this->tracks.push_front(track);
+        this->byId[id] = this->tracks.begin();
+    }
+
+    const std::string externalId = track->GetString(constants::Track::EXTERNAL_ID);
+    if (externalId.size()) {
+        this->byExternalId[externalId] = id;
+    }
+
+    while (this->tracks.size() > this->capacity) {
+        auto last = this->tracks.back();
+        this->byId.erase(last->GetId());
+        this->byExternalId.erase(last->GetString(constants::Track::EXTERNAL_ID));
+        this->tracks.pop_back();
+    }
+}
+
+uint64_t TrackCache::Generation() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    return this->generation;
+}
+
+void TrackCache::Clear() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    ++this->generation;
+    this->tracks.clear();
+    this->byId.clear();
+    this->byExternalId.clear();
+}
+
+void TrackCache::OnQueryCompleted(musik::core::db::IQuery* query) {
+    const std::string name = query->Name();
+    if (name == SetTrackRatingQuery::kQueryName || name == MarkTrackPlayedQuery::kQueryName) {
+        this->Clear();
+    }
+}
+
+void TrackCache::OnIndexerProgress(int count) {
+    this->Clear();
+}
+
+void TrackCache::OnIndexerFinished(int count) {
+    this->Clear();
+}
@@ -0,0 +1,83 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <musikcore/library/track/Track.h>
+#include <musikcore/library/ILibrary.h>
+
+#include <sigslot/sigslot.h>
+
+#include <mutex>
+#include <list>
+#include <unordered_map>
+
+namespace musik { namespace core {
+
+    /* a small, thread-safe LRU of recently requested tracks with full
+    metadata. it's cleared whenever the library reports a write that may
+    have changed track metadata (indexer progress, ratings, play counts). */
+    class TrackCache : public sigslot::has_slots<> {
+        public:
+            TrackCache(ILibraryPtr library, size_t capacity = 256);
+            virtual ~TrackCache();
+
+            TrackPtr GetById(int64_t id);
+            TrackPtr GetByExternalId(const std::string& externalId);
+
+            /* `generation` must be the value returned by Generation() before
+            the track was loaded; stale tracks are ignored. */
+            void Put(TrackPtr track, uint64_t generation);
+            uint64_t Generation();
+            void Clear();
+
+        private:
+            using Entry = std::list<TrackPtr>::iterator;
+
+            void OnQueryCompleted(musik::core::db::IQuery* query);
+            void OnIndexerProgress(int count);
+            void OnIndexerFinished(int count);
+
+            void Promote(Entry entry);
+
+            ILibraryPtr library;
+            size_t capacity;
+            std::mutex mutex;
+            uint64_t generation;
+            std::list<TrackPtr> tracks; /* most recently used first */
+            std::unordered_map<int64_t, Entry> byId;
+            std::unordered_map<std::string, int64_t> byExternalId;
+    };
+
+} }
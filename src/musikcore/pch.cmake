@@ -103,13 +103,16 @@ target_precompile_headers(musikcore
     "$<$<COMPILE_LANGUAGE:CXX>:sdk/IEncoder.h>"
     "$<$<COMPILE_LANGUAGE:CXX>:sdk/IEncoderFactory.h>"
     "$<$<COMPILE_LANGUAGE:CXX>:sdk/IEnvironment.h>"
+    "$<$<COMPILE_LANGUAGE:CXX>:sdk/IIndexerFileSource.h>"
     "$<$<COMPILE_LANGUAGE:CXX>:sdk/IIndexerNotifier.h>"
     "$<$<COMPILE_LANGUAGE:CXX>:sdk/IIndexerSource.h>"
     "$<$<COMPILE_LANGUAGE:CXX>:sdk/IIndexerWriter.h>"
     "$<$<COMPILE_LANGUAGE:CXX>:sdk/IMap.h>"
     "$<$<COMPILE_LANGUAGE:CXX>:sdk/IMapList.h>"
+    "$<$<COMPILE_LANGUAGE:CXX>:sdk/IMappedDataStream.h>"
     "$<$<COMPILE_LANGUAGE:CXX>:sdk/IMetadataProxy.h>"
     "$<$<COMPILE_LANGUAGE:CXX>:sdk/IOutput.h>"
+    "$<$<COMPILE_LANGUAGE:CXX>:sdk/IOutputStats.h>"
     "$<$<COMPILE_LANGUAGE:CXX>:sdk/IPcmVisualizer.h>"
     "$<$<COMPILE_LANGUAGE:CXX>:sdk/IPlaybackRemote.h>"
     "$<$<COMPILE_LANGUAGE:CXX>:sdk/IPlaybackService.h>"
@@ -147,8 +147,10 @@
 #include <musikcore/sdk/IIndexerWriter.h>
 #include <musikcore/sdk/IMap.h>
 #include <musikcore/sdk/IMapList.h>
+#include <musikcore/sdk/IMappedDataStream.h>
 #include <musikcore/sdk/IMetadataProxy.h>
 #include <musikcore/sdk/IOutput.h>
+#include <musikcore/sdk/IOutputStats.h>
 #include <musikcore/sdk/IPcmVisualizer.h>
 #include <musikcore/sdk/IPlaybackRemote.h>
 #include <musikcore/sdk/IPlaybackService.h>
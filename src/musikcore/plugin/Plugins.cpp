@@ -67,6 +67,7 @@ typedef void(*SetEnvironment)(IEnvironment*);
 typedef void(*SetDebug)(IDebug*);
 typedef void(*SetMetadataProxy)(IMetadataProxy*);
 typedef void(*SetIndexerNotifier)(IIndexerNotifier*);
+typedef void(*OnIndexerFinished)(int);
 
 static const std::string SUPEREQ_PLUGIN_GUID = "6f0ed53b-0f13-4220-9b0a-ca496b6421cc";
 
@@ -358,6 +359,19 @@ static class Environment: public IEnvironment {
 
 } environment;
 
+/* forwards the indexer's Finished signal to any plugin that exports an
+OnIndexerFinished(int) function, so it can refresh derived data. */
+static class IndexerListener : public sigslot::has_slots<> {
+    public:
+        void OnFinished(int trackCount) {
+            PluginFactory::Instance().QueryFunction<OnIndexerFinished>(
+                "OnIndexerFinished",
+                [trackCount](musik::core::sdk::IPlugin* plugin, OnIndexerFinished func) {
+                    func(trackCount);
+                });
+        }
+} indexerListener;
+
 namespace musik { namespace core { namespace plugin {
 
     void Init() {
@@ -400,6 +414,11 @@ namespace musik { namespace core { namespace plugin {
                 func(indexerNotifier);
             });
 
+        if (library->Indexer()) {
+            library->Indexer()->Finished.disconnect(&indexerListener);
+            library->Indexer()->Finished.connect(&indexerListener, &IndexerListener::OnFinished);
+        }
+
         /* environment */
         PluginFactory::Instance().QueryFunction<SetEnvironment>(
             "SetEnvironment",
@@ -423,6 +442,10 @@ namespace musik { namespace core { namespace plugin {
                 func(nullptr);
             });
 
+        if (::defaultLibrary && ::defaultLibrary->Indexer()) {
+            ::defaultLibrary->Indexer()->Finished.disconnect(&indexerListener);
+        }
+
         delete metadataProxy;
         ::messageQueue = nullptr;
         ::metadataProxy = nullptr;
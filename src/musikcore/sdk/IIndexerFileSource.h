@@ -0,0 +1,62 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "IIndexerSource.h"
+
+namespace musik { namespace core { namespace sdk {
+
+    /* an indexer source that lets the host walk the filesystem on its behalf.
+    hosts that know about this interface call BeginFileScan() instead of
+    Scan(), then offer every file whose extension CanIndexFile() accepts to
+    IndexFile(), and finish with EndFileScan() before ScanTrack(). IndexFile()
+    is called concurrently from the indexer's thread pool, so it (and any
+    IIndexerWriter calls it makes) must be thread safe. older hosts keep
+    calling Scan(), so implementations should continue to support it. */
+    class IIndexerFileSource: public IIndexerSource {
+        public:
+            virtual void BeginFileScan(
+                IIndexerWriter* indexer,
+                const char** indexerPaths,
+                unsigned indexerPathsCount) = 0;
+
+            virtual bool CanIndexFile(const char* extension) = 0;
+
+            virtual void IndexFile(IIndexerWriter* indexer, const char* path) = 0;
+
+            virtual void EndFileScan(IIndexerWriter* indexer) = 0;
+    };
+
+} } }
@@ -70,6 +70,15 @@ namespace musik { namespace core { namespace sdk {
             virtual ITrackList* QueryTracksByExternalId(
                 const char** externalIds, size_t externalIdCount) = 0;
 
+            /* resolve many tracks in a single round trip. `result[i]` is set
+            to the track for the i-th id (to be released by the caller), or
+            nullptr if it wasn't found. returns the number of tracks found. */
+            virtual size_t QueryTracksByIds(
+                const int64_t* trackIds, size_t trackIdCount, ITrack** result) = 0;
+
+            virtual size_t QueryTracksByExternalIds(
+                const char** externalIds, size_t externalIdCount, ITrack** result) = 0;
+
             virtual IValueList* ListCategories() = 0;
 
             virtual IValueList* QueryCategory(
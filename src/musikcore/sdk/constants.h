@@ -162,5 +162,5 @@ namespace musik {
                 static const char* ExternalId = "external_id";
             }
 
-            static const int SdkVersion = 21;
+            static const int SdkVersion = 22;
 } } }
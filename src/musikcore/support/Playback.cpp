@@ -115,6 +115,11 @@ namespace musik {
                             }
                         }
                     });
+
+                    /* the saved queue accumulates edits across sessions; fold them
+                    back in once nothing more important is going on. */
+                    library->Enqueue(std::shared_ptr<PersistedPlayQueueQuery>(
+                        PersistedPlayQueueQuery::Compact(library, playback)));
                 }
             }
 
@@ -84,6 +84,13 @@ namespace musik { namespace core { namespace prefs {
     const std::string keys::AsyncTrackListQueries = "AsyncTrackListQueries";
     const std::string keys::PiggyEnabled = "PiggyEnabled";
     const std::string keys::PiggyHostname = "PiggyHostname";
+    const std::string keys::ResamplerSampleRate = "ResamplerSampleRate";
+    const std::string keys::ResamplerQuality = "ResamplerQuality";
+    const std::string keys::LatencyProfile = "LatencyProfile";
+    const std::string keys::GaplessPrefillSeconds = "GaplessPrefillSeconds";
+    const std::string keys::GaplessPrefillLeadSeconds = "GaplessPrefillLeadSeconds";
+    const std::string keys::IndexerSkipUnchangedDirectories = "IndexerSkipUnchangedDirectories";
+    const std::string keys::IoMaxConcurrentReads = "IoMaxConcurrentReads";
 
 } } }
 
@@ -88,6 +88,13 @@ namespace musik { namespace core { namespace prefs {
         extern const std::string AsyncTrackListQueries;
         extern const std::string PiggyEnabled;
         extern const std::string PiggyHostname;
+        extern const std::string ResamplerSampleRate;
+        extern const std::string ResamplerQuality;
+        extern const std::string LatencyProfile;
+        extern const std::string GaplessPrefillSeconds;
+        extern const std::string GaplessPrefillLeadSeconds;
+        extern const std::string IndexerSkipUnchangedDirectories;
+        extern const std::string IoMaxConcurrentReads;
     }
 
 } } }
@@ -0,0 +1,214 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "pch.hpp"
+
+#include <musikcore/support/Trace.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <vector>
+
+using namespace musik::core;
+
+/* must be a power of two */
+static const size_t kRingSize = 8192;
+
+namespace {
+    enum Phase: char {
+        PhaseBegin = 'B',
+        PhaseEnd = 'E',
+        PhaseInstant = 'i',
+        PhaseComplete = 'X'
+    };
+
+    /* each slot is a tiny seqlock: `sequence` is zeroed while the slot is being
+    written, then set to the (1-based) index of the event it holds. readers
+    discard slots whose sequence changed while they were copying them. */
+    struct Slot {
+        std::atomic<uint64_t> sequence{ 0 };
+        std::atomic<const char*> name{ nullptr };
+        std::atomic<uint64_t> timestamp{ 0 };
+        std::atomic<uint64_t> duration{ 0 };
+        std::atomic<int64_t> id{ 0 };
+        std::atomic<uint32_t> thread{ 0 };
+        std::atomic<char> phase{ 0 };
+    };
+
+    struct Event {
+        const char* name;
+        uint64_t timestamp, duration;
+        int64_t id;
+        uint32_t thread;
+        char phase;
+    };
+}
+
+static Slot ring[kRingSize];
+static std::atomic<uint64_t> nextIndex(0);
+static const auto epoch = std::chrono::steady_clock::now();
+
+static uint32_t currentThreadId() {
+    thread_local uint32_t id = (uint32_t)
+        std::hash<std::thread::id>()(std::this_thread::get_id());
+    return id;
+}
+
+static void record(Phase phase, const char* name, uint64_t timestamp, uint64_t duration, int64_t id) {
+    const uint64_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = ring[index & (kRingSize - 1)];
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.timestamp.store(timestamp, std::memory_order_relaxed);
+    slot.duration.store(duration, std::memory_order_relaxed);
+    slot.id.store(id, std::memory_order_relaxed);
+    slot.thread.store(currentThreadId(), std::memory_order_relaxed);
+    slot.phase.store(phase, std::memory_order_relaxed);
+    slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+static std::vector<Event> snapshot() {
+    std::vector<Event> result;
+    const uint64_t end = nextIndex.load(std::memory_order_acquire);
+    const uint64_t start = end > kRingSize ? end - kRingSize : 0;
+    result.reserve((size_t)(end - start));
+
+    for (uint64_t i = start; i < end; i++) {
+        Slot& slot = ring[i & (kRingSize - 1)];
+        const uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before != i + 1) {
+            continue; /* being written, or already overwritten */
+        }
+
+        Event event;
+        event.name = slot.name.load(std::memory_order_relaxed);
+        event.timestamp = slot.timestamp.load(std::memory_order_relaxed);
+        event.duration = slot.duration.load(std::memory_order_relaxed);
+        event.id = slot.id.load(std::memory_order_relaxed);
+        event.thread = slot.thread.load(std::memory_order_relaxed);
+        event.phase = slot.phase.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == before && event.name) {
+            result.push_back(event);
+        }
+    }
+
+    return result;
+}
+
+static std::string escape(const char* str) {
+    std::string result;
+    for (const char* c = str; *c; c++) {
+        switch (*c) {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            default:
+                if ((unsigned char) *c >= 0x20) {
+                    result += *c;
+                }
+                break;
+        }
+    }
+    return result;
+}
+
+namespace musik { namespace core { namespace trace {
+
+    uint64_t Now() {
+        return (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    void Begin(const char* name, int64_t id) {
+        record(PhaseBegin, name, Now(), 0, id);
+    }
+
+    void End(const char* name, int64_t id) {
+        record(PhaseEnd, name, Now(), 0, id);
+    }
+
+    void Instant(const char* name, int64_t id) {
+        record(PhaseInstant, name, Now(), 0, id);
+    }
+
+    void Complete(const char* name, uint64_t startUs, uint64_t durationUs, int64_t id) {
+        record(PhaseComplete, name, startUs, durationUs, id);
+    }
+
+    std::string ToChromeJson() {
+        auto const events = snapshot();
+
+        std::string result = "{\"traceEvents\":[";
+        bool first = true;
+        for (auto& e : events) {
+            if (!first) {
+                result += ",";
+            }
+            first = false;
+
+            result += "{\"name\":\"" + escape(e.name) + "\"";
+            result += ",\"ph\":\"" + std::string(1, e.phase) + "\"";
+            result += ",\"ts\":" + std::to_string(e.timestamp);
+            if (e.phase == PhaseComplete) {
+                result += ",\"dur\":" + std::to_string(e.duration);
+            }
+            if (e.phase == PhaseInstant) {
+                result += ",\"s\":\"t\"";
+            }
+            result += ",\"pid\":1,\"tid\":" + std::to_string(e.thread);
+            if (e.id != 0) {
+                result += ",\"args\":{\"id\":" + std::to_string(e.id) + "}";
+            }
+            result += "}";
+        }
+        result += "],\"displayTimeUnit\":\"ms\"}";
+
+        return result;
+    }
+
+    bool WriteChromeJson(const std::string& filename) {
+        std::ofstream out(filename, std::ios::out | std::ios::trunc);
+        if (!out.good()) {
+            return false;
+        }
+        out << ToChromeJson();
+        return out.good();
+    }
+
+} } }
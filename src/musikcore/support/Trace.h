@@ -0,0 +1,83 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <musikcore/config.h>
+
+#include <cstdint>
+#include <string>
+
+namespace musik {
+    namespace core {
+        namespace trace {
+            /* a tiny, always-on tracing facility. events are recorded into a
+            fixed-size lock-free ring, so recording is cheap enough to leave in
+            hot paths, and old events are silently overwritten. `name` must be
+            a string literal (or otherwise outlive the process); it is stored
+            by pointer, not copied. */
+
+            void Begin(const char* name, int64_t id = 0);
+            void End(const char* name, int64_t id = 0);
+            void Instant(const char* name, int64_t id = 0);
+            void Complete(const char* name, uint64_t startUs, uint64_t durationUs, int64_t id = 0);
+
+            /* microseconds on a monotonic clock, relative to process start */
+            uint64_t Now();
+
+            /* snapshot the ring as a Chrome trace (about://tracing, Perfetto) */
+            std::string ToChromeJson();
+            bool WriteChromeJson(const std::string& filename);
+
+            class Span {
+                public:
+                    Span(const char* name, int64_t id = 0) noexcept
+                    : name(name), id(id), start(Now()) {
+                    }
+
+                    ~Span() {
+                        Complete(this->name, this->start, Now() - this->start, this->id);
+                    }
+
+                    Span(const Span&) = delete;
+                    Span& operator=(const Span&) = delete;
+
+                private:
+                    const char* name;
+                    int64_t id;
+                    uint64_t start;
+            };
+        }
+    }
+}
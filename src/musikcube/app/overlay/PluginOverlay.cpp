@@ -39,6 +39,7 @@
 #include <musikcore/support/Preferences.h>
 #include <musikcore/support/PreferenceKeys.h>
 #include <musikcore/plugin/PluginFactory.h>
+#include <musikcore/audio/DspChain.h>
 #include <musikcore/sdk/ISchema.h>
 #include <musikcore/sdk/String.h>
 
@@ -79,7 +80,11 @@ static void showConfigureOverlay(IPlugin* plugin, SchemaPtr schema) {
     std::string title = _TSTR("settings_configure_plugin_title");
     str::ReplaceAll(title, "{{name}}", plugin->Name());
     auto prefs = Preferences::ForPlugin(plugin->Name());
-    SchemaOverlay::Show(title, prefs, schema, [](bool) {});
+    SchemaOverlay::Show(title, prefs, schema, [](bool changed) {
+        if (changed) {
+            musik::core::audio::DspChain::Invalidate();
+        }
+    });
 }
 
 static void showNoSchemaDialog(const std::string& name) {
@@ -132,6 +137,7 @@ class PluginListAdapter : public ScrollAdapterBase {
             PluginInfoPtr plugin = this->plugins.at(index);
             plugin->enabled = !plugin->enabled;
             this->prefs->SetBool(plugin->fn, plugin->enabled);
+            musik::core::audio::DspChain::Invalidate();
         }
 
         virtual size_t GetEntryCount() override {
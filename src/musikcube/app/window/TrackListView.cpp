@@ -97,6 +97,14 @@ TrackListView::TrackListView(
 }
 
 void TrackListView::Requery(std::shared_ptr<TrackListQueryBase> query) {
+    /* the previous query was superseded; don't let it hold up this one. */
+    if (this->query && this->query != query) {
+        const int status = this->query->GetStatus();
+        if (status == IQuery::Idle || status == IQuery::Running) {
+            this->library->Cancel(this->query->GetId());
+        }
+    }
+
     this->query = query;
     this->library->Enqueue(this->query);
 }
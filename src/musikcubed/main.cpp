@@ -20,6 +20,7 @@
 #include <musikcore/runtime/Message.h>
 #include <musikcore/support/PreferenceKeys.h>
 #include <musikcore/support/Common.h>
+#include <musikcore/support/Trace.h>
 
 #include "../musikcore/sdk/version.h"
 
@@ -30,6 +31,8 @@ using namespace musik::core::runtime;
 
 static const char* DEFAULT_LOCKFILE = "/tmp/musikcubed.lock";
 static const char* LOCKFILE_OVERRIDE = "MUSIKCUBED_LOCKFILE_OVERRIDE";
+static const char* DEFAULT_TRACEFILE = "/tmp/musikcubed-trace.json";
+static const char* TRACEFILE_OVERRIDE = "MUSIKCUBED_TRACEFILE_OVERRIDE";
 static const short EVENT_DISPATCH = 1;
 static const short EVENT_QUIT = 2;
 static const pid_t NOT_RUNNING = (pid_t) -1;
@@ -43,6 +46,8 @@ static pid_t getDaemonPid();
 static void initForeground();
 static void initDaemon();
 static void stopDaemon();
+static void dumpTrace();
+static std::string getTracefileFn();
 static void initUtf8();
 static void run();
 
@@ -71,6 +76,19 @@ class EvMessageQueue: public MessageQueue {
             write(pipeFd[1], &EVENT_QUIT, sizeof(EVENT_QUIT));
         }
 
+        static void SignalDumpTrace(ev::sig& signal, int revents) {
+            /* write to a temp file first so `--dump-trace` never sees a
+            partially written file */
+            const std::string fn = getTracefileFn();
+            const std::string temp = fn + ".tmp";
+            if (trace::WriteChromeJson(temp) && rename(temp.c_str(), fn.c_str()) == 0) {
+                debug::info("daemon", "wrote trace to " + fn);
+            }
+            else {
+                debug::error("daemon", "failed to write trace to " + fn);
+            }
+        }
+
         void ReadCallback(ev::io& watcher, int revents) {
             short type;
             if (read(pipeFd[0], &type, sizeof(type)) == 0) {
@@ -93,6 +111,10 @@ class EvMessageQueue: public MessageQueue {
             sio.set<&EvMessageQueue::SignalQuit>();
             sio.start(SIGTERM);
 
+            traceSio.set(loop);
+            traceSio.set<&EvMessageQueue::SignalDumpTrace>();
+            traceSio.start(SIGUSR2);
+
             write(pipeFd[1], &EVENT_DISPATCH, sizeof(EVENT_DISPATCH));
 
             loop.run(0);
@@ -102,6 +124,7 @@ class EvMessageQueue: public MessageQueue {
         ev::dynamic_loop loop;
         ev::io io;
         ev::sig sio;
+        ev::sig traceSio;
 };
 
 static void printHelp() {
@@ -110,6 +133,7 @@ static void printHelp() {
     std::cout << "    --foreground: start the in the foreground\n";
     std::cout << "    --stop: shut down the daemon\n";
     std::cout << "    --running: check if the daemon is running\n";
+    std::cout << "    --dump-trace: write the daemon's recent trace events as chrome trace json\n";
     std::cout << "    --version: print the version\n";
     std::cout << "    --help: show this message\n\n";
 }
@@ -128,6 +152,9 @@ static void handleCommandLine(int argc, char** argv) {
         else if (command == "--stop") {
             stopDaemon();
         }
+        else if (command == "--dump-trace") {
+            dumpTrace();
+        }
         else if (command == "--version") {
             std::cout << "\n  musikcubed version: " << MUSIKCUBE_VERSION << " " << MUSIKCUBE_VERSION_COMMIT_HASH << "\n\n";
         }
@@ -156,6 +183,42 @@ static std::string getLockfileFn() {
     return result;
 }
 
+static std::string getTracefileFn() {
+    std::string result = DEFAULT_TRACEFILE;
+    const char* userTrace = std::getenv(TRACEFILE_OVERRIDE);
+    if (userTrace && strlen(userTrace)) {
+        result = userTrace;
+    }
+    return result;
+}
+
+static void dumpTrace() {
+    pid_t pid = getDaemonPid();
+    if (pid == NOT_RUNNING) {
+        std::cout << "\n  musikcubed is not running\n\n";
+        exit(EXIT_FAILURE);
+    }
+
+    /* the daemon writes the file when it receives SIGUSR2; remove any stale
+    copy first so we can tell when the new one lands. */
+    const std::string fn = getTracefileFn();
+    remove(fn.c_str());
+    kill(pid, SIGUSR2);
+
+    struct stat st;
+    int count = 0;
+    while (stat(fn.c_str(), &st) != 0 && count++ < 20) { /* try for 5 seconds */
+        usleep(250000);
+    }
+
+    if (stat(fn.c_str(), &st) != 0) {
+        std::cout << "\n  musikcubed did not write a trace\n\n";
+        exit(EXIT_FAILURE);
+    }
+
+    std::cout << "\n  trace written to " << fn << "\n\n";
+}
+
 static void stopDaemon() {
     pid_t pid = getDaemonPid();
     if (pid == NOT_RUNNING) {
@@ -36,13 +36,25 @@
 
 #include <musikcore/sdk/constants.h>
 #include <musikcore/sdk/IPreferences.h>
+#include <musikcore/sdk/ISchema.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 
 static musik::core::sdk::IPreferences* prefs;
 
 #define BUFFER_COUNT 16
-#define PCM_ACCESS_TYPE SND_PCM_ACCESS_RW_INTERLEAVED
-#define PCM_FORMAT SND_PCM_FORMAT_FLOAT_LE
+#define BUFFER_TIME_MICROS 500000 /* 0.5s latency, for 2048 frame buffers */
+#define MIN_BUFFER_TIME_MICROS 50000
+#define MAX_BUFFER_TIME_MICROS 1000000
+#define REFERENCE_FRAMES_PER_BUFFER 2048
+#define PERIOD_COUNT 4
 #define PREF_DEVICE_ID "device_id"
+#define PREF_SAMPLE_FORMAT "sample_format"
+#define PREF_DITHER "dither"
+#define PREF_BIT_PERFECT "bit_perfect"
+#define PREF_USE_MMAP "use_mmap"
 
 #define LOCK(x) \
     /*std::cerr << "locking " << x << "\n";*/ \
@@ -54,8 +66,8 @@ static musik::core::sdk::IPreferences* prefs;
 #define CHECK_QUIT() if (this->quit) { return; }
 #define PRINT_ERROR(x) std::cerr << "AlsaOut: error! " << snd_strerror(x) << std::endl;
 
-#define WRITE_BUFFER(handle, context, samples) \
-    err = snd_pcm_writei(handle, context->buffer->BufferPointer(), samples); \
+#define WRITE_BUFFER(handle, data, samples) \
+    err = snd_pcm_writei(handle, data, samples); \
     if (err < 0) { PRINT_ERROR(err); }
 
 static inline bool playable(snd_pcm_t* pcm) {
@@ -128,10 +140,51 @@ extern "C" void SetPreferences(musik::core::sdk::IPreferences* prefs) {
     prefs->Save();
 }
 
+extern "C" musik::core::sdk::ISchema* GetSchema() {
+    auto schema = new TSchema<>();
+    schema->AddEnum(PREF_SAMPLE_FORMAT, { "auto", "float", "s32", "s24", "s24_3", "s16" }, "auto");
+    schema->AddBool(PREF_DITHER, true);
+    schema->AddBool(PREF_BIT_PERFECT, false);
+    schema->AddBool(PREF_USE_MMAP, true);
+    return schema;
+}
+
 static std::string getDeviceId() {
     return getPreferenceString<std::string>(prefs, PREF_DEVICE_ID, "");
 }
 
+static bool getBool(const char* key, bool defaultValue) {
+    return prefs ? prefs->GetBool(key, defaultValue) : defaultValue;
+}
+
+/* formats we can produce, in the order we try them. integer formats come
+first so hardware devices get samples they can consume natively, instead of
+going through alsa's plug layer. */
+static std::vector<snd_pcm_format_t> candidateFormats() {
+    const std::string preferred = getPreferenceString<std::string>(prefs, PREF_SAMPLE_FORMAT, "auto");
+
+    std::vector<snd_pcm_format_t> result;
+    if (preferred == "float") { result.push_back(SND_PCM_FORMAT_FLOAT_LE); }
+    else if (preferred == "s32") { result.push_back(SND_PCM_FORMAT_S32_LE); }
+    else if (preferred == "s24") { result.push_back(SND_PCM_FORMAT_S24_LE); }
+    else if (preferred == "s24_3") { result.push_back(SND_PCM_FORMAT_S24_3LE); }
+    else if (preferred == "s16") { result.push_back(SND_PCM_FORMAT_S16_LE); }
+
+    for (auto format : {
+        SND_PCM_FORMAT_S32_LE,
+        SND_PCM_FORMAT_S24_LE,
+        SND_PCM_FORMAT_S24_3LE,
+        SND_PCM_FORMAT_S16_LE,
+        SND_PCM_FORMAT_FLOAT_LE })
+    {
+        if (std::find(result.begin(), result.end(), format) == result.end()) {
+            result.push_back(format);
+        }
+    }
+
+    return result;
+}
+
 AlsaOut::AlsaOut()
 : pcmHandle(nullptr)
 , device("default")
@@ -141,7 +194,13 @@ AlsaOut::AlsaOut()
 , quit(false)
 , paused(false)
 , latency(0)
-, initialized(false) {
+, initialized(false)
+, bitPerfect(false)
+, deviceGeneration(0)
+, framesPerBuffer(0)
+, bufferFrames(0)
+, periodFrames(0)
+, startThreshold(0) {
     std::cerr << "AlsaOut::AlsaOut() called" << std::endl;
     this->writeThread.reset(new std::thread(std::bind(&AlsaOut::WriteLoop, this)));
 }
@@ -170,6 +229,7 @@ void AlsaOut::CloseDevice() {
         std::cerr << "AlsaOut: closing PCM handle\n";
         snd_pcm_close(this->pcmHandle);
         this->pcmHandle = nullptr;
+        ++this->deviceGeneration;
         this->latency = 0.0;
     }
 }
@@ -236,6 +296,8 @@ void AlsaOut::InitDevice() {
     std::string preferredDeviceId = this->GetPreferredDeviceId();
     bool preferredOk = false;
 
+    this->bitPerfect = getBool(PREF_BIT_PERFECT, false);
+
     if (preferredDeviceId.size() > 0) {
         if ((err = snd_pcm_open(&this->pcmHandle, preferredDeviceId.c_str(), SND_PCM_STREAM_PLAYBACK, 0)) < 0) {
             std::cerr << "AlsaOut: cannot opened preferred device id " << preferredDeviceId << ": " << snd_strerror(err) << std::endl;
@@ -260,16 +322,40 @@ void AlsaOut::InitDevice() {
         goto error;
     }
 
-    if ((err = snd_pcm_hw_params_set_access(pcmHandle, hardware, PCM_ACCESS_TYPE)) < 0) {
+    /* mmap transfers let us convert straight into the device's ring buffer,
+    skipping the extra copy writei() makes. not every device supports it. */
+    this->pcmType = SND_PCM_ACCESS_RW_INTERLEAVED;
+    if (getBool(PREF_USE_MMAP, true) &&
+        snd_pcm_hw_params_test_access(pcmHandle, hardware, SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0)
+    {
+        this->pcmType = SND_PCM_ACCESS_MMAP_INTERLEAVED;
+    }
+
+    if ((err = snd_pcm_hw_params_set_access(pcmHandle, hardware, this->pcmType)) < 0) {
         std::cerr << "AlsaOut: cannot set access type " << snd_strerror(err) << std::endl;
         goto error;
     }
 
-    if ((err = snd_pcm_hw_params_set_format(pcmHandle, hardware, PCM_FORMAT)) < 0) {
+    this->pcmFormat = this->NegotiateFormat();
+
+    if ((err = snd_pcm_hw_params_set_format(pcmHandle, hardware, this->pcmFormat)) < 0) {
         std::cerr << "AlsaOut: cannot set sample format " << snd_strerror(err) << std::endl;
         goto error;
     }
 
+    this->converter.SetFormat(this->pcmFormat);
+    this->converter.SetDither(!this->bitPerfect && getBool(PREF_DITHER, true));
+
+    /* in bit-perfect mode we want the device's native rate, or nothing. if it
+    can't do it we fall back to letting alsa resample, rather than failing. */
+    if (this->bitPerfect) {
+        snd_pcm_hw_params_set_rate_resample(pcmHandle, hardware, 0);
+        if (snd_pcm_hw_params_test_rate(pcmHandle, hardware, rate, 0) < 0) {
+            std::cerr << "AlsaOut: device doesn't support " << rate << "hz natively, resampling\n";
+            snd_pcm_hw_params_set_rate_resample(pcmHandle, hardware, 1);
+        }
+    }
+
     if ((err = snd_pcm_hw_params_set_rate_near(pcmHandle, hardware, &rate, 0)) < 0) {
         std::cerr << "AlsaOut: cannot set sample rate " << snd_strerror(err) << std::endl;
         goto error;
@@ -280,13 +366,49 @@ void AlsaOut::InitDevice() {
         goto error;
     }
 
+    {
+        /* size the device buffer in proportion to the buffers the stream sends
+        us, so the latency profile chosen in the core carries through to the
+        hardware. */
+        unsigned int bufferTime = BUFFER_TIME_MICROS;
+        if (this->framesPerBuffer > 0) {
+            bufferTime = (unsigned int) std::max(
+                (size_t) MIN_BUFFER_TIME_MICROS,
+                std::min(
+                    (size_t) MAX_BUFFER_TIME_MICROS,
+                    (size_t) BUFFER_TIME_MICROS * this->framesPerBuffer / REFERENCE_FRAMES_PER_BUFFER));
+        }
+        unsigned int periods = PERIOD_COUNT;
+        snd_pcm_hw_params_set_buffer_time_near(pcmHandle, hardware, &bufferTime, &dir);
+        snd_pcm_hw_params_set_periods_near(pcmHandle, hardware, &periods, &dir);
+    }
+
     if ((err = snd_pcm_hw_params(pcmHandle, hardware)) < 0) {
         std::cerr << "AlsaOut: cannot set parameters " << snd_strerror(err) << std::endl;
         goto error;
     }
 
+    snd_pcm_hw_params_get_buffer_size(hardware, &this->bufferFrames);
+    snd_pcm_hw_params_get_period_size(hardware, &this->periodFrames, &dir);
     snd_pcm_hw_params_free(hardware);
 
+    /* same thresholds snd_pcm_set_params() would use: start once every full
+    period has been queued, and wake up a period at a time. */
+    this->startThreshold = this->periodFrames
+        ? (this->bufferFrames / this->periodFrames) * this->periodFrames
+        : this->bufferFrames;
+
+    {
+        snd_pcm_sw_params_t* software = nullptr;
+        snd_pcm_sw_params_alloca(&software);
+        snd_pcm_sw_params_current(pcmHandle, software);
+        snd_pcm_sw_params_set_start_threshold(pcmHandle, software, this->startThreshold);
+        snd_pcm_sw_params_set_avail_min(pcmHandle, software, this->periodFrames);
+        if ((err = snd_pcm_sw_params(pcmHandle, software)) < 0) {
+            std::cerr << "AlsaOut: cannot set software parameters " << snd_strerror(err) << std::endl;
+        }
+    }
+
     if ((err = snd_pcm_prepare (pcmHandle)) < 0) {
         std::cerr << "AlsaOut: cannot prepare audio interface for use " << snd_strerror(err) << std::endl;
         goto error;
@@ -294,7 +416,10 @@ void AlsaOut::InitDevice() {
 
     snd_pcm_nonblock(pcmHandle, 0); /* operate in blocking mode for simplicity */
 
-    std::cerr << "AlsaOut: device seems to be prepared for use!\n";
+    std::cerr << "AlsaOut: device seems to be prepared for use! format="
+        << snd_pcm_format_name(this->pcmFormat)
+        << (this->pcmType == SND_PCM_ACCESS_MMAP_INTERLEAVED ? " (mmap)" : "")
+        << (this->bitPerfect ? " (bit-perfect)" : "") << "\n";
     this->initialized = true;
 
     return;
@@ -303,6 +428,97 @@ error:
     this->CloseDevice();
 }
 
+snd_pcm_format_t AlsaOut::NegotiateFormat() {
+    for (auto format : candidateFormats()) {
+        if (snd_pcm_hw_params_test_format(this->pcmHandle, this->hardware, format) == 0) {
+            return format;
+        }
+    }
+    return SND_PCM_FORMAT_FLOAT_LE;
+}
+
+int AlsaOut::WriteMmap(const float* samples, snd_pcm_uframes_t frames, float volume, std::unique_lock<std::recursive_mutex>& lock) {
+    /* the lock is released whenever we wait below, and SetFormat() may reopen
+    the device in the meantime. remember what we started with so we can tell. */
+    const size_t generation = this->deviceGeneration;
+    const size_t channels = this->channels;
+    const auto periodTime = std::chrono::microseconds(
+        this->rate ? (1000000 * this->periodFrames / this->rate) : 10000);
+
+    auto deviceChanged = [this, generation, channels]() {
+        return this->deviceGeneration != generation || this->channels != channels;
+    };
+
+    snd_pcm_uframes_t written = 0;
+
+    while (written < frames && !this->quit && this->pcmHandle) {
+        if (this->paused) {
+            this->threadEvent.wait_for(lock, periodTime);
+            if (deviceChanged()) { break; }
+            continue;
+        }
+
+        snd_pcm_sframes_t avail = snd_pcm_avail_update(this->pcmHandle);
+        if (avail < 0) {
+            int err = snd_pcm_recover(this->pcmHandle, (int) avail, 1);
+            if (err < 0) {
+                return err;
+            }
+            continue;
+        }
+
+        if ((snd_pcm_uframes_t) avail < std::min(this->periodFrames, frames - written)) {
+            if (snd_pcm_state(this->pcmHandle) == SND_PCM_STATE_PREPARED) {
+                /* the ring buffer is full, but the device hasn't started yet */
+                snd_pcm_start(this->pcmHandle);
+            }
+            else {
+                /* let the device drain a bit. the lock is released while we
+                wait, so we never block pause/stop/volume changes. */
+                this->threadEvent.wait_for(lock, periodTime / 2);
+                if (deviceChanged()) { break; }
+            }
+            continue;
+        }
+
+        const snd_pcm_channel_area_t* areas = nullptr;
+        snd_pcm_uframes_t offset = 0, count = frames - written;
+        int err = snd_pcm_mmap_begin(this->pcmHandle, &areas, &offset, &count);
+        if (err < 0) {
+            if ((err = snd_pcm_recover(this->pcmHandle, err, 1)) < 0) {
+                return err;
+            }
+            continue;
+        }
+
+        /* interleaved, so every channel shares the first area. convert
+        straight into it; there's no intermediate copy. */
+        uint8_t* dst = (uint8_t*) areas[0].addr + (areas[0].first / 8) + offset * (areas[0].step / 8);
+        this->converter.Convert(samples + written * channels, count * channels, volume, dst);
+
+        snd_pcm_sframes_t committed = snd_pcm_mmap_commit(this->pcmHandle, offset, count);
+        if (committed < 0 || (snd_pcm_uframes_t) committed != count) {
+            err = committed < 0 ? (int) committed : -EPIPE;
+            if ((err = snd_pcm_recover(this->pcmHandle, err, 1)) < 0) {
+                return err;
+            }
+            continue;
+        }
+
+        written += count;
+    }
+
+    /* mmap transfers don't start the device automatically */
+    if (this->pcmHandle && !deviceChanged() && snd_pcm_state(this->pcmHandle) == SND_PCM_STATE_PREPARED) {
+        snd_pcm_sframes_t avail = snd_pcm_avail_update(this->pcmHandle);
+        if (avail >= 0 && this->bufferFrames - (snd_pcm_uframes_t) avail >= this->startThreshold) {
+            snd_pcm_start(this->pcmHandle);
+        }
+    }
+
+    return (int) written;
+}
+
 void AlsaOut::Release() {
     delete this;
 }
@@ -315,10 +531,9 @@ double AlsaOut::Latency() {
             snd_pcm_uframes_t bufferSize = 0, periodSize = 0;
             snd_pcm_get_params(this->pcmHandle, &bufferSize, &periodSize);
 
+            /* buffer size is in frames, regardless of sample format */
             if (bufferSize) {
-                this->latency =
-                (double) bufferSize /
-                (double) (this->rate * this->channels * sizeof(float));
+                this->latency = (double) bufferSize / (double) this->rate;
             }
         }
     }
@@ -399,34 +614,40 @@ void AlsaOut::WriteLoop() {
                 this->buffers.pop_front();
             }
 
-            int err;
+            int err = 0;
 
             if (next) {
                 size_t samples = next->buffer->Samples();
                 size_t channels = next->buffer->Channels();
                 size_t samplesPerChannel = samples / channels;
-                float volume = (float) this->volume;
-
-                /* software volume; alsa doesn't support this internally. this is about
-                as terrible as an algorithm can be -- it's just a linear ramp. */
-                //std::cerr << "volume=" << volume << std::endl;
-                if (volume != 1.0f) {
-                    float *buffer = next->buffer->BufferPointer();
-                    for (size_t i = 0; i < samples; i++) {
-                        (*buffer) *= volume;
-                        ++buffer;
-                    }
-                }
 
                 {
                     LOCK("WRITE_BUFFER()");
                     if (this->pcmHandle) {
-                        WRITE_BUFFER(this->pcmHandle, next, samplesPerChannel); /* sets 'err' */
+                        /* software volume; alsa doesn't support this internally. it's
+                        applied while converting to the device's sample format. in
+                        bit-perfect mode samples go through untouched. */
+                        const float volume = this->bitPerfect ? 1.0f : (float) this->volume;
+
+                        if (this->pcmType == SND_PCM_ACCESS_MMAP_INTERLEAVED) {
+                            err = this->WriteMmap(next->buffer->BufferPointer(), samplesPerChannel, volume, lock);
+                            if (err < 0) { PRINT_ERROR(err); }
+                        }
+                        else {
+                            const uint8_t* data = (const uint8_t*) next->buffer->BufferPointer();
+                            if (!this->converter.IsPassthrough(volume)) {
+                                this->scratch.resize(samples * this->converter.BytesPerSample());
+                                this->converter.Convert(next->buffer->BufferPointer(), samples, volume, this->scratch.data());
+                                data = this->scratch.data();
+                            }
+
+                            WRITE_BUFFER(this->pcmHandle, data, samplesPerChannel); /* sets 'err' */
 
-                        if (err == -EINTR || err == -EPIPE || err == -ESTRPIPE) {
-                            if (!snd_pcm_recover(this->pcmHandle, err, 1)) {
-                                /* try one more time... */
-                                WRITE_BUFFER(this->pcmHandle, next, samplesPerChannel);
+                            if (err == -EINTR || err == -EPIPE || err == -ESTRPIPE) {
+                                if (!snd_pcm_recover(this->pcmHandle, err, 1)) {
+                                    /* try one more time... */
+                                    WRITE_BUFFER(this->pcmHandle, data, samplesPerChannel);
+                                }
                             }
                         }
                     }
@@ -494,29 +715,14 @@ void AlsaOut::SetFormat(IBuffer *buffer) {
     {
         this->channels = buffer->Channels();
         this->rate = buffer->SampleRate();
+        this->framesPerBuffer = this->channels ? buffer->Samples() / this->channels : 0;
 
         this->CloseDevice();
 
+        /* note: InitDevice() configures format, access, rate and buffer sizes
+        itself; calling snd_pcm_set_params() afterwards would undo them. */
         this->InitDevice();
 
-        if (this->pcmHandle) {
-            int err = snd_pcm_set_params(
-                this->pcmHandle,
-                PCM_FORMAT,
-                PCM_ACCESS_TYPE,
-                this->channels,
-                this->rate,
-                1, /* allow resampling */
-                500000); /* 0.5s latency */
-
-            if (err > 0) {
-                std::cerr << "AlsaOut: set format error: " << snd_strerror(err) << std::endl;
-            }
-            else {
-                this->SetVolume(this->volume);
-            }
-        }
-
         std::cerr << "AlsaOut: device format initialized from buffer\n";
     }
 }
@@ -34,6 +34,7 @@
 #pragma once
 
 #include "pch.h"
+#include "SampleConverter.h"
 
 #include <musikcore/sdk/IOutput.h>
 #include <musikcore/sdk/IDevice.h>
@@ -44,6 +45,7 @@
 #include <condition_variable>
 #include <thread>
 #include <functional>
+#include <string>
 
 class AlsaOut : public musik::core::sdk::IOutput {
     public:
@@ -81,6 +83,8 @@ class AlsaOut : public musik::core::sdk::IOutput {
         size_t CountBuffersWithProvider(musik::core::sdk::IBufferProvider* provider);
         void SetFormat(musik::core::sdk::IBuffer *buffer);
         void InitDevice();
+        snd_pcm_format_t NegotiateFormat();
+        int WriteMmap(const float* samples, snd_pcm_uframes_t frames, float volume, std::unique_lock<std::recursive_mutex>& lock);
         void CloseDevice();
         void WriteLoop();
         std::string GetPreferredDeviceId();
@@ -96,6 +100,13 @@ class AlsaOut : public musik::core::sdk::IOutput {
         double volume;
         double latency;
         volatile bool quit, paused, initialized;
+        bool bitPerfect;
+        size_t deviceGeneration; /* bumped whenever the pcm handle is closed */
+        size_t framesPerBuffer;
+        snd_pcm_uframes_t bufferFrames, periodFrames, startThreshold;
+
+        SampleConverter converter;
+        std::vector<uint8_t> scratch;
 
         std::unique_ptr<std::thread> writeThread;
         std::recursive_mutex stateMutex;
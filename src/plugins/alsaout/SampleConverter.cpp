@@ -0,0 +1,257 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "SampleConverter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define CONVERTER_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    #include <arm_neon.h>
+    #define CONVERTER_NEON 1
+#endif
+
+/* full scale for each integer format. integer sources are decoded to float
+by dividing by these same values, so converting back is lossless when there
+is no volume or dither applied (i.e. in bit-perfect mode). */
+static float scaleFor(snd_pcm_format_t format) {
+    switch (format) {
+        case SND_PCM_FORMAT_S16_LE: return 32768.0f;
+        case SND_PCM_FORMAT_S24_LE:
+        case SND_PCM_FORMAT_S24_3LE: return 8388608.0f;
+        case SND_PCM_FORMAT_S32_LE: return 2147483648.0f;
+        default: return 1.0f;
+    }
+}
+
+/* largest value we can emit. for S32 this is the largest float below 2^31,
+because 2^31 - 1 isn't representable. */
+static float maxFor(snd_pcm_format_t format) {
+    switch (format) {
+        case SND_PCM_FORMAT_S32_LE: return 2147483520.0f;
+        default: return scaleFor(format) - 1.0f;
+    }
+}
+
+static inline uint32_t xorshift(uint32_t& s) {
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+}
+
+/* uniformly distributed in [0, 1) */
+static inline float uniform(uint32_t x) {
+    uint32_t bits = (x >> 9) | 0x3f800000;
+    float result;
+    memcpy(&result, &bits, sizeof(float));
+    return result - 1.0f;
+}
+
+static inline void store(snd_pcm_format_t format, int32_t value, uint8_t* out, size_t index) {
+    switch (format) {
+        case SND_PCM_FORMAT_S16_LE:
+            ((int16_t*) out)[index] = (int16_t) value;
+            break;
+        case SND_PCM_FORMAT_S24_3LE: {
+            uint8_t* dst = out + index * 3;
+            dst[0] = (uint8_t) (value);
+            dst[1] = (uint8_t) (value >> 8);
+            dst[2] = (uint8_t) (value >> 16);
+            break;
+        }
+        default:
+            ((int32_t*) out)[index] = value;
+            break;
+    }
+}
+
+SampleConverter::SampleConverter()
+: format(SND_PCM_FORMAT_FLOAT_LE)
+, bytesPerSample(sizeof(float))
+, dither(false) {
+    this->seed[0] = 0x9e3779b9;
+    this->seed[1] = 0x7f4a7c15;
+    this->seed[2] = 0x85ebca6b;
+    this->seed[3] = 0xc2b2ae35;
+}
+
+bool SampleConverter::SetFormat(snd_pcm_format_t format) {
+    switch (format) {
+        case SND_PCM_FORMAT_FLOAT_LE:
+        case SND_PCM_FORMAT_S32_LE:
+        case SND_PCM_FORMAT_S24_LE:
+            this->bytesPerSample = 4;
+            break;
+        case SND_PCM_FORMAT_S24_3LE:
+            this->bytesPerSample = 3;
+            break;
+        case SND_PCM_FORMAT_S16_LE:
+            this->bytesPerSample = 2;
+            break;
+        default:
+            return false;
+    }
+    this->format = format;
+    return true;
+}
+
+bool SampleConverter::IsPassthrough(float gain) const {
+    return this->format == SND_PCM_FORMAT_FLOAT_LE && gain == 1.0f;
+}
+
+void SampleConverter::Convert(const float* in, size_t samples, float gain, void* out) {
+    uint8_t* dst = (uint8_t*) out;
+
+    if (this->format == SND_PCM_FORMAT_FLOAT_LE) {
+        float* f = (float*) out;
+        for (size_t i = 0; i < samples; i++) {
+            f[i] = in[i] * gain;
+        }
+        return;
+    }
+
+    const float scale = scaleFor(this->format) * gain;
+    const float lo = -scaleFor(this->format);
+    const float hi = maxFor(this->format);
+
+    /* most sources carry more precision than S16 or S24 can hold (lossy
+    decoders, resampling, DSPs), even at unity gain, so we dither whenever we
+    truncate to one of those. at 32 bits the dither would be far below float
+    precision anyway. */
+    const bool dither = this->dither && this->format != SND_PCM_FORMAT_S32_LE;
+
+    size_t i = 0;
+
+#if defined(CONVERTER_SSE2)
+    const __m128 vscale = _mm_set1_ps(scale);
+    const __m128 vlo = _mm_set1_ps(lo);
+    const __m128 vhi = _mm_set1_ps(hi);
+    const __m128i exponent = _mm_set1_epi32(0x3f800000);
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128i rng = _mm_loadu_si128((const __m128i*) this->seed);
+    alignas(16) int32_t packed[4];
+
+    for (; i + 4 <= samples; i += 4) {
+        __m128 v = _mm_mul_ps(_mm_loadu_ps(in + i), vscale);
+
+        if (dither) {
+            /* triangular pdf: the difference of two uniform values, +/- 1 lsb */
+            __m128 r[2];
+            for (int k = 0; k < 2; k++) {
+                rng = _mm_xor_si128(rng, _mm_slli_epi32(rng, 13));
+                rng = _mm_xor_si128(rng, _mm_srli_epi32(rng, 17));
+                rng = _mm_xor_si128(rng, _mm_slli_epi32(rng, 5));
+                r[k] = _mm_sub_ps(_mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(rng, 9), exponent)), one);
+            }
+            v = _mm_add_ps(v, _mm_sub_ps(r[0], r[1]));
+        }
+
+        v = _mm_min_ps(_mm_max_ps(v, vlo), vhi);
+        const __m128i iv = _mm_cvtps_epi32(v); /* round to nearest */
+
+        switch (this->format) {
+            case SND_PCM_FORMAT_S16_LE:
+                _mm_storel_epi64((__m128i*) (dst + i * 2), _mm_packs_epi32(iv, iv));
+                break;
+            case SND_PCM_FORMAT_S24_3LE:
+                _mm_store_si128((__m128i*) packed, iv);
+                for (int k = 0; k < 4; k++) {
+                    store(this->format, packed[k], dst, i + k);
+                }
+                break;
+            default:
+                _mm_storeu_si128((__m128i*) (dst + i * 4), iv);
+                break;
+        }
+    }
+
+    _mm_storeu_si128((__m128i*) this->seed, rng);
+#elif defined(CONVERTER_NEON)
+    const float32x4_t vlo = vdupq_n_f32(lo);
+    const float32x4_t vhi = vdupq_n_f32(hi);
+    const uint32x4_t exponent = vdupq_n_u32(0x3f800000);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    uint32x4_t rng = vld1q_u32(this->seed);
+    int32_t packed[4];
+
+    for (; i + 4 <= samples; i += 4) {
+        float32x4_t v = vmulq_n_f32(vld1q_f32(in + i), scale);
+
+        if (dither) {
+            float32x4_t r[2];
+            for (int k = 0; k < 2; k++) {
+                rng = veorq_u32(rng, vshlq_n_u32(rng, 13));
+                rng = veorq_u32(rng, vshrq_n_u32(rng, 17));
+                rng = veorq_u32(rng, vshlq_n_u32(rng, 5));
+                r[k] = vsubq_f32(vreinterpretq_f32_u32(vorrq_u32(vshrq_n_u32(rng, 9), exponent)), one);
+            }
+            v = vaddq_f32(v, vsubq_f32(r[0], r[1]));
+        }
+
+        v = vminq_f32(vmaxq_f32(v, vlo), vhi);
+        const int32x4_t iv = vcvtnq_s32_f32(v);
+
+        switch (this->format) {
+            case SND_PCM_FORMAT_S16_LE:
+                vst1_s16((int16_t*) (dst + i * 2), vqmovn_s32(iv));
+                break;
+            case SND_PCM_FORMAT_S24_3LE:
+                vst1q_s32(packed, iv);
+                for (int k = 0; k < 4; k++) {
+                    store(this->format, packed[k], dst, i + k);
+                }
+                break;
+            default:
+                vst1q_s32((int32_t*) (dst + i * 4), iv);
+                break;
+        }
+    }
+
+    vst1q_u32(this->seed, rng);
+#endif
+
+    for (; i < samples; i++) {
+        float v = in[i] * scale;
+        if (dither) {
+            v += uniform(xorshift(this->seed[0])) - uniform(xorshift(this->seed[0]));
+        }
+        v = std::min(std::max(v, lo), hi);
+        store(this->format, (int32_t) lrintf(v), dst, i);
+    }
+}
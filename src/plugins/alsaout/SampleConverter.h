@@ -0,0 +1,70 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "pch.h"
+
+#include <cstdint>
+#include <cstddef>
+
+/* converts the float samples we get from the core into whatever sample format
+the device was opened with, applying software volume and (optionally) TPDF
+dither in the same pass. */
+class SampleConverter {
+    public:
+        SampleConverter();
+
+        /* returns false if the format isn't one we know how to produce */
+        bool SetFormat(snd_pcm_format_t format);
+        snd_pcm_format_t Format() const { return this->format; }
+        size_t BytesPerSample() const { return this->bytesPerSample; }
+
+        /* dither is applied whenever `Convert()` requantizes to an integer
+        format narrower than float (S16 and S24). callers that want samples
+        to go through untouched (bit-perfect mode) turn it off here. */
+        void SetDither(bool dither) { this->dither = dither; }
+
+        /* true if `Convert()` would be a plain copy, i.e. the device takes
+        float samples and there is no volume to apply. */
+        bool IsPassthrough(float gain) const;
+
+        void Convert(const float* in, size_t samples, float gain, void* out);
+
+    private:
+        snd_pcm_format_t format;
+        size_t bytesPerSample;
+        bool dither;
+        uint32_t seed[4];
+};
@@ -37,6 +37,7 @@
 #include <musikcore/sdk/constants.h>
 #include <musikcore/sdk/IPlugin.h>
 #include <musikcore/sdk/IOutput.h>
+#include <musikcore/sdk/ISchema.h>
 
 #include "AlsaOut.h"
 
@@ -60,3 +61,5 @@ extern "C" musik::core::sdk::IPlugin* GetPlugin() {
 extern "C" musik::core::sdk::IOutput* GetAudioOutput() {
 	return new AlsaOut();
 }
+
+extern "C" musik::core::sdk::ISchema* GetSchema();
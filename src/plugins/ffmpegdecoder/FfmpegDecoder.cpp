@@ -46,6 +46,7 @@
 
 #define DEFAULT_FRAME_SIZE 4096
 #define BUFFER_SIZE 4096
+#define MAPPED_BUFFER_SIZE 65536
 #define PROBE_SIZE 32768
 
 using namespace musik::core::sdk;
@@ -86,6 +87,17 @@ static void logError(const std::string& message) {
 
 static int readCallback(void* opaque, uint8_t* buffer, int bufferSize) {
     FfmpegDecoder* decoder = static_cast<FfmpegDecoder*>(opaque);
+    if (decoder && decoder->MappedStream()) {
+        PositionType count = 0;
+        auto data = decoder->MappedStream()->Borrow((PositionType) bufferSize, &count);
+        if (data) {
+            if (count > 0) {
+                memcpy(buffer, data, (size_t) count);
+                return (int) count;
+            }
+            return AVERROR_EOF;
+        }
+    }
     if (decoder && decoder->Stream()) {
         auto count = decoder->Stream()->Read(buffer, (PositionType) bufferSize);
         if (count > 0) {
@@ -290,8 +302,12 @@ bool FfmpegDecoder::Open(musik::core::sdk::IDataStream *stream) {
         ::debug->Info(TAG, "parsing data stream...");
 
         this->stream = stream;
+        this->mappedStream = dynamic_cast<IMappedDataStream*>(stream);
 
-        const int ioContextBufferSize = AV_INPUT_BUFFER_PADDING_SIZE + BUFFER_SIZE;
+        /* reads from a mapped stream are just a memcpy from the page cache,
+        so let avio ask for a lot more at a time. */
+        const int ioContextBufferSize = AV_INPUT_BUFFER_PADDING_SIZE +
+            (this->mappedStream ? MAPPED_BUFFER_SIZE : BUFFER_SIZE);
         unsigned char* ioContextBuffer = (unsigned char*) av_malloc(ioContextBufferSize);
 
         this->ioContext = avio_alloc_context(
@@ -37,6 +37,7 @@
 #include <musikcore/sdk/constants.h>
 #include <musikcore/sdk/IDecoder.h>
 #include <musikcore/sdk/IDataStream.h>
+#include <musikcore/sdk/IMappedDataStream.h>
 
 extern "C" {
     #pragma warning(push, 0)
@@ -74,6 +75,7 @@ class FfmpegDecoder: public musik::core::sdk::IDecoder {
         void SetPreferredSampleRate(int rate) override { this->preferredSampleRate = rate; }
 
         IDataStream* Stream() { return this->stream; }
+        IMappedDataStream* MappedStream() { return this->mappedStream; }
 
     private:
         void Reset();
@@ -86,6 +88,7 @@ class FfmpegDecoder: public musik::core::sdk::IDecoder {
         void FlushAndFinalizeDecoder();
 
         musik::core::sdk::IDataStream* stream;
+        musik::core::sdk::IMappedDataStream* mappedStream { nullptr };
         AVIOContext* ioContext;
         AVAudioFifo* outputFifo;
         AVFormatContext* formatContext;
@@ -125,5 +125,6 @@ const char* GmeDataStream::Uri() {
 }
 
 bool GmeDataStream::CanPrefetch() {
-    return this->stream->CanPrefetch();
+    /* the decoder downcasts to us, so we must never be wrapped */
+    return false;
 }
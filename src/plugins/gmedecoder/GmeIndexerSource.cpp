@@ -74,20 +74,13 @@ ScanResult GmeIndexerSource::Scan(
     const char** indexerPaths,
     unsigned indexerPathsCount)
 {
-    /* keep these for later, for the removal phase */
-    for (size_t i = 0; i < indexerPathsCount; i++) {
-        this->paths.insert(fs::canonicalizePath(std::string(indexerPaths[i])));
-    }
+    /* hosts that support IIndexerFileSource walk the filesystem for us; older
+    ones call this, and we do it ourselves. */
+    this->BeginFileScan(indexer, indexerPaths, indexerPathsCount);
 
     auto checkFile = [this, indexer](const std::string& path) {
         if (canHandle(path)) {
-            try {
-                this->UpdateMetadata(path, this, indexer);
-            }
-            catch (...) {
-                std::string error = str::Format("error reading metadata for %s", path.c_str());
-                debug->Error(PLUGIN_NAME, error.c_str());
-            }
+            this->IndexFile(indexer, path.c_str());
         }
     };
 
@@ -101,11 +94,52 @@ ScanResult GmeIndexerSource::Scan(
         }
     }
 
-    indexer->CommitProgress(this, this->filesIndexed);
+    this->EndFileScan(indexer);
 
     return ScanCommit;
 }
 
+void GmeIndexerSource::BeginFileScan(
+    IIndexerWriter* indexer,
+    const char** indexerPaths,
+    unsigned indexerPathsCount)
+{
+    /* keep these for later, for the removal phase */
+    for (size_t i = 0; i < indexerPathsCount; i++) {
+        this->paths.insert(fs::canonicalizePath(std::string(indexerPaths[i])));
+    }
+}
+
+bool GmeIndexerSource::CanIndexFile(const char* extension) {
+    return extension && canHandle(std::string(extension));
+}
+
+void GmeIndexerSource::IndexFile(IIndexerWriter* indexer, const char* path) {
+    if (this->interrupt) {
+        return;
+    }
+
+    try {
+        this->UpdateMetadata(path, this, indexer);
+    }
+    catch (...) {
+        std::string error = str::Format("error reading metadata for %s", path);
+        debug->Error(PLUGIN_NAME, error.c_str());
+    }
+}
+
+void GmeIndexerSource::EndFileScan(IIndexerWriter* indexer) {
+    size_t progress = 0;
+
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        progress = this->filesIndexed + this->tracksIndexed;
+        this->filesIndexed = this->tracksIndexed = 0;
+    }
+
+    indexer->CommitProgress(this, (unsigned) progress);
+}
+
 void GmeIndexerSource::Interrupt() {
     this->interrupt = true;
 }
@@ -122,7 +156,13 @@ void GmeIndexerSource::ScanTrack(
 
         /* if the file doesn't exist anymore, or it was flagged as invalid,
         we remove it */
-        if (!fs::fileExists(fn) || invalidFiles.find(fn) != invalidFiles.end()) {
+        bool invalid = false;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            invalid = invalidFiles.find(fn) != invalidFiles.end();
+        }
+
+        if (invalid || !fs::fileExists(fn)) {
             indexer->RemoveByExternalId(this, externalId);
             return;
         }
@@ -148,6 +188,8 @@ void GmeIndexerSource::UpdateMetadata(
     IIndexerSource* source,
     IIndexerWriter* indexer)
 {
+    size_t tracks = 0;
+
     /* only need to do this check once, and it's relatively expensive because
     it requires a db read. cache we've already done it. */
     int64_t modifiedTime = fs::getLastModifiedTime(fn);
@@ -160,6 +202,7 @@ void GmeIndexerSource::UpdateMetadata(
         gme_err_t err = gme_open_file(fn.c_str(), &data, gme_info_only);
         if (err) {
             debug->Error(PLUGIN_NAME, str::Format("error opening %s", fn.c_str()).c_str());
+            std::unique_lock<std::mutex> lock(this->mutex);
             invalidFiles.insert(fn);
         }
         else {
@@ -232,7 +275,7 @@ void GmeIndexerSource::UpdateMetadata(
                 gme_free_info(info);
                 indexer->Save(source, track, externalId.c_str());
                 track->Release();
-                ++tracksIndexed;
+                ++tracks;
             }
         }
 
@@ -240,8 +283,18 @@ void GmeIndexerSource::UpdateMetadata(
     }
 
     /* we commit progress every so often */
-    if (++this->filesIndexed % 300 == 0) {
-        indexer->CommitProgress(this, this->filesIndexed + this->tracksIndexed);
-        this->filesIndexed = this->tracksIndexed = 0;
+    size_t progress = 0;
+
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->tracksIndexed += tracks;
+        if (++this->filesIndexed % 300 == 0) {
+            progress = this->filesIndexed + this->tracksIndexed;
+            this->filesIndexed = this->tracksIndexed = 0;
+        }
+    }
+
+    if (progress) {
+        indexer->CommitProgress(this, (unsigned) progress);
     }
 }
\ No newline at end of file
@@ -0,0 +1,121 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "config.h"
+#include <map>
+#include <algorithm>
+#include <iterator>
+
+/* keeps track of which byte ranges of a file have been downloaded. ranges
+are half-open [start, end) and adjacent or overlapping ranges are merged. */
+class ExtentMap {
+    public:
+        using Offset = long;
+
+        void Add(Offset start, Offset end) {
+            if (end <= start) {
+                return;
+            }
+
+            /* find the first extent that could touch [start, end) */
+            auto it = this->extents.upper_bound(start);
+            if (it != this->extents.begin()) {
+                auto prev = std::prev(it);
+                if (prev->second >= start) {
+                    it = prev;
+                }
+            }
+
+            /* swallow everything it overlaps or abuts */
+            while (it != this->extents.end() && it->first <= end) {
+                start = std::min(start, it->first);
+                end = std::max(end, it->second);
+                it = this->extents.erase(it);
+            }
+
+            this->extents[start] = end;
+        }
+
+        /* returns the end of the extent containing `offset`. if `offset` isn't
+        covered by any extent, `offset` itself is returned. note that offsets
+        at the very end of an extent are considered available. */
+        Offset AvailableEnd(Offset offset) const {
+            auto it = this->extents.upper_bound(offset);
+            if (it != this->extents.begin()) {
+                --it;
+                if (offset <= it->second) {
+                    return it->second;
+                }
+            }
+            return offset;
+        }
+
+        bool Available(Offset offset) const {
+            auto it = this->extents.upper_bound(offset);
+            return it != this->extents.begin() && offset <= std::prev(it)->second;
+        }
+
+        /* returns the start of the first extent beginning after `offset`, or
+        `fallback` if there is none. */
+        Offset NextStart(Offset offset, Offset fallback) const {
+            auto it = this->extents.upper_bound(offset);
+            return it == this->extents.end() ? fallback : it->first;
+        }
+
+        /* finds the first byte at or after `from` that hasn't been downloaded */
+        Offset FirstMissing(Offset from) const {
+            return std::max(from, this->AvailableEnd(from));
+        }
+
+        bool Complete(Offset length) const {
+            return length > 0 && this->FirstMissing(0) >= length;
+        }
+
+        Offset Total() const {
+            Offset total = 0;
+            for (auto& kv : this->extents) {
+                total += kv.second - kv.first;
+            }
+            return total;
+        }
+
+        void Clear() {
+            this->extents.clear();
+        }
+
+    private:
+        std::map<Offset, Offset> extents;
+};
@@ -36,6 +36,7 @@
 
 #include "HttpDataStream.h"
 #include "LruDiskCache.h"
+#include "ExtentMap.h"
 
 #include <musikcore/sdk/IEnvironment.h>
 #include <musikcore/sdk/IPreferences.h>
@@ -50,6 +51,8 @@
 #include <unordered_set>
 #include <chrono>
 #include <atomic>
+#include <vector>
+#include <cstdlib>
 
 #pragma warning(push, 0)
 #include <../../3rdparty/include/nlohmann/json.hpp>
@@ -81,12 +84,18 @@ static const int kDefaultPreCacheSizeBytes = 524288; /*2^19 */
 static const int kDefaultChunkSizeBytes = 131072; /* 2^17 */
 static const int kDefaultConnectionTimeoutSeconds = 15;
 static const int kDefaultReadTimeoutSeconds = 30;
+static const int kDefaultMaxParallelRequests = 2;
+static const int kDefaultParallelChunkSizeBytes = 0; /* disabled */
+static const int kDefaultSeekThresholdBytes = 262144; /* 2^18 */
 
 static const std::string kMaxCacheFiles = "max_cache_files";
 static const std::string kPreCacheBufferSizeBytesKey = "precache_buffer_size_bytes";
 static const std::string kChunkSizeBytesKey = "chunk_size_bytes";
 static const std::string kConnectionTimeoutSecondsKey = "connection_timeout_seconds";
 static const std::string kReadTimeoutSecondsKey = "read_timeout_seconds";
+static const std::string kMaxParallelRequestsKey = "max_parallel_requests";
+static const std::string kParallelChunkSizeBytesKey = "parallel_chunk_size_bytes";
+static const std::string kSeekThresholdBytesKey = "seek_threshold_bytes";
 
 const std::string HttpDataStream::kRemoteTrackHost = "musikcore://remote-track/";
 
@@ -112,6 +121,9 @@ extern "C" DLLEXPORT musik::core::sdk::ISchema * GetSchema() {
     schema->AddInt(kChunkSizeBytesKey, kDefaultChunkSizeBytes, 32768);
     schema->AddInt(kConnectionTimeoutSecondsKey, kDefaultConnectionTimeoutSeconds, 1);
     schema->AddInt(kReadTimeoutSecondsKey, kDefaultReadTimeoutSeconds, 1);
+    schema->AddInt(kMaxParallelRequestsKey, kDefaultMaxParallelRequests, 1, 8);
+    schema->AddInt(kParallelChunkSizeBytesKey, kDefaultParallelChunkSizeBytes, 0);
+    schema->AddInt(kSeekThresholdBytesKey, kDefaultSeekThresholdBytes, 0);
     return schema;
 }
 
@@ -132,18 +144,25 @@ static size_t cacheId(const std::string& uri) {
     return std::hash<std::string>()(uri);
 }
 
+/* reads from the temp file while it's being written to by one or more download
+workers. the file may be sparse: a seek can kick off a ranged request far ahead of
+the sequential download, so we keep track of exactly which extents are valid. the
+handle is unbuffered: stdio would otherwise read ahead past the valid extent and
+hand us stale hole bytes once the writer fills that range in. */
 class FileReadStream {
     public:
         FileReadStream(FILE* file, long maxLength) {
             this->file = file;
             this->maxLength = maxLength;
+            this->Unbuffer();
             this->Reset();
         }
 
         FileReadStream(const std::string& fn, int64_t instanceId) {
             this->file = diskCache.Open(cacheId(fn), instanceId, "rb");
             this->maxLength = -1;
-            Reset();
+            this->Unbuffer();
+            this->Reset();
         }
 
         ~FileReadStream() {
@@ -155,11 +174,11 @@ class FileReadStream {
 
         void Reset() {
             this->interrupted = false;
-            this->length = 0;
+            this->extents.Clear();
 
             if (this->file) {
                 fseek(this->file, 0, SEEK_END);
-                this->length = (PositionType) ftell(this->file);
+                this->extents.Add(0, (long) ftell(this->file));
                 fseek(this->file, 0, SEEK_SET);
             }
         }
@@ -170,21 +189,46 @@ class FileReadStream {
             this->underflow.notify_all();
         }
 
-        void Add(PositionType length) {
+        void Add(long start, long end) {
             std::unique_lock<std::mutex> lock(this->mutex);
-            this->length += length;
+            this->extents.Add(start, end);
             this->underflow.notify_all();
         }
 
-        void Completed() {
+        void Completed(long length) {
             std::unique_lock<std::mutex> lock(this->mutex);
             this->maxLength = length;
+            this->underflow.notify_all();
+        }
+
+        bool Complete(long length) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            return this->extents.Complete(length);
+        }
+
+        bool Available(long offset) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            return this->extents.Available(offset);
+        }
+
+        long FirstMissing(long from) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            return this->extents.FirstMissing(from);
+        }
+
+        long NextStart(long offset, long fallback) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            return this->extents.NextStart(offset, fallback);
         }
 
         PositionType Read(void* buffer, PositionType readBytes) {
             std::unique_lock<std::mutex> lock(this->mutex);
-            while (this->Position() >= this->length && !this->Eof() && !this->interrupted) {
+            long position = this->Position();
+            long available = this->extents.AvailableEnd(position) - position;
+            while (available <= 0 && !this->Eof() && !this->interrupted) {
                 this->underflow.wait(lock);
+                position = this->Position();
+                available = this->extents.AvailableEnd(position) - position;
             }
 
             if (this->interrupted || this->Eof()) {
@@ -192,14 +236,13 @@ class FileReadStream {
             }
 
             clearerr(this->file);
-            const int available = this->length - this->Position();
-            const unsigned actualReadBytes = std::max(0, std::min(available, (int) readBytes));
-            return (PositionType) fread(buffer, 1, actualReadBytes, this->file);
+            const long actualReadBytes = std::max(0L, std::min(available, (long) readBytes));
+            return (PositionType) fread(buffer, 1, (size_t) actualReadBytes, this->file);
         }
 
         bool SetPosition(PositionType position) {
             std::unique_lock<std::mutex> lock(this->mutex);
-            while (position > this->length && !this->Eof() && !this->interrupted) {
+            while (!this->extents.Available(position) && this->maxLength <= 0 && !this->interrupted) {
                 this->underflow.wait(lock);
             }
 
@@ -217,21 +260,27 @@ class FileReadStream {
         }
 
     private:
+        void Unbuffer() {
+            if (this->file) {
+                setvbuf(this->file, nullptr, _IONBF, 0);
+            }
+        }
+
         bool Eof() {
             return this->maxLength > 0 && this->Position() >= this->maxLength;
         }
 
         FILE* file;
-        PositionType length, maxLength;
+        long maxLength;
+        ExtentMap extents;
         std::condition_variable underflow;
         std::mutex mutex;
         bool interrupted;
 };
 
 HttpDataStream::HttpDataStream() {
-    this->length = this->totalWritten = this->written = 0;
+    this->length = this->totalWritten = 0;
     this->state = State::NotStarted;
-    this->writeFile = nullptr;
     this->interrupted = false;
     this->instanceId = ++nextInstanceId;
 }
@@ -244,14 +293,14 @@ void HttpDataStream::Interrupt() {
     std::unique_lock<std::mutex> lock(this->stateMutex);
 
     auto reader = this->reader;
-    auto downloadThread = this->downloadThread;
 
     if (reader) {
         reader->Interrupt();
     }
 
-    if (downloadThread) {
+    if (this->downloadThreads.size()) {
         this->interrupted = true;
+        this->workCondition.notify_all();
     }
 }
 
@@ -267,6 +316,9 @@ bool HttpDataStream::Open(const char *rawUri, OpenFlags flags) {
     this->precacheSizeBytes = prefs->GetInt(kPreCacheBufferSizeBytesKey.c_str(), kDefaultPreCacheSizeBytes);
     this->chunkSizeBytes = prefs->GetInt(kChunkSizeBytesKey.c_str(), kDefaultChunkSizeBytes);
     this->maxCacheFiles = prefs->GetInt(kMaxCacheFiles.c_str(), kDefaultMaxCacheFiles);
+    this->maxParallelRequests = std::max(1, prefs->GetInt(kMaxParallelRequestsKey.c_str(), kDefaultMaxParallelRequests));
+    this->parallelChunkSizeBytes = std::max(0, prefs->GetInt(kParallelChunkSizeBytesKey.c_str(), kDefaultParallelChunkSizeBytes));
+    this->seekThresholdBytes = std::max(0, prefs->GetInt(kSeekThresholdBytesKey.c_str(), kDefaultSeekThresholdBytes));
 
     std::unordered_map<std::string, std::string> requestHeaders;
 
@@ -298,9 +350,11 @@ bool HttpDataStream::Open(const char *rawUri, OpenFlags flags) {
         auto const id = cacheId(httpUri);
 
         if (diskCache.Cached(id)) {
-            FILE* file = diskCache.Open(id, this->instanceId, "rb", this->type, this->length);
+            size_t length = 0;
+            FILE* file = diskCache.Open(id, this->instanceId, "rb", this->type, length);
             if (file) {
-                this->reader = std::make_shared<FileReadStream>(file, this->length);
+                this->length = length;
+                this->reader = std::make_shared<FileReadStream>(file, (long) length);
                 this->state = State::Cached;
                 return true;
             }
@@ -312,68 +366,25 @@ bool HttpDataStream::Open(const char *rawUri, OpenFlags flags) {
         this->ResetFileHandles();
     }
 
-    if (this->writeFile && this->reader) {
-        this->curlEasy = curl_easy_init();
-
-        // curl_easy_setopt (this->curlEasy, CURLOPT_VERBOSE, verbose);
-
-        curl_easy_setopt(this->curlEasy, CURLOPT_URL, this->httpUri.c_str());
-        curl_easy_setopt(this->curlEasy, CURLOPT_HEADER, 0);
-        curl_easy_setopt(this->curlEasy, CURLOPT_HTTPGET, 1);
-        curl_easy_setopt(this->curlEasy, CURLOPT_FOLLOWLOCATION, 1);
-        curl_easy_setopt(this->curlEasy, CURLOPT_AUTOREFERER, 1);
-        curl_easy_setopt(this->curlEasy, CURLOPT_FAILONERROR, 1);
-        curl_easy_setopt(this->curlEasy, CURLOPT_USERAGENT, "musikcube HttpDataStream");
-        curl_easy_setopt(this->curlEasy, CURLOPT_NOPROGRESS, 0);
-
-        curl_easy_setopt(this->curlEasy, CURLOPT_WRITEHEADER, this);
-        curl_easy_setopt(this->curlEasy, CURLOPT_HEADERFUNCTION, &HttpDataStream::CurlReadHeaderCallback);
-
-        curl_easy_setopt(this->curlEasy, CURLOPT_WRITEDATA, this);
-        curl_easy_setopt(this->curlEasy, CURLOPT_WRITEFUNCTION, &HttpDataStream::CurlWriteCallback);
-
-#if LIBCURL_VERSION_NUM < 0x072000
-        curl_easy_setopt(this->curlEasy, CURLOPT_PROGRESSDATA, this);
-        curl_easy_setopt(this->curlEasy, CURLOPT_PROGRESSFUNCTION, &HttpDataStream::LegacyCurlTransferCallback);
-#else
-        curl_easy_setopt(this->curlEasy, CURLOPT_XFERINFODATA, this);
-        curl_easy_setopt(this->curlEasy, CURLOPT_XFERINFOFUNCTION, &HttpDataStream::CurlTransferCallback);
-#endif
-
-        const int connectionTimeout = prefs->GetInt(kConnectionTimeoutSecondsKey.c_str(), kDefaultConnectionTimeoutSeconds);
-        const int readTimeout = prefs->GetInt(kReadTimeoutSecondsKey.c_str(), kDefaultReadTimeoutSeconds);
-
-        curl_easy_setopt (this->curlEasy, CURLOPT_CONNECTTIMEOUT, connectionTimeout);
-        curl_easy_setopt (this->curlEasy, CURLOPT_LOW_SPEED_TIME, readTimeout);
-        curl_easy_setopt(this->curlEasy, CURLOPT_LOW_SPEED_LIMIT, 1);
-
-        // if (useproxy == 1) {
-        //     curl_easy_setopt (this->curlEasy, CURLOPT_PROXY, proxyaddress);
-        //     if (authproxy == 1) {
-        //         curl_easy_setopt (this->curlEasy, CURLOPT_PROXYUSERPWD, proxyuserpass);
-        //     }
-        // }
-
-        curl_easy_setopt(this->curlEasy, CURLOPT_NOSIGNAL, 1);
-        curl_easy_setopt(this->curlEasy, CURLOPT_SSL_VERIFYPEER, 0);
-        curl_easy_setopt(this->curlEasy, CURLOPT_SSL_VERIFYHOST, 0);
-
-        /* append parsed headers, if any */
-        if (requestHeaders.size()) {
-            for (auto& kv : requestHeaders) {
-                auto header = kv.first + ": " + kv.second;
-                this->curlHeaders = curl_slist_append(this->curlHeaders, header.c_str());
-            }
-            curl_easy_setopt(this->curlEasy, CURLOPT_HTTPHEADER, this->curlHeaders);
+    if (this->reader) {
+        /* append parsed headers, if any. every request shares the same list. */
+        for (auto& kv : requestHeaders) {
+            auto header = kv.first + ": " + kv.second;
+            this->curlHeaders = curl_slist_append(this->curlHeaders, header.c_str());
         }
 
-        /* start downloading... */
+        /* start downloading. the first request is always a plain GET; once we
+        know the length and whether or not the server honors range requests the
+        remaining workers can help out with seeks, or parallel chunks. */
         this->state = State::Downloading;
-        downloadThread = std::make_shared<std::thread>(&HttpDataStream::ThreadProc, this);
+        for (int i = 0; i < this->maxParallelRequests; i++) {
+            this->downloadThreads.push_back(
+                std::make_shared<std::thread>(&HttpDataStream::ThreadProc, this));
+        }
 
         /* wait until we have a few hundred k of data */
         std::unique_lock<std::mutex> lock(this->stateMutex);
-        startedContition.wait(lock);
+        startedContition.wait(lock, [this] { return this->started; });
 
         return this->state != State::Error;
     }
@@ -382,98 +393,388 @@ bool HttpDataStream::Open(const char *rawUri, OpenFlags flags) {
 }
 
 void HttpDataStream::ResetFileHandles() {
-    if (this->writeFile) {
-        fclose(this->writeFile);
-        this->writeFile = nullptr;
-    }
-
     if (this->reader) {
         this->reader->Interrupt();
         this->reader.reset();
     }
 
+    /* create an empty temp file; download workers open their own handles to it
+    so they can write different regions at the same time. */
     auto const id = cacheId(httpUri);
     diskCache.Delete(id, this->instanceId);
-    this->writeFile = diskCache.Open(id, this->instanceId, "wb");
-    if (this->writeFile) {
+    FILE* file = diskCache.Open(id, this->instanceId, "wb");
+    if (file) {
+        fclose(file);
         this->reader = std::make_shared<FileReadStream>(this->httpUri, this->instanceId);
     }
 }
 
-void HttpDataStream::ThreadProc() {
-    if (this->curlEasy) {
-        static const int kMaxRetries = 10;
-        int retryCount = 0; /* note: weighted based on failure type */
-        while (this->state != State::Downloaded && !this->interrupted) {
-            auto const curlCode = curl_easy_perform(this->curlEasy);
-            long httpStatusCode = 0;
-            curl_easy_getinfo(this->curlEasy, CURLINFO_RESPONSE_CODE, &httpStatusCode);
-            if (httpStatusCode == 200) {
-                this->state = curlCode != CURLE_OK
-                    ? State::Aborted
-                    : State::Downloaded;
-
-                if (this->reader) {
-                    if (this->written > 0) {
-                        this->reader->Add(this->written);
-                        this->written = 0;
-                    }
-                    this->reader->Completed();
-                }
+CURL* HttpDataStream::CreateCurlHandle(Transfer* transfer) {
+    CURL* curl = curl_easy_init();
+
+    if (!curl) {
+        return nullptr;
+    }
+
+    // curl_easy_setopt (curl, CURLOPT_VERBOSE, verbose);
+
+    curl_easy_setopt(curl, CURLOPT_URL, this->httpUri.c_str());
+    curl_easy_setopt(curl, CURLOPT_HEADER, 0);
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
+    curl_easy_setopt(curl, CURLOPT_AUTOREFERER, 1);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, "musikcube HttpDataStream");
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0);
+
+    curl_easy_setopt(curl, CURLOPT_WRITEHEADER, transfer);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, &HttpDataStream::CurlReadHeaderCallback);
+
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, transfer);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &HttpDataStream::CurlWriteCallback);
+
+#if LIBCURL_VERSION_NUM < 0x072000
+    curl_easy_setopt(curl, CURLOPT_PROGRESSDATA, transfer);
+    curl_easy_setopt(curl, CURLOPT_PROGRESSFUNCTION, &HttpDataStream::LegacyCurlTransferCallback);
+#else
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, transfer);
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, &HttpDataStream::CurlTransferCallback);
+#endif
+
+    const int connectionTimeout = prefs->GetInt(kConnectionTimeoutSecondsKey.c_str(), kDefaultConnectionTimeoutSeconds);
+    const int readTimeout = prefs->GetInt(kReadTimeoutSecondsKey.c_str(), kDefaultReadTimeoutSeconds);
+
+    curl_easy_setopt (curl, CURLOPT_CONNECTTIMEOUT, connectionTimeout);
+    curl_easy_setopt (curl, CURLOPT_LOW_SPEED_TIME, readTimeout);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1);
+
+    // if (useproxy == 1) {
+    //     curl_easy_setopt (curl, CURLOPT_PROXY, proxyaddress);
+    //     if (authproxy == 1) {
+    //         curl_easy_setopt (curl, CURLOPT_PROXYUSERPWD, proxyuserpass);
+    //     }
+    // }
+
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0);
+
+    if (this->curlHeaders) {
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, this->curlHeaders);
+    }
+
+    if (transfer->ranged) {
+        std::string range = std::to_string(transfer->start) + "-";
+        const long end = transfer->end;
+        if (end > transfer->start) {
+            range += std::to_string(end - 1);
+        }
+        curl_easy_setopt(curl, CURLOPT_RANGE, range.c_str());
+    }
+
+    return curl;
+}
+
+bool HttpDataStream::ClaimRange(TransferPtr transfer) {
+    if (this->state == State::Downloaded || this->state == State::Error || !this->reader) {
+        return false;
+    }
+
+    const long total = (long) this->length;
+
+    if (!this->rangesSupported || total <= 0) {
+        /* until we know the server honors range requests we can only fetch the
+        file front-to-back with a single request. */
+        if (this->transfers.size()) {
+            return false;
+        }
+        transfer->start = transfer->cursor = 0;
+        transfer->end = -1;
+        transfer->ranged = false;
+        return true;
+    }
+
+    /* returns the end of the in-flight request responsible for `offset`, or
+    -1 if nobody is fetching it. */
+    auto inFlightEnd = [this, total](long offset) -> long {
+        for (auto& t : this->transfers) {
+            const long end = t->end < 0 ? total : (long) t->end;
+            if (offset >= t->start && offset < end) {
+                return end;
             }
-            else {
-                if (httpStatusCode == 429) { /* too many requests */
-                     this->state = State::Retrying;
-                    retryCount += 1;
-                    sleepMs(5000);
-                }
-                else if ((httpStatusCode < 400 || httpStatusCode >= 500) && retryCount < kMaxRetries) {
-                    {
-                        std::unique_lock<std::mutex> lock(this->stateMutex);
-                        this->ResetFileHandles();
-                    }
-                    this->state = State::Retrying;
-                    retryCount += 2;
-                    sleepMs(2000);
-                }
-                else {
-                    this->state = State::Error;
-                    this->interrupted = true;
+        }
+        return -1;
+    };
+
+    auto firstUnclaimed = [this, total, &inFlightEnd](long from) -> long {
+        long offset = this->reader->FirstMissing(from);
+        long end = inFlightEnd(offset);
+        while (offset < total && end >= 0) {
+            offset = this->reader->FirstMissing(end);
+            end = inFlightEnd(offset);
+        }
+        return offset;
+    };
+
+    /* prefer whatever is just past the most recent seek, then go back and
+    fill in any holes we skipped over. */
+    long start = firstUnclaimed(this->focus);
+    if (start >= total) {
+        start = firstUnclaimed(0);
+    }
+    if (start >= total) {
+        return false;
+    }
+
+    long end = this->reader->NextStart(start, total);
+    for (auto& t : this->transfers) {
+        if (t->start > start) {
+            end = std::min(end, t->start);
+        }
+    }
+
+    if (this->parallelChunkSizeBytes > 0) {
+        end = std::min(end, start + this->parallelChunkSizeBytes);
+    }
+
+    transfer->start = transfer->cursor = start;
+    transfer->end = end;
+    transfer->ranged = true;
+    return true;
+}
+
+void HttpDataStream::RequestRange(PositionType position) {
+    std::unique_lock<std::mutex> lock(this->stateMutex);
+
+    const long total = (long) this->length;
+    auto reader = this->reader;
+
+    if (!reader || !this->rangesSupported || position < 0 || position >= total) {
+        return;
+    }
+
+    if (this->state != State::Downloading && this->state != State::Retrying) {
+        return;
+    }
+
+    if (reader->Available(position)) {
+        return;
+    }
+
+    this->focus = position;
+
+    /* if there's already a request headed this way, and it's close, just let
+    it get there on its own. */
+    TransferPtr owner;
+    for (auto& t : this->transfers) {
+        const long end = t->end < 0 ? total : (long) t->end;
+        if (position >= t->cursor && position < end) {
+            if (position - t->cursor <= this->seekThresholdBytes) {
+                return;
+            }
+            owner = t;
+        }
+    }
+
+    /* stop the existing request where the seek lands so a worker can pick up
+    from there with a ranged request. */
+    if (owner) {
+        owner->end = position;
+    }
+
+    /* every worker is busy; give up the request furthest from where we need
+    data. the region it was fetching will be claimed again later. */
+    if ((int) this->transfers.size() >= this->maxParallelRequests) {
+        TransferPtr victim = owner;
+        if (!victim) {
+            long distance = -1;
+            for (auto& t : this->transfers) {
+                const long d = std::abs(t->cursor - position);
+                if (d > distance) {
+                    distance = d;
+                    victim = t;
                 }
             }
         }
+        if (victim) {
+            victim->canceled = true;
+        }
+    }
+
+    this->workCondition.notify_all();
+}
+
+void HttpDataStream::ReportProgress(Transfer* transfer) {
+    if (transfer->unreported > 0) {
+        auto reader = this->reader;
+        if (reader) {
+            const long end = transfer->cursor;
+            reader->Add(end - transfer->unreported, end);
+        }
+        transfer->unreported = 0;
+    }
+}
+
+bool HttpDataStream::Completed(Transfer* transfer, CURLcode curlCode) {
+    const long total = (long) this->length;
+
+    /* a plain GET that ran to completion has, by definition, everything. this
+    is also the only way we know we're done if the server didn't tell us the
+    length up front. */
+    if (!transfer->ranged && curlCode == CURLE_OK) {
+        if (total <= 0) {
+            this->length = (size_t) transfer->cursor;
+        }
+        this->reader->Completed(transfer->cursor);
+        return true;
+    }
+
+    if (this->reader->Complete(total)) {
+        this->reader->Completed(total);
+        return true;
+    }
+
+    return false;
+}
+
+void HttpDataStream::ThreadProc() {
+    static const int kMaxRetries = 10;
+    int retryCount = 0; /* note: weighted based on failure type */
 
-        startedContition.notify_all(); /* in case the header write function was never called */
+    auto finished = [this] {
+        return this->interrupted || this->state == State::Downloaded || this->state == State::Error;
+    };
 
-        if (this->curlEasy) {
-            curl_easy_cleanup(this->curlEasy);
-            this->curlEasy = nullptr;
+    while (!finished()) {
+        auto transfer = std::make_shared<Transfer>();
+        transfer->stream = this;
+
+        {
+            std::unique_lock<std::mutex> lock(this->stateMutex);
+            while (!finished() && !this->ClaimRange(transfer)) {
+                this->workCondition.wait(lock);
+            }
+            if (finished()) {
+                break;
+            }
+            if (this->state == State::Retrying) {
+                this->state = State::Downloading;
+            }
+            this->transfers.push_back(transfer);
         }
 
-        if (this->curlHeaders) {
-            curl_slist_free_all(this->curlHeaders);
-            this->curlHeaders = nullptr;
+        CURLcode curlCode = CURLE_FAILED_INIT;
+        long httpStatusCode = 0;
+
+        transfer->file = diskCache.Open(cacheId(this->httpUri), this->instanceId, "r+b");
+        const bool opened = transfer->file != nullptr;
+        transfer->curl = transfer->file ? this->CreateCurlHandle(transfer.get()) : nullptr;
+
+        if (transfer->curl) {
+            fseek(transfer->file, transfer->start, SEEK_SET);
+            curlCode = curl_easy_perform(transfer->curl);
+            curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &httpStatusCode);
+            curl_easy_cleanup(transfer->curl);
+            transfer->curl = nullptr;
         }
 
-        if (this->writeFile) {
-            fclose(this->writeFile);
-            this->writeFile = nullptr;
+        if (transfer->file) {
+            this->ReportProgress(transfer.get());
+            fclose(transfer->file);
+            transfer->file = nullptr;
         }
+
+        int backoffMs = 0;
+
+        {
+            std::unique_lock<std::mutex> lock(this->stateMutex);
+
+            auto& t = this->transfers;
+            t.erase(std::remove(t.begin(), t.end(), transfer), t.end());
+
+            if (httpStatusCode == 200 || httpStatusCode == 206) {
+                if (this->Completed(transfer.get(), curlCode)) {
+                    this->state = State::Downloaded;
+                }
+                else if (curlCode != CURLE_OK &&
+                    transfer->cursor == transfer->start &&
+                    !transfer->canceled &&
+                    !this->interrupted)
+                {
+                    /* the request died before it got anywhere. */
+                    if (retryCount < kMaxRetries) {
+                        this->state = State::Retrying;
+                        retryCount += 2;
+                        backoffMs = 2000;
+                    }
+                    else {
+                        this->state = State::Error;
+                        this->interrupted = true;
+                    }
+                }
+            }
+            else if (!opened) {
+                this->state = State::Error; /* couldn't open the temp file */
+                this->interrupted = true;
+            }
+            else if (httpStatusCode == 416 && transfer->ranged) {
+                /* range not satisfiable. fall back to a sequential download. */
+                this->rangesSupported = false;
+                this->rangesRejected = true;
+            }
+            else if (httpStatusCode == 429) { /* too many requests */
+                this->state = State::Retrying;
+                retryCount += 1;
+                backoffMs = 5000;
+            }
+            else if ((httpStatusCode < 400 || httpStatusCode >= 500) && retryCount < kMaxRetries) {
+                this->state = State::Retrying;
+                retryCount += 2;
+                backoffMs = 2000;
+            }
+            else {
+                this->state = State::Error;
+                this->interrupted = true;
+            }
+
+            this->workCondition.notify_all();
+        }
+
+        if (backoffMs > 0) {
+            sleepMs(backoffMs);
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(this->stateMutex);
+        this->started = true;
+        this->workCondition.notify_all();
     }
+
+    startedContition.notify_all(); /* in case the header write function was never called */
 }
 
 bool HttpDataStream::Close() {
     this->Interrupt();
 
-    /* wait for the download thread to stop, this will ensure file writes have
+    /* wait for the download threads to stop, this will ensure file writes have
     completed. */
-    auto thread = this->downloadThread;
-    this->downloadThread.reset();
+    std::vector<std::shared_ptr<std::thread>> threads;
+
+    {
+        std::unique_lock<std::mutex> lock(this->stateMutex);
+        threads.swap(this->downloadThreads);
+    }
 
-    if (thread) {
+    for (auto& thread : threads) {
         thread->join();
     }
 
+    if (this->curlHeaders) {
+        curl_slist_free_all(this->curlHeaders);
+        this->curlHeaders = nullptr;
+    }
+
     /* need to close the reader so we can perform the filesystem operations below */
     this->reader.reset();
 
@@ -502,7 +803,16 @@ PositionType HttpDataStream::Read(void* buffer, PositionType readBytes) {
 
 bool HttpDataStream::SetPosition(PositionType position) {
     auto reader = this->reader;
-    return reader ? reader->SetPosition(position) : 0;
+
+    if (!reader) {
+        return false;
+    }
+
+    /* if the data isn't here yet and isn't coming soon, go get it directly
+    instead of waiting for the sequential download to catch up. */
+    this->RequestRange(position);
+
+    return reader->SetPosition(position);
 }
 
 bool HttpDataStream::Seekable() {
@@ -532,40 +842,107 @@ const char* HttpDataStream::Uri() {
 }
 
 size_t HttpDataStream::CurlWriteCallback(char *ptr, size_t size, size_t nmemb, void *userdata) {
-    HttpDataStream* stream = static_cast<HttpDataStream*>(userdata);
+    Transfer* transfer = static_cast<Transfer*>(userdata);
+    HttpDataStream* stream = transfer->stream;
 
     const size_t total = size * nmemb;
-    const size_t result = fwrite(ptr, size, nmemb, stream->writeFile);
-    fflush(stream->writeFile); /* normally we wouldn't want to do this, but it ensures
+
+    /* the first time we see the body we know all the headers have arrived. */
+    if (!transfer->validated) {
+        transfer->validated = true;
+
+        long httpStatusCode = 0;
+        curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &httpStatusCode);
+
+        std::unique_lock<std::mutex> lock(stream->stateMutex);
+
+        if (transfer->ranged) {
+            if (httpStatusCode != 206) {
+                /* the server ignored the Range header and is sending the whole
+                file; drop it and go back to fetching sequentially. */
+                stream->rangesSupported = false;
+                stream->rangesRejected = true;
+                transfer->canceled = true;
+                stream->workCondition.notify_all();
+                return 0;
+            }
+        }
+        else {
+            stream->rangesSupported =
+                transfer->acceptRanges && !stream->rangesRejected && stream->length > 0;
+
+            /* when fetching in parallel, the initial request only keeps the
+            first chunk; idle workers will claim the rest. */
+            if (stream->rangesSupported && stream->parallelChunkSizeBytes > 0) {
+                transfer->end = std::min(
+                    (long) stream->length, (long) stream->parallelChunkSizeBytes);
+            }
+
+            stream->workCondition.notify_all();
+        }
+    }
+
+    if (transfer->canceled) {
+        return 0;
+    }
+
+    /* don't write past where we were told to stop; another request may be
+    responsible for what comes next. */
+    long writable = (long) total;
+    const long end = transfer->end;
+    if (end >= 0) {
+        writable = std::min(writable, end - transfer->cursor);
+    }
+
+    if (writable <= 0) {
+        return 0;
+    }
+
+    const size_t result = fwrite(ptr, 1, (size_t) writable, transfer->file);
+    fflush(transfer->file); /* normally we wouldn't want to do this, but it ensures
      data written is available immediately to any simultaneous readers */
-    stream->written += result;
+    transfer->cursor += (long) result;
+    transfer->unreported += (long) result;
 
-    if (stream->written >= stream->chunkSizeBytes) {
-        stream->reader->Add(stream->written);
-        stream->written = 0;
+    if (transfer->unreported >= stream->chunkSizeBytes) {
+        stream->ReportProgress(transfer);
     }
 
     if (stream->totalWritten > -1) {
-        stream->totalWritten += result;
+        stream->totalWritten += (long) result;
         if (stream->totalWritten >= stream->precacheSizeBytes) {
+            {
+                std::unique_lock<std::mutex> lock(stream->stateMutex);
+                stream->started = true;
+            }
             stream->startedContition.notify_all();
             stream->totalWritten = -1;
         }
     }
 
-    return result;
+    /* returning a short count aborts the request, which is what we want if
+    we've been truncated. */
+    return (result == total) ? total : 0;
 }
 
 size_t HttpDataStream::CurlReadHeaderCallback(char *buffer, size_t size, size_t nitems, void *userdata) {
-    HttpDataStream* stream = static_cast<HttpDataStream*>(userdata);
+    Transfer* transfer = static_cast<Transfer*>(userdata);
+    HttpDataStream* stream = transfer->stream;
 
     std::string header(buffer, size * nitems);
 
     std::string key, value;
     if (parseHeader(header, key, value)) {
-        if (key == "Content-Length") {
+        if (transfer->ranged) {
+            /* Content-Length describes the range, not the file. we already know
+            everything else we care about. */
+        }
+        else if (key == "Content-Length") {
             stream->length = std::atoi(value.c_str());
         }
+        else if (key == "Accept-Ranges") {
+            transfer->acceptRanges = (value == "bytes");
+        }
         else if (key == "Content-Type") {
             if (!stream->type.size()) {
                 stream->type = value;
@@ -579,8 +956,8 @@ size_t HttpDataStream::CurlReadHeaderCallback(char *buffer, size_t size, size_t
 int HttpDataStream::CurlTransferCallback(
     void *ptr, curl_off_t downTotal, curl_off_t downNow, curl_off_t upTotal, curl_off_t upNow)
 {
-    HttpDataStream* stream = static_cast<HttpDataStream*>(ptr);
-    if (stream->interrupted) {
+    Transfer* transfer = static_cast<Transfer*>(ptr);
+    if (transfer->stream->interrupted || transfer->canceled) {
         return -1; /* kill the stream */
     }
     return 0; /* ok! */
@@ -41,6 +41,7 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <vector>
 
 using namespace musik::core::sdk;
 
@@ -84,8 +85,32 @@ class HttpDataStream : public IDataStream {
             Error,
         };
 
+        /* a single in-flight http request. each download worker owns one at a
+        time; `end` is exclusive, and may be pulled in by a seek on another
+        thread so the request stops short of data someone else will fetch. */
+        struct Transfer {
+            HttpDataStream* stream{ nullptr };
+            CURL* curl{ nullptr };
+            FILE* file{ nullptr };
+            long start{ 0 };
+            long unreported{ 0 };
+            std::atomic<long> cursor{ 0 };
+            std::atomic<long> end{ -1 };
+            std::atomic<bool> canceled{ false };
+            bool ranged{ false };
+            bool validated{ false };
+            bool acceptRanges{ false };
+        };
+
+        using TransferPtr = std::shared_ptr<Transfer>;
+
         void ThreadProc();
         void ResetFileHandles();
+        bool ClaimRange(TransferPtr transfer);
+        void RequestRange(PositionType position);
+        void ReportProgress(Transfer* transfer);
+        bool Completed(Transfer* transfer, CURLcode curlCode);
+        CURL* CreateCurlHandle(Transfer* transfer);
 
         static size_t CurlWriteCallback(char *ptr, size_t size, size_t nmemb, void *userdata);
         static size_t CurlReadHeaderCallback(char *buffer, size_t size, size_t nitems, void *userdata);
@@ -96,20 +121,23 @@ class HttpDataStream : public IDataStream {
         #endif
 
         std::string originalUri, httpUri, type;
-        size_t length;
+        std::atomic<size_t> length;
         std::string filename;
-        FILE* writeFile;
-        CURL* curlEasy;
         curl_slist *curlHeaders{ nullptr };
 
-        std::atomic<long> written, totalWritten;
+        std::atomic<long> totalWritten;
         std::atomic<bool> interrupted;
         std::atomic<State> state;
 
         std::mutex stateMutex;
-        std::condition_variable startedContition;
-        std::shared_ptr<std::thread> downloadThread;
+        std::condition_variable startedContition, workCondition;
+        bool started{ false };
+        bool rangesSupported{ false }, rangesRejected{ false };
+        long focus{ 0 };
+        std::vector<TransferPtr> transfers;
+        std::vector<std::shared_ptr<std::thread>> downloadThreads;
         std::shared_ptr<FileReadStream> reader;
         int precacheSizeBytes, chunkSizeBytes, maxCacheFiles;
+        int maxParallelRequests, parallelChunkSizeBytes, seekThresholdBytes;
         int64_t instanceId;
-};
\ No newline at end of file
+};
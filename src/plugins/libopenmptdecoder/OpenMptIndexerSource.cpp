@@ -82,20 +82,13 @@ ScanResult OpenMptIndexerSource::Scan(
     const char** indexerPaths,
     unsigned indexerPathsCount)
 {
-    /* keep these for later, for the removal phase */
-    for (size_t i = 0; i < indexerPathsCount; i++) {
-        this->paths.insert(fs::canonicalizePath(std::string(indexerPaths[i])));
-    }
+    /* hosts that support IIndexerFileSource walk the filesystem for us; older
+    ones call this, and we do it ourselves. */
+    this->BeginFileScan(indexer, indexerPaths, indexerPathsCount);
 
     auto checkFile = [this, indexer](const std::string& path) {
         if (isFileSupported(path)) {
-            try {
-                this->UpdateMetadata(path, this, indexer);
-            }
-            catch (...) {
-                std::string error = str::Format("error reading metadata for %s", path.c_str());
-                debug->Error(PLUGIN_NAME.c_str(), error.c_str());
-            }
+            this->IndexFile(indexer, path.c_str());
         }
     };
 
@@ -109,11 +102,52 @@ ScanResult OpenMptIndexerSource::Scan(
         }
     }
 
-    indexer->CommitProgress(this, this->filesIndexed);
+    this->EndFileScan(indexer);
 
     return ScanCommit;
 }
 
+void OpenMptIndexerSource::BeginFileScan(
+    IIndexerWriter* indexer,
+    const char** indexerPaths,
+    unsigned indexerPathsCount)
+{
+    /* keep these for later, for the removal phase */
+    for (size_t i = 0; i < indexerPathsCount; i++) {
+        this->paths.insert(fs::canonicalizePath(std::string(indexerPaths[i])));
+    }
+}
+
+bool OpenMptIndexerSource::CanIndexFile(const char* extension) {
+    return extension && isFileTypeSupported(extension);
+}
+
+void OpenMptIndexerSource::IndexFile(IIndexerWriter* indexer, const char* path) {
+    if (this->interrupt) {
+        return;
+    }
+
+    try {
+        this->UpdateMetadata(path, this, indexer);
+    }
+    catch (...) {
+        std::string error = str::Format("error reading metadata for %s", path);
+        debug->Error(PLUGIN_NAME.c_str(), error.c_str());
+    }
+}
+
+void OpenMptIndexerSource::EndFileScan(IIndexerWriter* indexer) {
+    size_t progress = 0;
+
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        progress = this->filesIndexed + this->tracksIndexed;
+        this->filesIndexed = this->tracksIndexed = 0;
+    }
+
+    indexer->CommitProgress(this, (unsigned) progress);
+}
+
 void OpenMptIndexerSource::Interrupt() {
     this->interrupt = true;
 }
@@ -130,7 +164,13 @@ void OpenMptIndexerSource::ScanTrack(
 
         /* if the file doesn't exist anymore, or it was flagged as invalid,
         we remove it */
-        if (!fs::fileExists(fn) || invalidFiles.find(fn) != invalidFiles.end()) {
+        bool invalid = false;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            invalid = invalidFiles.find(fn) != invalidFiles.end();
+        }
+
+        if (invalid || !fs::fileExists(fn)) {
             indexer->RemoveByExternalId(this, externalId);
             return;
         }
@@ -169,6 +209,8 @@ void OpenMptIndexerSource::UpdateMetadata(
     IIndexerSource* source,
     IIndexerWriter* indexer)
 {
+    size_t tracks = 0;
+
     /* only need to do this check once, and it's relatively expensive because
     it requires a db read. cache we've already done it. */
     int64_t modifiedTime = fs::getLastModifiedTime(fn);
@@ -185,6 +227,7 @@ void OpenMptIndexerSource::UpdateMetadata(
 
             if (!module) {
                 debug->Error(PLUGIN_NAME.c_str(), str::Format("error opening %s", fn.c_str()).c_str());
+                std::unique_lock<std::mutex> lock(this->mutex);
                 invalidFiles.insert(fn);
             }
             else {
@@ -237,7 +280,7 @@ void OpenMptIndexerSource::UpdateMetadata(
 
                         indexer->Save(source, track, externalId.c_str());
                         track->Release();
-                        ++tracksIndexed;
+                        ++tracks;
                     }
                 }
 
@@ -250,8 +293,18 @@ void OpenMptIndexerSource::UpdateMetadata(
     }
 
     /* we commit progress every so often */
-    if (++this->filesIndexed % 300 == 0) {
-        indexer->CommitProgress(this, this->filesIndexed + this->tracksIndexed);
-        this->filesIndexed = this->tracksIndexed = 0;
+    size_t progress = 0;
+
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->tracksIndexed += tracks;
+        if (++this->filesIndexed % 300 == 0) {
+            progress = this->filesIndexed + this->tracksIndexed;
+            this->filesIndexed = this->tracksIndexed = 0;
+        }
+    }
+
+    if (progress) {
+        indexer->CommitProgress(this, (unsigned) progress);
     }
 }
@@ -35,13 +35,14 @@
 
 #pragma once
 
-#include <musikcore/sdk/IIndexerSource.h>
+#include <musikcore/sdk/IIndexerFileSource.h>
 #include <functional>
 #include <set>
 #include <map>
 #include <atomic>
+#include <mutex>
 
-class OpenMptIndexerSource: public musik::core::sdk::IIndexerSource {
+class OpenMptIndexerSource: public musik::core::sdk::IIndexerFileSource {
     public:
         OpenMptIndexerSource();
         ~OpenMptIndexerSource();
@@ -68,12 +69,27 @@ class OpenMptIndexerSource: public musik::core::sdk::IIndexerSource {
 
         virtual bool HasStableIds() { return true; }
 
+        /* IIndexerFileSource */
+        virtual void BeginFileScan(
+            musik::core::sdk::IIndexerWriter* indexer,
+            const char** indexerPaths,
+            unsigned indexerPathsCount);
+
+        virtual bool CanIndexFile(const char* extension);
+
+        virtual void IndexFile(
+            musik::core::sdk::IIndexerWriter* indexer,
+            const char* path);
+
+        virtual void EndFileScan(musik::core::sdk::IIndexerWriter* indexer);
+
     private:
         void UpdateMetadata(
             std::string fn,
             musik::core::sdk::IIndexerSource* source,
             musik::core::sdk::IIndexerWriter* indexer);
 
+        std::mutex mutex; /* IndexFile() may be called from multiple threads */
         std::set<std::string> invalidFiles;
         std::set<std::string> paths;
         size_t filesIndexed, tracksIndexed;
@@ -76,7 +76,7 @@ extern "C" musik::core::sdk::ISchema* GetSchema() {
         DEFAULT_OUTPUT_BUFFER_SIZE_IN_SAMPLES,
         DEFAULT_OUTPUT_BUFFER_SIZE_IN_SAMPLES / 8,
         DEFAULT_OUTPUT_BUFFER_SIZE_IN_SAMPLES * 16);
-    schema->AddInt(PREF_OUTPUT_BUFFER_COUNT, DEFAULT_OUTPUT_BUFFER_COUNT, 8, 64);
+    schema->AddInt(PREF_OUTPUT_BUFFER_COUNT, DEFAULT_OUTPUT_BUFFER_COUNT, 8, (int) PipeWireOut::MAX_OUTPUT_BUFFER_COUNT);
     return schema;
 }
 
@@ -130,52 +130,121 @@ void PipeWireOut::OnDrained(void* data) {
     self->drainCondition.notify_all();
 }
 
+/* runs on pipewire's realtime data thread (PW_STREAM_FLAG_RT_PROCESS), outside
+the thread loop lock, and must never block: no locks, no allocations, no calls
+back into the player. finished input buffers are handed off through
+`processedQueue` and returned to their providers by OnBuffersProcessed().
+
+other threads that need to touch the consumer side of the queues can't take
+a lock we'd wait on, so they set `processSuspended` and wait for `processing`
+to clear instead; see SuspendProcessing(). */
 void PipeWireOut::OnStreamProcess(void* data) {
     PipeWireOut* self = static_cast<PipeWireOut*>(data);
 
-    {
-        std::unique_lock<std::recursive_mutex> lock(self->mutex);
+    self->processing = true;
+    if (!self->processSuspended && self->state == State::Playing) {
+        PipeWireOut::Process(self);
+    }
+    self->processing = false;
+}
 
-        if (self->state != State::Playing) {
+void PipeWireOut::Process(PipeWireOut* self) {
+    OutBufferContext& outContext = self->outBufferContext;
+
+    if (!outContext.Valid()) {
+        outContext.Initialize(pw_stream_dequeue_buffer(self->pwStream));
+        if (!outContext.Valid()) {
+            ++self->outputBufferMisses; /* no more output buffers available to fill */
             return;
         }
+    }
 
-        OutBufferContext& outContext = self->outBufferContext;
+    InBufferContext& inContext = self->currentBuffer;
+    bool processed = false;
 
-        if (!outContext.Valid()) {
-            outContext.Initialize(pw_stream_dequeue_buffer(self->pwStream));
-            if (!outContext.Valid()) {
-                // std::cerr << "[PipeWire] no more output buffers available to fill\n";
-                return;
-            }
+    while (outContext.remaining > 0) {
+        if (!inContext.Valid() && !self->inputQueue.Pop(inContext)) {
+            break;
         }
 
-        uint32_t channelCount;
+        self->fed = true;
 
-        while (outContext.remaining > 0 && !self->buffers.empty()) {
-            //std::cerr << "[PipeWire] " << outContext.remaining << " bytes still need to be filled...\n";
+        uint32_t bytesToCopy = std::min(outContext.remaining, inContext.remaining);
+        memcpy(outContext.writePtr, inContext.readPtr, bytesToCopy);
+        inContext.Advance(bytesToCopy);
+        outContext.Advance(bytesToCopy);
 
-            InBufferContext* inContext = self->buffers.front();
-            channelCount = (uint32_t) inContext->buffer->Channels();
-            uint32_t inBufferSize = (uint32_t) inContext->buffer->Bytes();
-            uint32_t bytesToCopy = std::min(outContext.remaining, inContext->remaining);
+        if (inContext.remaining == 0) {
+            self->processedQueue.Push(inContext);
+            inContext = InBufferContext();
+            processed = true;
+        }
+    }
 
-            if (outContext.remaining >= inContext->remaining) {
-                self->buffers.pop_front();
-                self->bufferCondition.notify_all();
-            }
+    if (outContext.remaining == 0) {
+        outContext.Finalize(self->pwStream, SAMPLE_SIZE_BYTES * (uint32_t) self->channelCount);
+    }
+    else if (self->fed) {
+        /* we ran dry, either part way through a buffer or before we could put
+        anything in it at all: the player didn't keep up. we'll finish filling
+        it next time around. cycles before the first buffer arrives (or after
+        a drain) are expected to be empty, and aren't counted. */
+        ++self->underruns;
+    }
 
-            memcpy(outContext.writePtr, inContext->readPtr, bytesToCopy);
-            inContext->Advance(bytesToCopy); /* will `delete this` if emptied */
-            outContext.Advance(bytesToCopy);
-        }
+    /* sample the stream's timing while we're here; Latency() is called from
+    other threads, and this is the one place it's always safe to ask. */
+    pw_time time;
+    spa_zero(time);
+    if (pw_stream_get_time(self->pwStream, &time) == 0 && time.rate.denom > 0 && self->sampleRate > 0) {
+        const double bytesPerSecond = (double) (SAMPLE_SIZE_BYTES * self->channelCount * self->sampleRate);
+        self->latency =
+            ((double) time.delay * time.rate.num / time.rate.denom) +
+            ((double) time.queued / bytesPerSecond);
+    }
 
-        if (outContext.remaining == 0) {
-            outContext.Finalize(self->pwStream, SAMPLE_SIZE_BYTES * channelCount);
-        }
+    if (processed) {
+        pw_loop_signal_event(pw_thread_loop_get_loop(self->pwThreadLoop), self->processedEvent);
+    }
+}
+
+/* runs on the thread loop (with the loop lock held), not the realtime path. */
+void PipeWireOut::OnBuffersProcessed(void* data, uint64_t count) {
+    PipeWireOut* self = static_cast<PipeWireOut*>(data);
+    self->ReleaseProcessedBuffers();
+}
+
+void PipeWireOut::ReleaseProcessedBuffers() {
+    InBufferContext context;
+    bool released = false;
+    while (this->processedQueue.Pop(context)) {
+        context.provider->OnBufferProcessed(context.buffer);
+        --this->queued;
+        released = true;
+    }
+    if (released) {
+        this->bufferCondition.notify_all();
     }
 }
 
+void PipeWireOut::SuspendProcessing() {
+    this->processSuspended = true;
+    while (this->processing) {
+        std::this_thread::yield(); /* at most one process cycle */
+    }
+}
+
+void PipeWireOut::ResumeProcessing() {
+    this->processSuspended = false;
+}
+
+void PipeWireOut::LogStats() {
+    ::debug->Info(TAG, str::Format(
+        "stream stats: underruns=%llu, output buffer misses=%llu",
+        (unsigned long long) this->underruns.load(),
+        (unsigned long long) this->outputBufferMisses.load()).c_str());
+}
+
 PipeWireOut::PipeWireOut() {
     this->pwStreamEvents = { PW_VERSION_STREAM_EVENTS };
     this->pwStreamEvents.state_changed = PipeWireOut::OnStreamStateChanged;
@@ -258,24 +327,50 @@ void PipeWireOut::Stop() {
 
 void PipeWireOut::DiscardInputBuffers() {
     std::unique_lock<std::recursive_mutex> lock(this->mutex);
-    for (auto& buffer : this->buffers) {
-        buffer->Discard();
+
+    /* OnStreamProcess() is the input queue's consumer (and the processed
+    queue's producer); suspending it makes us the only one for a moment. the
+    thread loop lock keeps OnBuffersProcessed() out of the processed queue. */
+    if (this->pwThreadLoop) {
+        pw_thread_loop_lock(this->pwThreadLoop);
+    }
+    this->SuspendProcessing();
+    this->fed = false;
+
+    InBufferContext context;
+    if (this->currentBuffer.Valid()) {
+        this->processedQueue.Push(this->currentBuffer);
+        this->currentBuffer = InBufferContext();
     }
-    this->buffers.clear();
+    while (this->inputQueue.Pop(context)) {
+        this->processedQueue.Push(context);
+    }
+
+    this->ResumeProcessing();
+    this->ReleaseProcessedBuffers();
+
+    if (this->pwThreadLoop) {
+        pw_thread_loop_unlock(this->pwThreadLoop);
+    }
+
     this->bufferCondition.notify_all();
 }
 
 void PipeWireOut::Drain() {
     std::unique_lock<std::recursive_mutex> lock(this->mutex);
-    while (this->buffers.size()) {
-        bufferCondition.wait(lock);
+    while (this->queued > 0) {
+        /* woken by ReleaseProcessedBuffers(); the timeout just guards against
+        a missed notification, as it doesn't hold our lock. */
+        bufferCondition.wait_for(lock, std::chrono::milliseconds(20));
     }
     if (this->pwThreadLoop && this->pwStream) {
         pw_thread_loop_lock(this->pwThreadLoop);
+        this->fed = false; /* the stream is expected to run dry from here */
         pw_stream_flush(this->pwStream, true);
         pw_thread_loop_unlock(this->pwThreadLoop);
         drainCondition.wait_for(lock, std::chrono::milliseconds(10000));
     }
+    this->LogStats();
 }
 
 IDeviceList* PipeWireOut::GetDeviceList() {
@@ -310,6 +405,18 @@ void PipeWireOut::StopPipeWire() {
     if (this->pwThreadLoop) {
         pw_thread_loop_stop(this->pwThreadLoop);
 
+        /* the data thread isn't part of the thread loop, so it may still be
+        in the middle of a cycle, and about to signal `processedEvent`. wait
+        for it before tearing anything down. */
+        this->SuspendProcessing();
+
+        /* nothing else can be consuming the queues now */
+        this->ReleaseProcessedBuffers();
+        if (this->processedEvent) {
+            pw_loop_destroy_source(pw_thread_loop_get_loop(this->pwThreadLoop), this->processedEvent);
+            this->processedEvent = nullptr;
+        }
+
         if (this->pwStream) {
             this->outBufferContext.Finalize(
                 this->pwStream,
@@ -318,14 +425,21 @@ void PipeWireOut::StopPipeWire() {
             this->pwStream = nullptr;
         }
 
+        this->ResumeProcessing();
+
         pw_thread_loop_destroy(this->pwThreadLoop);
         this->pwThreadLoop = nullptr;
     }
 
+    /* anything Play() queued while we were shutting down */
+    this->DiscardInputBuffers();
+
     this->initialized = false;
     this->channelCount = 0;
     this->sampleRate = 0;
+    this->latency = 0.0;
 
+    this->LogStats();
     ::debug->Info(TAG, "shutdown complete");
 }
 
@@ -343,6 +457,11 @@ bool PipeWireOut::StartPipeWire(IBuffer* buffer) {
 
         pw_thread_loop_lock(this->pwThreadLoop);
 
+        this->processedEvent = pw_loop_add_event(
+            pw_thread_loop_get_loop(this->pwThreadLoop),
+            PipeWireOut::OnBuffersProcessed,
+            this);
+
         this->pwStream = pw_stream_new_simple(
             pw_thread_loop_get_loop(this->pwThreadLoop),
             "musikcube",
@@ -390,7 +509,8 @@ bool PipeWireOut::StartPipeWire(IBuffer* buffer) {
 
             pw_stream_flags streamFlags = (pw_stream_flags)(
                 PW_STREAM_FLAG_AUTOCONNECT |
-                PW_STREAM_FLAG_MAP_BUFFERS);
+                PW_STREAM_FLAG_MAP_BUFFERS |
+                PW_STREAM_FLAG_RT_PROCESS);
 
             result = pw_stream_connect(
                 this->pwStream,
@@ -429,7 +549,9 @@ cleanup:
 OutputState PipeWireOut::Play(IBuffer *buffer, IBufferProvider *provider) {
     if (!this->initialized) {
         std::unique_lock<std::recursive_mutex> lock(this->mutex);
-        this->maxInternalBuffers = prefs->GetInt(PREF_OUTPUT_BUFFER_COUNT, DEFAULT_OUTPUT_BUFFER_COUNT);
+        this->maxInternalBuffers = std::min(
+            (size_t) prefs->GetInt(PREF_OUTPUT_BUFFER_COUNT, DEFAULT_OUTPUT_BUFFER_COUNT),
+            MAX_OUTPUT_BUFFER_COUNT);
         if (!pipeWireInitialized) {
             pw_init(nullptr, nullptr);
             pipeWireInitialized = true;
@@ -454,22 +576,24 @@ OutputState PipeWireOut::Play(IBuffer *buffer, IBufferProvider *provider) {
         return OutputState::InvalidState;
     }
 
-    {
-        std::unique_lock<std::recursive_mutex> lock(this->mutex);
-        if (this->buffers.size() >= maxInternalBuffers) {
-            return OutputState::BufferFull;
-        }
-        this->buffers.push_back(new InBufferContext(buffer, provider));
-        bufferCondition.notify_all();
+    /* no lock here: we're the only producer for `inputQueue` */
+    if ((size_t) this->queued.load() >= this->maxInternalBuffers) {
+        return OutputState::BufferFull;
+    }
+
+    ++this->queued;
+    if (!this->inputQueue.Push(InBufferContext(buffer, provider))) {
+        --this->queued;
+        return OutputState::BufferFull;
     }
 
     return OutputState::BufferWritten;
 }
 
 double PipeWireOut::Latency() {
-    /* CAL TODO: i see how to set latency, but not a good way to query
-    PipeWire to see what it actually is */
-    return 0.0;
+    /* updated by OnStreamProcess(): the graph's delay, plus whatever we've
+    queued to the stream that it hasn't consumed yet. */
+    return this->latency.load();
 }
 
 void PipeWireOut::RefreshDeviceList() {
@@ -34,19 +34,21 @@
 
 #pragma once
 
-#include <musikcore/sdk/IOutput.h>
+#include <musikcore/sdk/IOutputStats.h>
 #include <pipewire/pipewire.h>
+#include "SpscRing.h"
 #include <atomic>
 #include <thread>
 #include <mutex>
-#include <deque>
 #include <vector>
 #include <condition_variable>
 
 using namespace musik::core::sdk;
 
-class PipeWireOut : public IOutput {
+class PipeWireOut : public IOutputStats {
     public:
+        static constexpr size_t MAX_OUTPUT_BUFFER_COUNT = 64;
+
         PipeWireOut();
         ~PipeWireOut();
 
@@ -68,10 +70,18 @@ class PipeWireOut : public IOutput {
         IDevice* GetDefaultDevice() override;
         int GetDefaultSampleRate() override { return -1; }
 
+        /* IOutputStats */
+        uint64_t Underruns() override { return this->underruns.load(); }
+        uint64_t BufferMisses() override { return this->outputBufferMisses.load(); }
+
     private:
         bool StartPipeWire(IBuffer* buffer);
         void StopPipeWire();
         void DiscardInputBuffers();
+        void ReleaseProcessedBuffers();
+        void SuspendProcessing();
+        void ResumeProcessing();
+        void LogStats();
         void RefreshDeviceList();
 
         static void OnCoreDone(
@@ -102,32 +112,32 @@ class PipeWireOut : public IOutput {
             const char* error);
 
         static void OnStreamProcess(void* userdata);
+        static void Process(PipeWireOut* self);
 
         static void OnDrained(void* userdata);
 
+        static void OnBuffersProcessed(void* userdata, uint64_t count);
+
+        /* plain value type; these are copied through the lock-free queues, and
+        returned to their provider off the realtime thread. */
         struct InBufferContext {
+            InBufferContext() { }
             InBufferContext(IBuffer* buffer, IBufferProvider* provider) {
                 this->buffer = buffer; this->provider = provider;
                 this->readPtr = (char*) buffer->BufferPointer();
                 this->remaining = (uint32_t) buffer->Bytes();
             }
-            void Advance(int count) {
-                bool release = count >= remaining;
+            void Advance(uint32_t count) {
                 this->remaining -= count;
                 this->readPtr += count;
-                if (release) {
-                    this->provider->OnBufferProcessed(this->buffer);
-                    delete this;
-                }
             }
-            void Discard() {
-                this->provider->OnBufferProcessed(this->buffer);
-                delete this;
+            bool Valid() const {
+                return this->buffer != nullptr;
             }
             IBuffer* buffer{nullptr};
             IBufferProvider* provider{nullptr};
             uint32_t remaining{0};
-            char* readPtr;
+            char* readPtr{nullptr};
         };
 
         struct OutBufferContext {
@@ -282,7 +292,19 @@ class PipeWireOut : public IOutput {
             Stopped, Paused, Playing, Shutdown
         };
 
-        std::deque<InBufferContext*> buffers;
+        /* buffers flow from Play() to OnStreamProcess() through `inputQueue`,
+        and back out through `processedQueue`. `queued` counts everything that
+        hasn't been returned to its provider yet. */
+        SpscRing<InBufferContext> inputQueue{MAX_OUTPUT_BUFFER_COUNT};
+        SpscRing<InBufferContext> processedQueue{MAX_OUTPUT_BUFFER_COUNT + 1};
+        InBufferContext currentBuffer; /* only touched by OnStreamProcess() */
+        std::atomic<int> queued{0};
+        std::atomic<uint64_t> underruns{0};
+        std::atomic<uint64_t> outputBufferMisses{0};
+        std::atomic<bool> fed{false}; /* has audio since the last start, stop or drain */
+        std::atomic<bool> processing{false}, processSuspended{false};
+        std::atomic<double> latency{0.0};
+        spa_source* processedEvent{nullptr};
         std::recursive_mutex mutex;
         std::atomic<bool> initialized{false};
         std::atomic<State> state{State::Stopped};
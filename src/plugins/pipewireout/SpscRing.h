@@ -0,0 +1,94 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+/* a bounded, lock-free, single producer / single consumer queue. storage is
+allocated up front, so neither Push() nor Pop() allocate, lock, or block;
+both are safe to call from a realtime thread. */
+template <typename T>
+class SpscRing {
+    public:
+        explicit SpscRing(size_t capacity)
+        : slots(capacity + 1) {
+        }
+
+        SpscRing(const SpscRing&) = delete;
+        SpscRing& operator=(const SpscRing&) = delete;
+
+        /* producer only */
+        bool Push(const T& value) {
+            const size_t write = this->writeIndex.load(std::memory_order_relaxed);
+            const size_t next = this->Next(write);
+            if (next == this->readIndex.load(std::memory_order_acquire)) {
+                return false; /* full */
+            }
+            this->slots[write] = value;
+            this->writeIndex.store(next, std::memory_order_release);
+            return true;
+        }
+
+        /* consumer only */
+        bool Pop(T& value) {
+            const size_t read = this->readIndex.load(std::memory_order_relaxed);
+            if (read == this->writeIndex.load(std::memory_order_acquire)) {
+                return false; /* empty */
+            }
+            value = this->slots[read];
+            this->readIndex.store(this->Next(read), std::memory_order_release);
+            return true;
+        }
+
+        bool Empty() const {
+            return this->readIndex.load(std::memory_order_acquire) ==
+                this->writeIndex.load(std::memory_order_acquire);
+        }
+
+        size_t Capacity() const {
+            return this->slots.size() - 1;
+        }
+
+    private:
+        size_t Next(size_t index) const {
+            return (index + 1) == this->slots.size() ? 0 : index + 1;
+        }
+
+        std::vector<T> slots;
+        alignas(64) std::atomic<size_t> readIndex{0};
+        alignas(64) std::atomic<size_t> writeIndex{0};
+};
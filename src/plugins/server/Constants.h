@@ -49,6 +49,12 @@ namespace defaults {
     static const bool use_ipv6 = false;
     static const bool transcoder_synchronous = false;
     static const bool transcoder_synchronous_fallback = false;
+    static const int http_server_thread_pool_size = 8;
+    static const int http_server_read_chunk_size = 65536;
+    static const bool http_server_sendfile = true;
+    static const int thumbnail_resizer_thread_count = 2;
+    static const std::string thumbnail_pregenerate_sizes = "";
+    static const int snapshot_cache_max_bytes = 16 * 1024 * 1024;
 }
 
 namespace prefs {
@@ -61,6 +67,12 @@ namespace prefs {
     static const std::string transcoder_max_active_count = "transcoder_max_active_count";
     static const std::string transcoder_synchronous = "transcoder_synchronous";
     static const std::string transcoder_synchronous_fallback = "transcoder_synchronous_fallback";
+    static const std::string http_server_thread_pool_size = "http_server_thread_pool_size";
+    static const std::string http_server_read_chunk_size = "http_server_read_chunk_size";
+    static const std::string http_server_sendfile = "http_server_sendfile";
+    static const std::string thumbnail_resizer_thread_count = "thumbnail_resizer_thread_count";
+    static const std::string thumbnail_pregenerate_sizes = "thumbnail_pregenerate_sizes";
+    static const std::string snapshot_cache_max_bytes = "snapshot_cache_max_bytes";
 }
 
 namespace message {
@@ -144,6 +156,14 @@ namespace key {
     static const std::string enabled = "enabled";
     static const std::string bands = "bands";
     static const std::string time = "time";
+    static const std::string snapshots = "snapshots";
+    static const std::string unique_count = "unique_count";
+    static const std::string bytes = "bytes";
+    static const std::string max_bytes = "max_bytes";
+    static const std::string hits = "hits";
+    static const std::string misses = "misses";
+    static const std::string shared = "shared";
+    static const std::string evictions = "evictions";
 }
 
 namespace value {
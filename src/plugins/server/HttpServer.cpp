@@ -47,14 +47,23 @@
 
 #include <unordered_map>
 #include <string>
+#include <thread>
+#include <deque>
+#include <functional>
+#include <climits>
 #include <cstdlib>
+#include <ctime>
 #include <filesystem>
 
 #include <fcntl.h>
 #include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #ifdef WIN32
 #include <io.h>
+#else
+#include <unistd.h>
 #endif
 
 #include <vector>
@@ -65,6 +74,9 @@
 static const char* ENVIRONMENT_DISABLE_HTTP_SERVER_AUTH = "MUSIKCUBE_DISABLE_HTTP_SERVER_AUTH";
 static const char* TAG = "HttpServer";
 
+/* offloaded requests that may wait for a free pool thread, per thread */
+static const size_t MAX_QUEUED_REQUESTS_PER_WORKER = 8;
+
 namespace std {
     namespace fs = std::filesystem;
 }
@@ -95,6 +107,8 @@ struct Range {
     size_t to;
     size_t total;
     IDataStream* file;
+    HttpServer::Counters* counters;
+    StreamPump* pump;
 
     std::string HeaderValue() {
         return "bytes " + std::to_string(from) + "-" + std::to_string(to) + "/" + std::to_string(total);
@@ -130,9 +144,300 @@ static std::string fileExtension(const std::string& fn) {
     return "mp3";
 }
 
+/* a fixed set of threads that run work the MHD workers mustn't block on:
+offloaded requests, and stream pumps. sized from the same preference as the
+MHD worker pool. new requests are refused once `maxQueued` tasks are waiting,
+so a burst can't grow the backlog without bound. */
+class WorkerPool {
+    public:
+        using Task = std::function<void()>;
+
+        void Start(int threadCount, size_t maxQueued) {
+            this->Stop();
+
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->maxQueued = maxQueued;
+                this->running = true;
+            }
+
+            for (int i = 0; i < threadCount; i++) {
+                this->threads.push_back(std::make_shared<std::thread>(
+                    std::bind(&WorkerPool::ThreadProc, this)));
+            }
+        }
+
+        /* callers must make sure nothing they posted is still outstanding */
+        void Stop() {
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->running = false;
+            }
+
+            this->condition.notify_all();
+
+            for (auto thread : this->threads) {
+                thread->join();
+            }
+
+            this->threads.clear();
+            this->tasks.clear();
+        }
+
+        /* queues a task for a new request. fails if we're not running, or
+        there's already too much work waiting. */
+        bool TryPost(Task task) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            if (!this->running || this->tasks.size() >= this->maxQueued) {
+                return false;
+            }
+            this->tasks.push_back(task);
+            this->condition.notify_one();
+            return true;
+        }
+
+        /* queues a task for work that's already been accepted, like the next
+        step of a stream pump. bounded by the number of active pumps. */
+        bool Post(Task task) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            if (!this->running) {
+                return false;
+            }
+            this->tasks.push_back(task);
+            this->condition.notify_one();
+            return true;
+        }
+
+    private:
+        void ThreadProc() {
+            while (true) {
+                Task task;
+
+                {
+                    std::unique_lock<std::mutex> lock(this->mutex);
+
+                    while (this->running && !this->tasks.size()) {
+                        this->condition.wait(lock);
+                    }
+
+                    if (!this->running) {
+                        return;
+                    }
+
+                    task = this->tasks.front();
+                    this->tasks.pop_front();
+                }
+
+                try {
+                    task();
+                }
+                catch (...) {
+                }
+            }
+        }
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<Task> tasks;
+        std::vector<std::shared_ptr<std::thread>> threads;
+        size_t maxQueued { 0 };
+        bool running { false };
+};
+
+/* when serving from a worker pool, every MHD thread multiplexes many connections,
+so none of them may block in a read: a transcoder that's falling behind, or a
+stream backed by a network share, would stall every other connection on the
+same worker. streamed responses are instead filled by a StreamPump, which reads
+from the IDataStream in steps run on the server's WorkerPool. a step reads
+until the buffer is full, and the next one is posted once the connection has
+drained some of it. if the connection asks for data before it's available,
+it's suspended, and resumed as soon as more arrives. */
+class StreamPump {
+    public:
+        StreamPump(HttpServer* server, MHD_Connection* connection, Range* range, size_t chunkSize)
+        : server(server)
+        , connection(connection)
+        , file(range->file)
+        , from(range->from)
+        , remaining(range->total ? (range->to - range->from + 1) : SIZE_MAX)
+        , chunk(chunkSize)
+        , capacity(chunkSize * 4) {
+        }
+
+        void Start() {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->Schedule();
+        }
+
+        /* called by MHD worker threads via fileReadCallback */
+        ssize_t Read(char* dest, size_t max) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+
+            const size_t available = this->buffer.size() - this->head;
+            if (available > 0) {
+                const size_t count = std::min(available, max);
+                memcpy(dest, this->buffer.data() + this->head, count);
+                this->head += count;
+                this->server->counters.bytesSent += count;
+                if (available - count < this->capacity) {
+                    this->Schedule();
+                }
+                return (ssize_t) count;
+            }
+
+            if (this->finished) {
+                return MHD_CONTENT_READER_END_OF_STREAM;
+            }
+
+            this->suspended = true;
+            MHD_suspend_connection(this->connection);
+            return 0;
+        }
+
+        /* stops reading and resumes the connection, if necessary. the pump
+        stays alive until MHD is done with the response. */
+        void Interrupt() {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            if (!this->released) {
+                this->stopped = true;
+                this->file->Interrupt();
+                if (!this->scheduled) {
+                    this->finished = true;
+                    this->Resume();
+                }
+            }
+        }
+
+        /* called from fileFreeCallback once MHD is done with the response.
+        the stream is closed and the pump deleted as soon as no step is
+        in flight; either here, or by the step itself. */
+        void Release() {
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->stopped = true;
+                this->released = true;
+                this->file->Interrupt();
+                if (this->scheduled) {
+                    return;
+                }
+            }
+            this->Destroy();
+        }
+
+    private:
+        /* must be called with the lock held */
+        void Schedule() {
+            if (this->scheduled || this->finished || this->stopped) {
+                return;
+            }
+
+            this->scheduled = true;
+
+            if (!this->server->workers->Post(std::bind(&StreamPump::Step, this))) {
+                /* the pool is shutting down. end the response early. */
+                this->scheduled = false;
+                this->finished = true;
+                this->Resume();
+            }
+        }
+
+        void Step() {
+            bool ok = true;
+
+            if (!this->positioned) {
+                this->positioned = true;
+                ok = !this->file->Seekable() ||
+                    this->file->SetPosition((PositionType) this->from);
+            }
+
+            while (ok && this->remaining > 0) {
+                {
+                    std::unique_lock<std::mutex> lock(this->mutex);
+                    if (this->stopped) {
+                        break;
+                    }
+                    if (this->buffer.size() - this->head >= this->capacity) {
+                        /* full. Read() schedules the next step once there's room */
+                        this->scheduled = false;
+                        return;
+                    }
+                }
+
+                const size_t wanted = std::min(this->chunk.size(), this->remaining);
+                const PositionType count = this->file->Read(this->chunk.data(), (PositionType) wanted);
+                if (count <= 0) {
+                    break;
+                }
+
+                this->remaining -= (size_t) count;
+
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->buffer.erase(0, this->head);
+                this->head = 0;
+                this->buffer.append(this->chunk.data(), (size_t) count);
+                this->Resume();
+            }
+
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->scheduled = false;
+                this->finished = true;
+                this->Resume();
+                if (!this->released) {
+                    return; /* Release() will clean up */
+                }
+            }
+
+            this->Destroy();
+        }
+
+        /* must be called without the lock held, once nothing else can touch
+        the pump. */
+        void Destroy() {
+            this->file->Close(); /* lazy destroy */
+
+            {
+                std::unique_lock<std::mutex> lock(this->server->backgroundMutex);
+                this->server->streamPumps.erase(this);
+                this->server->backgroundCondition.notify_all();
+            }
+
+            delete this;
+        }
+
+        /* must be called with the lock held */
+        void Resume() {
+            if (this->suspended) {
+                this->suspended = false;
+                MHD_resume_connection(this->connection);
+            }
+        }
+
+        HttpServer* server;
+        MHD_Connection* connection;
+        IDataStream* file;
+        size_t from;
+        size_t remaining;
+        std::vector<char> chunk;
+        size_t capacity;
+        std::string buffer;
+        size_t head { 0 };
+        std::mutex mutex;
+        bool suspended { false };
+        bool scheduled { false }; /* a Step() is queued or running */
+        bool positioned { false };
+        bool finished { false };
+        bool stopped { false };
+        bool released { false };
+};
+
 static ssize_t fileReadCallback(void *cls, uint64_t pos, char *buf, size_t max) {
     Range* range = static_cast<Range*>(cls);
 
+    if (range->pump) {
+        return range->pump->Read(buf, max);
+    }
+
     size_t offset = (size_t) pos + range->from;
     offset = std::min(range->to ? range->to : (size_t) SIZE_MAX, offset);
 
@@ -147,6 +452,9 @@ static ssize_t fileReadCallback(void *cls, uint64_t pos, char *buf, size_t max)
 
     count = range->file->Read(buf, count);
     if (count > 0) {
+        if (range->counters) {
+            range->counters->bytesSent += count;
+        }
         return count;
     }
 
@@ -155,7 +463,12 @@ static ssize_t fileReadCallback(void *cls, uint64_t pos, char *buf, size_t max)
 
 static void fileFreeCallback(void *cls) {
     Range* range = static_cast<Range*>(cls);
-    if (range->file) {
+    if (range->pump) {
+        range->pump->Release(); /* closes the file when it's done */
+        range->pump = nullptr;
+        range->file = nullptr;
+    }
+    else if (range->file) {
         range->file->Close(); /* lazy destroy */
         range->file = nullptr;
     }
@@ -168,6 +481,8 @@ static Range* parseRange(IDataStream* file, const char* range) {
     size_t size = file ? file->Length() : 0;
 
     result->file = file;
+    result->counters = nullptr;
+    result->pump = nullptr;
     result->total = size;
     result->from = 0;
     result->to = (size <= 0) ? 0 : size - 1;
@@ -210,6 +525,144 @@ static Range* parseRange(IDataStream* file, const char* range) {
     return result;
 }
 
+#ifndef WIN32
+/* for plain local files we can hand libmicrohttpd a file descriptor and let it
+use sendfile() directly, bypassing the IDataStream read callback entirely. */
+static MHD_Response* createSendfileResponse(Range* range, const std::string& filename) {
+    if (range->total == 0 || range->to < range->from) {
+        return nullptr;
+    }
+
+    std::error_code ec;
+    if (!std::fs::is_regular_file(std::fs::u8path(filename), ec)) {
+        return nullptr;
+    }
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    /* note: libmicrohttpd takes ownership of the descriptor, and will close it
+    when the response is destroyed. */
+    MHD_Response* response = MHD_create_response_from_fd_at_offset64(
+        range->to - range->from + 1, fd, range->from);
+
+    if (!response) {
+        close(fd);
+    }
+
+    return response;
+}
+#endif
+
+static MHD_Response* createFileResponse(
+    Range* range,
+    const std::string& filename,
+    size_t readChunkSize,
+    bool allowSendfile,
+    HttpServer::Counters& counters,
+    bool& sendfile)
+{
+    MHD_Response* response = nullptr;
+    const size_t length = (range->to - range->from);
+
+    sendfile = false;
+
+#ifndef WIN32
+    if (allowSendfile) {
+        response = createSendfileResponse(range, filename);
+        if (response) {
+            /* libmicrohttpd doesn't call back into us for these, so account
+            for the bytes up front. */
+            sendfile = true;
+            counters.sendfileResponses++;
+            counters.bytesSent += length + 1;
+            return response;
+        }
+    }
+#endif
+
+    range->counters = &counters;
+
+    response = MHD_create_response_from_callback(
+        length == 0 ? MHD_SIZE_UNKNOWN : length + 1,
+        readChunkSize,
+        &fileReadCallback,
+        range,
+        &fileFreeCallback);
+
+    if (response) {
+        counters.streamedResponses++;
+    }
+
+    return response;
+}
+
+/* computes an ETag and Last-Modified value for the specified file based on its
+modification time and size. used to satisfy conditional GET requests. */
+static bool getCacheValidators(const std::string& fn, std::string& etag, std::string& lastModified) {
+#ifdef WIN32
+    struct _stat64 info;
+    if (_wstat64(utf8to16(fn.c_str()).c_str(), &info) != 0) {
+        return false;
+    }
+#else
+    struct stat info;
+    if (stat(fn.c_str(), &info) != 0) {
+        return false;
+    }
+#endif
+
+    etag = str::Format(
+        "\"%llx-%llx\"",
+        (unsigned long long) info.st_mtime,
+        (unsigned long long) info.st_size);
+
+    std::tm tm;
+    const time_t mtime = (time_t) info.st_mtime;
+#ifdef WIN32
+    gmtime_s(&tm, &mtime);
+#else
+    gmtime_r(&mtime, &tm);
+#endif
+
+    char buffer[64];
+    strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    lastModified = buffer;
+
+    return true;
+}
+
+static bool isNotModified(
+    MHD_Connection* connection,
+    const std::string& etag,
+    const std::string& lastModified)
+{
+    const char* ifNoneMatch = MHD_lookup_connection_value(
+        connection, MHD_HEADER_KIND, "If-None-Match");
+
+    /* per rfc7232, If-None-Match takes precedence over If-Modified-Since */
+    if (ifNoneMatch) {
+        for (auto& value : str::Split(std::string(ifNoneMatch), ",")) {
+            std::string trimmed = str::Trim(value);
+            if (trimmed.find("W/") == 0) {
+                trimmed = trimmed.substr(2);
+            }
+            if (trimmed == etag || trimmed == "*") {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* clients echo back the value we sent, so an exact match is sufficient */
+    const char* ifModifiedSince = MHD_lookup_connection_value(
+        connection, MHD_HEADER_KIND, "If-Modified-Since");
+
+    return ifModifiedSince && lastModified == ifModifiedSince;
+}
+
 static size_t getUnsignedUrlParam(
     struct MHD_Connection *connection,
     const std::string& argument,
@@ -275,9 +728,16 @@ static bool isAuthenticated(MHD_Connection *connection, Context& context) {
 }
 
 HttpServer::HttpServer(Context& context)
-: context(context)
-, running(false) {
-    this->httpServer = nullptr;
+: httpServer(nullptr)
+, context(context)
+, workers(new WorkerPool())
+, thumbnailCache(context)
+, readChunkSize(defaults::http_server_read_chunk_size)
+, sendfileEnabled(defaults::http_server_sendfile)
+, offloadEnabled(false)
+, running(false)
+, pendingRequestCount(0)
+, stopping(false) {
 }
 
 HttpServer::~HttpServer() {
@@ -300,16 +760,45 @@ bool HttpServer::Start() {
             ipVersion = MHD_USE_IPv6;
         }
 
+        /* a positive thread pool size means we'll use a fixed number of workers
+        that multiplex connections using the best polling mechanism available
+        (epoll on linux). zero falls back to the old thread-per-connection model. */
+        const int threadPoolSize = std::max(0, context.prefs->GetInt(
+            prefs::http_server_thread_pool_size.c_str(),
+            defaults::http_server_thread_pool_size));
+
+        /* workers must never block, so anything that might is handed off to
+        our own pool, of the same size, while its connection is suspended. see
+        Offload() and StreamPump. */
+        this->offloadEnabled = (threadPoolSize > 0);
+        if (this->offloadEnabled) {
+            this->workers->Start(threadPoolSize, (size_t) threadPoolSize * MAX_QUEUED_REQUESTS_PER_WORKER);
+        }
+
+#if MHD_VERSION >= 0x00095300
+        const int threadingFlags = this->offloadEnabled ? MHD_ALLOW_SUSPEND_RESUME : MHD_USE_THREAD_PER_CONNECTION;
+#else
+        const int threadingFlags = this->offloadEnabled ? MHD_USE_SUSPEND_RESUME : MHD_USE_THREAD_PER_CONNECTION;
+#endif
+
         int serverFlags =
 #if MHD_VERSION >= 0x00095300
-            MHD_USE_AUTO | MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_THREAD_PER_CONNECTION | ipVersion;
+            MHD_USE_AUTO | MHD_USE_INTERNAL_POLLING_THREAD | threadingFlags | ipVersion;
 #else
-            MHD_USE_SELECT_INTERNALLY | MHD_USE_THREAD_PER_CONNECTION | ipVersion;
+            MHD_USE_SELECT_INTERNALLY | threadingFlags | ipVersion;
 #endif
 
         int serverPort =
             context.prefs->GetInt(prefs::http_server_port.c_str(), defaults::http_server_port);
 
+        this->readChunkSize = (size_t) std::max(4096, context.prefs->GetInt(
+            prefs::http_server_read_chunk_size.c_str(),
+            defaults::http_server_read_chunk_size));
+
+        this->sendfileEnabled = context.prefs->GetBool(
+            prefs::http_server_sendfile.c_str(),
+            defaults::http_server_sendfile);
+
         httpServer = MHD_start_daemon(
             serverFlags,
             serverPort,
@@ -317,14 +806,29 @@ bool HttpServer::Start() {
             nullptr,                                    /* accept() policy callback data */
             &HttpServer::HandleRequest,                 /* request handler callback */
             this,                                       /* request handler callback data */
+            MHD_OPTION_NOTIFY_COMPLETED,                /* option to observe request completion */
+            &HttpServer::HandleRequestCompleted,        /* callback used to free offloaded requests */
+            this,                                       /* request completed callback data */
             MHD_OPTION_UNESCAPE_CALLBACK,               /* option to configure unescaping */
             &HttpServer::HandleUnescape,                /* callback to be called for unescaping data */
             this,                                       /* unescape data callback data */
             MHD_OPTION_LISTENING_ADDRESS_REUSE,         /* option to configure address reuse */
             1,                                          /* enable address reuse */
+            MHD_OPTION_THREAD_POOL_SIZE,                /* option to configure the worker pool */
+            (unsigned int) threadPoolSize,              /* number of workers; 0 disables the pool */
+#if MHD_VERSION >= 0x00095300
+            MHD_OPTION_NOTIFY_CONNECTION,               /* option to observe connection lifetime */
+            &HttpServer::HandleConnectionNotification,  /* callback used to update counters */
+            this,                                       /* connection callback data */
+#endif
             MHD_OPTION_END);                            /* terminal option */
 
         this->running = (httpServer != nullptr);
+
+        if (this->running) {
+            this->thumbnailCache.Start();
+        }
+
         return running;
     }
 
@@ -333,16 +837,172 @@ bool HttpServer::Start() {
 
 bool HttpServer::Stop() {
     if (httpServer) {
+        /* libmicrohttpd requires all suspended connections to be resumed before
+        the daemon is stopped. wait for offloaded requests to finish up, and ask
+        stream pumps to stop reading, which resumes their connections. */
+        {
+            std::unique_lock<std::mutex> lock(this->backgroundMutex);
+            this->stopping = true;
+            for (auto pump : this->streamPumps) {
+                pump->Interrupt();
+            }
+            while (this->pendingRequestCount > 0) {
+                this->backgroundCondition.wait(lock);
+            }
+        }
+
         MHD_stop_daemon(this->httpServer);
         this->httpServer = nullptr;
+
+        /* stopping the daemon frees all responses, which releases their pumps */
+        {
+            std::unique_lock<std::mutex> lock(this->backgroundMutex);
+            while (this->streamPumps.size()) {
+                this->backgroundCondition.wait(lock);
+            }
+            this->stopping = false;
+        }
     }
 
+    /* nothing is left that could post to it */
+    this->workers->Stop();
+    this->thumbnailCache.Stop();
+
     this->running = false;
     this->exitCondition.notify_all();
 
     return true;
 }
 
+void HttpServer::OnIndexerFinished(int trackCount) {
+    /* new albums may have brought new artwork with them. Pregenerate() skips
+    variants that already exist, and is a no-op if we're not running. */
+    this->thumbnailCache.Pregenerate();
+}
+
+#if MHD_VERSION >= 0x00095300
+void HttpServer::HandleConnectionNotification(
+    void* cls,
+    struct MHD_Connection* connection,
+    void** socketContext,
+    enum MHD_ConnectionNotificationCode code)
+{
+    auto server = static_cast<HttpServer*>(cls);
+    auto& counters = server->counters;
+
+    if (code == MHD_CONNECTION_NOTIFY_STARTED) {
+        counters.activeConnections++;
+        counters.totalConnections++;
+    }
+    else if (code == MHD_CONNECTION_NOTIFY_CLOSED) {
+        counters.activeConnections--;
+        server->LogCounters();
+    }
+}
+#endif
+
+void HttpServer::LogCounters() {
+    this->context.debug->Info(TAG, str::Format(
+        "connection closed. active=%llu, total=%llu, sent=%llu bytes, streamed=%llu, "
+        "sendfile=%llu, offloaded=%llu, rejected=%llu",
+        (unsigned long long) this->counters.activeConnections.load(),
+        (unsigned long long) this->counters.totalConnections.load(),
+        (unsigned long long) this->counters.bytesSent.load(),
+        (unsigned long long) this->counters.streamedResponses.load(),
+        (unsigned long long) this->counters.sendfileResponses.load(),
+        (unsigned long long) this->counters.offloadedRequests.load(),
+        (unsigned long long) this->counters.rejectedRequests.load()).c_str());
+}
+
+/* with a worker pool, requests that may block (opening a track can start a
+transcode and wait on it, and thumbnails may need to be resized) are handled on
+our WorkerPool while the connection is suspended. once a response is ready
+the connection is resumed, and HandleRequest() is called again to queue it. */
+struct PendingRequest {
+    MHD_Response* response { nullptr };
+    int status { MHD_HTTP_NOT_FOUND };
+};
+
+bool HttpServer::Offload(
+    MHD_Connection* connection,
+    void** con_cls,
+    std::vector<std::string>& pathParts,
+    RequestHandler handler)
+{
+    {
+        std::unique_lock<std::mutex> lock(this->backgroundMutex);
+        if (!this->offloadEnabled || this->stopping) {
+            return false;
+        }
+        ++this->pendingRequestCount;
+    }
+
+    auto pending = new PendingRequest();
+    *con_cls = pending;
+    MHD_suspend_connection(connection);
+
+    auto finish = [this, connection]() {
+        MHD_resume_connection(connection);
+        std::unique_lock<std::mutex> lock(this->backgroundMutex);
+        --this->pendingRequestCount;
+        this->backgroundCondition.notify_all();
+    };
+
+    auto task = [this, connection, pending, pathParts, handler, finish]() mutable {
+        try {
+            pending->status = handler(this, pending->response, connection, pathParts);
+        }
+        catch (...) {
+        }
+        finish();
+    };
+
+    if (this->workers->TryPost(task)) {
+        ++this->counters.offloadedRequests;
+    }
+    else {
+        /* too much work is already queued. ask the client to come back later
+        instead of piling up more. */
+        ++this->counters.rejectedRequests;
+        pending->status = MHD_HTTP_SERVICE_UNAVAILABLE;
+        pending->response = MHD_create_response_from_buffer(0, nullptr, MHD_RESPMEM_PERSISTENT);
+        finish();
+    }
+
+    return true;
+}
+
+StreamPump* HttpServer::CreateStreamPump(MHD_Connection* connection, Range* range) {
+    std::unique_lock<std::mutex> lock(this->backgroundMutex);
+
+    if (!this->offloadEnabled || this->stopping || !range->file) {
+        return nullptr;
+    }
+
+    auto pump = new StreamPump(this, connection, range, this->readChunkSize);
+    this->streamPumps.insert(pump);
+    pump->Start();
+    return pump;
+}
+
+void HttpServer::HandleRequestCompleted(
+    void* cls,
+    struct MHD_Connection* connection,
+    void** con_cls,
+    enum MHD_RequestTerminationCode toe)
+{
+    /* normally freed when the response is queued, but the connection may have
+    gone away before that happened. */
+    auto pending = static_cast<PendingRequest*>(*con_cls);
+    if (pending) {
+        if (pending->response) {
+            MHD_destroy_response(pending->response);
+        }
+        delete pending;
+        *con_cls = nullptr;
+    }
+}
+
 size_t HttpServer::HandleUnescape(void * cls, struct MHD_Connection *c, char *s) {
     /* don't do anything. the default implementation will decode the
     entire path, which breaks if we have individually decoded segments. */
@@ -361,6 +1021,21 @@ MHD_Result HttpServer::HandleRequest(
 {
     auto server = static_cast<HttpServer*>(cls);
 
+    /* an offloaded request finished, and its connection was resumed */
+    if (*con_cls) {
+        auto pending = static_cast<PendingRequest*>(*con_cls);
+        *con_cls = nullptr;
+
+        int ret = MHD_NO;
+        if (pending->response) {
+            ret = MHD_queue_response(connection, pending->status, pending->response);
+            MHD_destroy_response(pending->response);
+        }
+
+        delete pending;
+        return (MHD_Result) ret;
+    }
+
 #ifdef ENABLE_DEBUG
     server->context.debug->Info(TAG, str::Format("new request: %s", url).c_str());
 #endif
@@ -391,10 +1066,16 @@ MHD_Result HttpServer::HandleRequest(
                 if (parts.size() > 0) {
                     /* /audio/id/<id> OR /audio/external_id/<external_id> */
                     if (parts.at(0) == fragment::audio && parts.size() == 3) {
+                        if (server->Offload(connection, con_cls, parts, &HttpServer::HandleAudioTrackRequest)) {
+                            return (MHD_Result) MHD_YES;
+                        }
                         status = HandleAudioTrackRequest(server, response, connection, parts);
                     }
                     /* /thumbnail/<id> */
                     else if (parts.at(0) == fragment::thumbnail && parts.size() == 2) {
+                        if (server->Offload(connection, con_cls, parts, &HttpServer::HandleThumbnailRequest)) {
+                            return (MHD_Result) MHD_YES;
+                        }
                         status = HandleThumbnailRequest(server, response, connection, parts);
                     }
                 }
@@ -527,13 +1208,15 @@ int HttpServer::HandleAudioTrackRequest(
 
         if (file) {
             size_t length = (range->to - range->from);
+            bool sendfile = false;
 
-            response = MHD_create_response_from_callback(
-                length == 0 ? MHD_SIZE_UNKNOWN : length + 1,
-                4096,
-                &fileReadCallback,
+            response = createFileResponse(
                 range,
-                &fileFreeCallback);
+                filename,
+                server->readChunkSize,
+                server->sendfileEnabled && bitrate == 0 && !isOnDemandTranscoder,
+                server->counters,
+                sendfile);
 
 #ifdef ENABLE_DEBUG
             server->context.debug->Info(TAG, str::Format("response length=%d", ((length == 0) ? 0 : length + 1)).c_str());
@@ -590,6 +1273,15 @@ int HttpServer::HandleAudioTrackRequest(
                 file->Release();
                 file = nullptr;
             }
+
+            /* the sendfile path has its own file descriptor, so we're done
+            with the data stream and range. */
+            if (sendfile) {
+                fileFreeCallback(range);
+            }
+            else if (response) {
+                range->pump = server->CreateStreamPump(connection, range);
+            }
         }
         else {
             status = MHD_HTTP_NOT_FOUND;
@@ -610,25 +1302,62 @@ int HttpServer::HandleThumbnailRequest(
 {
     int status = MHD_HTTP_NOT_FOUND;
 
-    char pathBuffer[4096];
-    server->context.environment->GetPath(PathType::Library, pathBuffer, sizeof(pathBuffer));
+    /* /thumbnail/<id>?size=<pixels> returns a downscaled variant. if it hasn't
+    been generated yet, the original is returned while it's resized in the
+    background. no size parameter returns the original image. */
+    const std::string& id = pathParts.at(1);
+    const size_t size = getUnsignedUrlParam(connection, "size", 0);
+    bool pending = false;
+
+    const std::string path = (size > 0)
+        ? server->thumbnailCache.GetFilename(id, (int) std::min(size, (size_t) INT_MAX), pending)
+        : server->thumbnailCache.GetOriginalFilename(id);
+
+    /* the client shouldn't hang on to a stand-in; make it ask again */
+    const char* cacheControl = pending ? "no-cache" : "public, max-age=31536000";
+
+    if (path.size()) {
+        std::string etag, lastModified;
+        const bool hasValidators = getCacheValidators(path, etag, lastModified);
+
+        if (hasValidators && isNotModified(connection, etag, lastModified)) {
+            response = MHD_create_response_from_buffer(0, nullptr, MHD_RESPMEM_PERSISTENT);
+            if (response) {
+                MHD_add_response_header(response, "ETag", etag.c_str());
+                MHD_add_response_header(response, "Last-Modified", lastModified.c_str());
+                MHD_add_response_header(response, "Cache-Control", cacheControl);
+                MHD_add_response_header(response, "Server", "musikcube server");
+                return MHD_HTTP_NOT_MODIFIED;
+            }
+        }
 
-    if (strlen(pathBuffer)) {
-        std::string path = std::string(pathBuffer) + "thumbs/" + pathParts.at(1) + ".jpg";
         IDataStream* file = server->context.environment->GetDataStream(path.c_str(), OpenFlags::Read);
 
         if (file) {
-            long length = file->Length();
+            Range* range = parseRange(file, nullptr);
+            bool sendfile = false;
 
-            response = MHD_create_response_from_callback(
-                length == 0 ? MHD_SIZE_UNKNOWN : length + 1,
-                4096,
-                &fileReadCallback,
-                parseRange(file, nullptr),
-                &fileFreeCallback);
+            response = createFileResponse(
+                range,
+                path,
+                server->readChunkSize,
+                server->sendfileEnabled,
+                server->counters,
+                sendfile);
+
+            if (sendfile) {
+                fileFreeCallback(range);
+            }
+            else if (response) {
+                range->pump = server->CreateStreamPump(connection, range);
+            }
 
             if (response) {
-                MHD_add_response_header(response, "Cache-Control", "public, max-age=31536000");
+                if (hasValidators) {
+                    MHD_add_response_header(response, "ETag", etag.c_str());
+                    MHD_add_response_header(response, "Last-Modified", lastModified.c_str());
+                }
+                MHD_add_response_header(response, "Cache-Control", cacheControl);
                 MHD_add_response_header(response, "Content-Type", contentType(path).c_str());
                 MHD_add_response_header(response, "Server", "musikcube server");
                 status = MHD_HTTP_OK;
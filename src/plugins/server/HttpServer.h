@@ -41,14 +41,22 @@ extern "C" {
 }
 
 #include "Context.h"
+#include "ThumbnailCache.h"
+#include <atomic>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
+#include <set>
 #include <vector>
 
 #if MHD_VERSION < 0x00097001
 #define MHD_Result int
 #endif
 
+struct Range;
+class StreamPump;
+class WorkerPool;
+
 class HttpServer {
     public:
         HttpServer(Context& context);
@@ -58,7 +66,27 @@ class HttpServer {
         bool Stop();
         void Wait();
 
+        void OnIndexerFinished(int trackCount);
+
+        struct Counters {
+            std::atomic<uint64_t> activeConnections { 0 };
+            std::atomic<uint64_t> totalConnections { 0 };
+            std::atomic<uint64_t> bytesSent { 0 };
+            std::atomic<uint64_t> streamedResponses { 0 };
+            std::atomic<uint64_t> sendfileResponses { 0 };
+            std::atomic<uint64_t> offloadedRequests { 0 };
+            std::atomic<uint64_t> rejectedRequests { 0 };
+        };
+
     private:
+        friend class StreamPump;
+
+        using RequestHandler = int(*)(
+            HttpServer* server,
+            MHD_Response*& response,
+            MHD_Connection* connection,
+            std::vector<std::string>& pathParts);
+
         static MHD_Result HandleRequest(
             void *cls,
             struct MHD_Connection *connection,
@@ -69,11 +97,25 @@ class HttpServer {
             size_t *upload_data_size,
             void **con_cls);
 
+        static void HandleRequestCompleted(
+            void* cls,
+            struct MHD_Connection* connection,
+            void** con_cls,
+            enum MHD_RequestTerminationCode toe);
+
         static size_t HandleUnescape(
             void * cls,
             struct MHD_Connection *c,
             char *s);
 
+#if MHD_VERSION >= 0x00095300
+        static void HandleConnectionNotification(
+            void* cls,
+            struct MHD_Connection* connection,
+            void** socketContext,
+            enum MHD_ConnectionNotificationCode code);
+#endif
+
         static int HandleAudioTrackRequest(
             HttpServer* server,
             MHD_Response*& response,
@@ -86,9 +128,32 @@ class HttpServer {
             MHD_Connection* connection,
             std::vector<std::string>& pathParts);
 
+        bool Offload(
+            MHD_Connection* connection,
+            void** con_cls,
+            std::vector<std::string>& pathParts,
+            RequestHandler handler);
+
+        StreamPump* CreateStreamPump(MHD_Connection* connection, Range* range);
+        void LogCounters();
+
         struct MHD_Daemon *httpServer;
         Context& context;
+        Counters counters;
+        std::unique_ptr<WorkerPool> workers;
+        ThumbnailCache thumbnailCache;
+        size_t readChunkSize;
+        bool sendfileEnabled;
+        bool offloadEnabled;
         volatile bool running;
         std::condition_variable exitCondition;
         std::mutex exitMutex;
+
+        /* background work that has to be wound down before the daemon can
+        be stopped, see Stop() */
+        std::mutex backgroundMutex;
+        std::condition_variable backgroundCondition;
+        size_t pendingRequestCount;
+        std::set<StreamPump*> streamPumps;
+        bool stopping;
 };
@@ -37,9 +37,11 @@
 #include <algorithm>
 
 using TrackList = Snapshots::TrackList;
+using TrackListPtr = Snapshots::TrackListPtr;
 using namespace std::chrono;
 
 static const int64_t SIX_HOURS_MILLIS = 1000 * 60 * 60 * 6;
+static const size_t DEFAULT_MAX_BYTES = 16 * 1024 * 1024;
 
 static inline int64_t now() {
     return duration_cast<milliseconds>(
@@ -54,49 +56,179 @@ static inline bool expired(int64_t expiry) {
     return now() >= expiry;
 }
 
+/* FNV-1a over the ids, in order */
+static uint64_t hashIds(const TrackList* tracks) {
+    uint64_t hash = 14695981039346656037ULL;
+    const size_t count = tracks->Count();
+    for (size_t i = 0; i < count; i++) {
+        uint64_t id = (uint64_t) tracks->GetId(i);
+        for (int j = 0; j < 8; j++) {
+            hash ^= (id & 0xff);
+            hash *= 1099511628211ULL;
+            id >>= 8;
+        }
+    }
+    return hash;
+}
+
+static bool sameIds(const TrackList* a, const TrackList* b) {
+    const size_t count = a->Count();
+    if (count != b->Count()) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (a->GetId(i) != b->GetId(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Snapshots::Snapshots() {
+    this->stats.maxBytes = DEFAULT_MAX_BYTES;
+}
+
 Snapshots::~Snapshots() {
     Reset();
 }
 
-TrackList* Snapshots::Get(const std::string& key) {
+TrackListPtr Snapshots::Get(const std::string& key) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+
     auto it = this->cache.find(key);
     if (it != this->cache.end()) {
-        this->cache[key] = CacheKey(it->second.tracks, expiry());
-        return it->second.tracks;
+        if (!expired(it->second.expiry)) {
+            ++this->stats.hits;
+            it->second.expiry = expiry();
+            this->lru.splice(this->lru.begin(), this->lru, it->second.lru);
+            return it->second.snapshot->tracks;
+        }
+        this->RemoveLocked(key);
     }
-    return nullptr;
+
+    ++this->stats.misses;
+    return TrackListPtr();
 }
 
 void Snapshots::Put(const std::string& key, TrackList* tracks) {
-    this->Prune();
-    this->Remove(key);
-    this->cache[key] = CacheKey(tracks, expiry());
+    if (!tracks) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->RemoveLocked(key);
+
+    /* shared snapshots are only counted once */
+    auto snapshot = this->Intern(tracks);
+    if (snapshot->entries++ == 0) {
+        this->stats.bytes += snapshot->bytes;
+        ++this->stats.unique;
+    }
+
+    this->lru.push_front(key);
+    this->cache[key] = { snapshot, expiry(), this->lru.begin() };
+    this->PruneLocked();
+}
+
+Snapshots::SnapshotPtr Snapshots::Intern(TrackList* tracks) {
+    /* takes ownership of `tracks`. if we already have a snapshot with the same
+    contents we'll share it, and release the new one immediately. */
+    const uint64_t hash = hashIds(tracks);
+
+    auto range = this->byHash.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        auto existing = it->second.lock();
+        if (existing && sameIds(existing->tracks.get(), tracks)) {
+            ++this->stats.shared;
+            tracks->Release();
+            return existing;
+        }
+    }
+
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->hash = hash;
+    snapshot->bytes = sizeof(Snapshot) + tracks->Count() * sizeof(int64_t);
+    snapshot->tracks = TrackListPtr(tracks, [](const TrackList* tracks) {
+        const_cast<TrackList*>(tracks)->Release();
+    });
+
+    this->byHash.insert({ hash, snapshot });
+    return snapshot;
 }
 
 void Snapshots::Remove(const std::string& key) {
-    this->Prune();
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->RemoveLocked(key);
+    this->PruneLocked();
+}
+
+void Snapshots::RemoveLocked(const std::string& key) {
     auto it = this->cache.find(key);
     if (it != this->cache.end()) {
-        it->second.tracks->Release();
-        this->cache.erase(it);
+        this->EraseLocked(it);
     }
 }
 
+Snapshots::CacheMap::iterator Snapshots::EraseLocked(CacheMap::iterator it) {
+    auto snapshot = it->second.snapshot;
+    if (--snapshot->entries == 0) {
+        /* last reference; it's about to go away, so forget about it */
+        this->stats.bytes -= snapshot->bytes;
+        --this->stats.unique;
+        auto range = this->byHash.equal_range(snapshot->hash);
+        for (auto hashIt = range.first; hashIt != range.second; ++hashIt) {
+            if (hashIt->second.lock() == snapshot) {
+                this->byHash.erase(hashIt);
+                break;
+            }
+        }
+    }
+    this->lru.erase(it->second.lru);
+    return this->cache.erase(it);
+}
+
 void Snapshots::Prune() {
-    auto it = this->cache.begin();
-    while (it != this->cache.end()) {
-        if (expired(it->second.expiry)) {
-            it->second.tracks->Release();
-            it = this->cache.erase(it);
-            continue;
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->PruneLocked();
+}
+
+void Snapshots::PruneLocked() {
+    /* drop anything that has expired. every access pushes an entry's expiry
+    out and moves it to the front, so the oldest ones are at the back. */
+    while (!this->lru.empty()) {
+        auto it = this->cache.find(this->lru.back());
+        if (!expired(it->second.expiry)) {
+            break;
         }
-        ++it;
+        this->EraseLocked(it);
+    }
+
+    /* then evict least recently used entries until we're within our byte
+    budget. we always keep the most recent entry, even if it's larger than
+    the budget by itself. */
+    while (this->stats.bytes > this->stats.maxBytes && this->lru.size() > 1) {
+        this->EraseLocked(this->cache.find(this->lru.back()));
+        ++this->stats.evictions;
     }
+
+    this->stats.count = this->cache.size();
+}
+
+void Snapshots::SetMaxBytes(size_t maxBytes) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->stats.maxBytes = maxBytes;
+    this->PruneLocked();
+}
+
+Snapshots::Stats Snapshots::GetStats() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    return this->stats;
 }
 
 void Snapshots::Reset() {
-    for (auto it : cache) {
-        it.second.tracks->Release();
-    }
+    std::unique_lock<std::mutex> lock(this->mutex);
     this->cache.clear();
-}
\ No newline at end of file
+    this->lru.clear();
+    this->byHash.clear();
+    this->stats.count = this->stats.unique = this->stats.bytes = 0;
+}
@@ -35,36 +35,71 @@
 #pragma once
 
 #include <musikcore/sdk/ITrackList.h>
+#include <list>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 
+/* stores immutable, per-device snapshots of track lists (currently only the
+play queue). identical snapshots, as determined by a hash of their ids, are
+shared between devices. the store is bounded by the total number of bytes used
+by the snapshots' ids, and evicts the least recently used entries first. */
 class Snapshots {
     public:
         using TrackList = musik::core::sdk::ITrackList;
+        using TrackListPtr = std::shared_ptr<const TrackList>;
 
+        struct Stats {
+            size_t count { 0 };
+            size_t unique { 0 };
+            size_t bytes { 0 };
+            size_t maxBytes { 0 };
+            uint64_t hits { 0 };
+            uint64_t misses { 0 };
+            uint64_t shared { 0 };
+            uint64_t evictions { 0 };
+        };
+
+        Snapshots();
         ~Snapshots();
 
-        TrackList* Get(const std::string& key);
+        TrackListPtr Get(const std::string& key);
         void Put(const std::string& key, TrackList* tracks);
         void Remove(const std::string& key);
         void Prune();
         void Reset();
+        void SetMaxBytes(size_t maxBytes);
+        Stats GetStats();
 
     private:
-        struct CacheKey {
-            CacheKey(): CacheKey(nullptr, 0) {
-            }
-            CacheKey(const CacheKey& ck) {
-                this->tracks = ck.tracks;
-                this->expiry = ck.expiry;
-            }
-            CacheKey(TrackList* tl, int64_t ex) {
-                this->tracks = tl;
-                this->expiry = ex;
-            }
-            TrackList* tracks;
+        struct Snapshot {
+            TrackListPtr tracks;
+            uint64_t hash;
+            size_t bytes;
+            size_t entries { 0 }; /* cache entries referencing us */
+        };
+
+        using SnapshotPtr = std::shared_ptr<Snapshot>;
+        using LruList = std::list<std::string>;
+
+        struct CacheEntry {
+            SnapshotPtr snapshot;
             int64_t expiry;
+            LruList::iterator lru;
         };
 
-        std::map<std::string, CacheKey> cache;
-};
\ No newline at end of file
+        using CacheMap = std::map<std::string, CacheEntry>;
+
+        void RemoveLocked(const std::string& key);
+        CacheMap::iterator EraseLocked(CacheMap::iterator it);
+        void PruneLocked();
+        SnapshotPtr Intern(TrackList* tracks);
+
+        std::mutex mutex;
+        CacheMap cache;
+        std::unordered_multimap<uint64_t, std::weak_ptr<Snapshot>> byHash;
+        LruList lru;
+        Stats stats;
+};
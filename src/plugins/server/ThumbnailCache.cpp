@@ -0,0 +1,475 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "ThumbnailCache.h"
+#include "Constants.h"
+#include "Util.h"
+
+#include <musikcore/sdk/String.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+
+#ifdef HAVE_TURBOJPEG
+#include <turbojpeg.h>
+#endif
+
+namespace std {
+    namespace fs = std::filesystem;
+}
+
+using namespace musik::core::sdk;
+
+static const char* TAG = "ThumbnailCache";
+
+/* requested sizes are rounded up to one of these buckets so the number of
+variants we keep on disk per thumbnail stays bounded. */
+static const std::vector<int> SIZE_BUCKETS = { 64, 128, 256, 512, 1024 };
+
+static const size_t MAX_PENDING_INTERACTIVE_JOBS = 64;
+static const int JPEG_QUALITY = 85;
+
+static int snapSize(int size) {
+    for (int bucket : SIZE_BUCKETS) {
+        if (size <= bucket) {
+            return bucket;
+        }
+    }
+    return 0; /* larger than our biggest bucket; just use the original */
+}
+
+static bool isNumeric(const std::string& str) {
+    return str.size() && std::all_of(str.begin(), str.end(), [](unsigned char c) {
+        return std::isdigit(c) != 0;
+    });
+}
+
+static bool fileExists(const std::string& fn) {
+    std::error_code ec;
+    return std::fs::is_regular_file(std::fs::u8path(fn), ec);
+}
+
+static bool writeFile(const std::string& fn, const unsigned char* data, size_t size) {
+    /* write to a temp file and rename it into place so concurrent readers
+    never see a partially written variant. */
+    const std::string temp = fn + ".tmp";
+    {
+        std::ofstream out(std::fs::u8path(temp), std::ios::binary | std::ios::trunc);
+        if (!out.good()) {
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(data), size);
+        if (!out.good()) {
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::fs::rename(std::fs::u8path(temp), std::fs::u8path(fn), ec);
+    if (ec) {
+        std::fs::remove(std::fs::u8path(temp), ec);
+        return false;
+    }
+    return true;
+}
+
+ThumbnailCache::ThumbnailCache(Context& context)
+: context(context)
+, running(false) {
+}
+
+ThumbnailCache::~ThumbnailCache() {
+    this->Stop();
+}
+
+bool ThumbnailCache::Supported() {
+#ifdef HAVE_TURBOJPEG
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ThumbnailCache::Start() {
+    this->Stop();
+
+    if (!Supported()) {
+        return;
+    }
+
+    const int threadCount = std::max(1, std::min(16, context.prefs->GetInt(
+        prefs::thumbnail_resizer_thread_count.c_str(),
+        defaults::thumbnail_resizer_thread_count)));
+
+    std::vector<int> pregenerateSizes;
+    const std::string sizes = GetPreferenceString(
+        context.prefs,
+        prefs::thumbnail_pregenerate_sizes,
+        defaults::thumbnail_pregenerate_sizes);
+
+    for (auto& size : str::Split(sizes, ",")) {
+        try {
+            const int snapped = snapSize(std::stoi(str::Trim(size)));
+            if (snapped > 0) {
+                pregenerateSizes.push_back(snapped);
+            }
+        }
+        catch (...) {
+            /* invalid size, ignore it */
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->pregenerateSizes = pregenerateSizes;
+        this->running = true;
+    }
+
+    for (int i = 0; i < threadCount; i++) {
+        this->threads.push_back(std::make_shared<std::thread>(
+            std::bind(&ThumbnailCache::ThreadProc, this)));
+    }
+
+    this->Pregenerate();
+}
+
+void ThumbnailCache::Stop() {
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->running = false;
+    }
+
+    this->condition.notify_all();
+
+    for (auto thread : this->threads) {
+        thread->join();
+    }
+
+    this->threads.clear();
+
+    /* anyone still waiting on a queued job will fall back to the original */
+    std::unique_lock<std::mutex> lock(this->mutex);
+    for (auto* queue : { &this->interactiveQueue, &this->backgroundQueue }) {
+        for (auto& job : *queue) {
+            job.promise->set_value(false);
+        }
+        queue->clear();
+    }
+    this->pending.clear();
+}
+
+std::string ThumbnailCache::GetThumbnailDirectory() {
+    char pathBuffer[4096];
+    context.environment->GetPath(PathType::Library, pathBuffer, sizeof(pathBuffer));
+    return strlen(pathBuffer) ? std::string(pathBuffer) + "thumbs/" : "";
+}
+
+std::string ThumbnailCache::GetOriginalFilename(const std::string& id) {
+    const std::string directory = this->GetThumbnailDirectory();
+    return directory.size() ? directory + id + ".jpg" : "";
+}
+
+std::string ThumbnailCache::GetVariantFilename(const std::string& id, int size) {
+    const std::string directory = this->GetThumbnailDirectory();
+    return directory.size() ? directory + std::to_string(size) + "/" + id + ".jpg" : "";
+}
+
+std::string ThumbnailCache::GetFilename(const std::string& id, int size, bool& pending) {
+    const std::string original = this->GetOriginalFilename(id);
+
+    pending = false;
+
+    size = snapSize(size);
+    if (size == 0 || !Supported() || !isNumeric(id) || !fileExists(original)) {
+        return original;
+    }
+
+    const std::string variant = this->GetVariantFilename(id, size);
+    if (fileExists(variant)) {
+        return variant;
+    }
+
+    /* don't make the caller wait on the resize; it gets the original now,
+    and the variant next time around. */
+    pending = this->Enqueue(id, size, true).valid();
+
+    return original;
+}
+
+void ThumbnailCache::Pregenerate() {
+    std::vector<int> pregenerateSizes;
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        if (!this->running) {
+            return;
+        }
+        pregenerateSizes = this->pregenerateSizes;
+    }
+
+    if (!pregenerateSizes.size()) {
+        return;
+    }
+
+    const std::string directory = this->GetThumbnailDirectory();
+    if (!directory.size()) {
+        return;
+    }
+
+    size_t queued = 0;
+
+    try {
+        std::error_code ec;
+        std::fs::directory_iterator end;
+        std::fs::directory_iterator file(std::fs::u8path(directory), ec);
+        for ( ; !ec && file != end; file.increment(ec)) {
+            if (file->is_regular_file(ec) && file->path().extension() == ".jpg") {
+                const std::string id = file->path().stem().u8string();
+                if (isNumeric(id)) {
+                    for (int size : pregenerateSizes) {
+                        if (!fileExists(this->GetVariantFilename(id, size))) {
+                            this->Enqueue(id, size, false);
+                            ++queued;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    catch (...) {
+        /* std::filesystem may throw trying to open the directory */
+    }
+
+    if (queued > 0) {
+        context.debug->Info(TAG, str::Format("queued %d thumbnails for pregeneration", (int) queued).c_str());
+    }
+}
+
+std::shared_future<bool> ThumbnailCache::Enqueue(const std::string& id, int size, bool interactive) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    if (!this->running) {
+        return std::shared_future<bool>();
+    }
+
+    const std::string key = std::to_string(size) + "/" + id;
+
+    /* someone already asked for this one; share the result. if a client is now
+    waiting on a job we queued in the background, bump it to the front. */
+    auto it = this->pending.find(key);
+    if (it != this->pending.end()) {
+        if (interactive) {
+            auto& queue = this->backgroundQueue;
+            auto job = std::find_if(queue.begin(), queue.end(), [&id, size](const Job& job) {
+                return job.size == size && job.id == id;
+            });
+            if (job != queue.end()) {
+                this->interactiveQueue.push_back(*job);
+                queue.erase(job);
+            }
+        }
+        return it->second;
+    }
+
+    if (interactive && this->interactiveQueue.size() >= MAX_PENDING_INTERACTIVE_JOBS) {
+        return std::shared_future<bool>(); /* overloaded; caller will use the original */
+    }
+
+    Job job { id, size, std::make_shared<std::promise<bool>>() };
+    auto future = job.promise->get_future().share();
+    this->pending[key] = future;
+    (interactive ? this->interactiveQueue : this->backgroundQueue).push_back(job);
+    this->condition.notify_one();
+
+    return future;
+}
+
+void ThumbnailCache::ThreadProc() {
+    while (true) {
+        Job job;
+
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+
+            while (this->running && !this->interactiveQueue.size() && !this->backgroundQueue.size()) {
+                this->condition.wait(lock);
+            }
+
+            if (!this->running) {
+                return;
+            }
+
+            auto& queue = this->interactiveQueue.size() ? this->interactiveQueue : this->backgroundQueue;
+            job = queue.front();
+            queue.pop_front();
+        }
+
+        bool result = false;
+
+        try {
+            result = this->Resize(job.id, job.size);
+        }
+        catch (...) {
+            result = false;
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->pending.erase(std::to_string(job.size) + "/" + job.id);
+        }
+
+        job.promise->set_value(result);
+    }
+}
+
+#ifdef HAVE_TURBOJPEG
+bool ThumbnailCache::Resize(const std::string& id, int size) {
+    using TjHandle = std::unique_ptr<void, decltype(&tjDestroy)>;
+
+    const std::string original = this->GetOriginalFilename(id);
+    const std::string variant = this->GetVariantFilename(id, size);
+
+    std::vector<unsigned char> input;
+    {
+        std::ifstream in(std::fs::u8path(original), std::ios::binary);
+        if (!in.good()) {
+            return false;
+        }
+        input.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    if (!input.size()) {
+        return false;
+    }
+
+    std::error_code ec;
+    std::fs::create_directories(std::fs::u8path(variant).parent_path(), ec);
+
+    TjHandle decompressor(tjInitDecompress(), &tjDestroy);
+    if (!decompressor) {
+        return false;
+    }
+
+    int width = 0, height = 0, subsampling = 0, colorspace = 0;
+    if (tjDecompressHeader3(
+        decompressor.get(), input.data(), (unsigned long) input.size(),
+        &width, &height, &subsampling, &colorspace) != 0)
+    {
+        return false;
+    }
+
+    /* already small enough, just write a copy so we don't try again */
+    if (std::max(width, height) <= size) {
+        return writeFile(variant, input.data(), input.size());
+    }
+
+    /* libjpeg can downscale by some fixed ratios during the IDCT for almost
+    no cost. use the smallest one that's still at least as large as our
+    target, then box filter the rest of the way. */
+    int scaledWidth = width, scaledHeight = height;
+    int factorCount = 0;
+    tjscalingfactor* factors = tjGetScalingFactors(&factorCount);
+    for (int i = 0; i < factorCount; i++) {
+        const int w = TJSCALED(width, factors[i]);
+        const int h = TJSCALED(height, factors[i]);
+        if (std::max(w, h) >= size && w * h < scaledWidth * scaledHeight) {
+            scaledWidth = w;
+            scaledHeight = h;
+        }
+    }
+
+    std::vector<unsigned char> scaled((size_t) scaledWidth * scaledHeight * 3);
+    if (tjDecompress2(
+        decompressor.get(), input.data(), (unsigned long) input.size(),
+        scaled.data(), scaledWidth, 0, scaledHeight, TJPF_RGB, TJFLAG_FASTDCT) != 0)
+    {
+        return false;
+    }
+
+    const double ratio = (double) size / (double) std::max(scaledWidth, scaledHeight);
+    const int targetWidth = std::max(1, (int) std::lround(scaledWidth * ratio));
+    const int targetHeight = std::max(1, (int) std::lround(scaledHeight * ratio));
+
+    std::vector<unsigned char> output((size_t) targetWidth * targetHeight * 3);
+    for (int y = 0; y < targetHeight; y++) {
+        const int y0 = y * scaledHeight / targetHeight;
+        const int y1 = std::max(y0 + 1, (y + 1) * scaledHeight / targetHeight);
+        for (int x = 0; x < targetWidth; x++) {
+            const int x0 = x * scaledWidth / targetWidth;
+            const int x1 = std::max(x0 + 1, (x + 1) * scaledWidth / targetWidth);
+            unsigned sum[3] = { 0, 0, 0 };
+            for (int sy = y0; sy < y1; sy++) {
+                const unsigned char* src = &scaled[((size_t) sy * scaledWidth + x0) * 3];
+                for (int sx = x0; sx < x1; sx++, src += 3) {
+                    sum[0] += src[0];
+                    sum[1] += src[1];
+                    sum[2] += src[2];
+                }
+            }
+            const unsigned count = (unsigned) ((y1 - y0) * (x1 - x0));
+            unsigned char* dst = &output[((size_t) y * targetWidth + x) * 3];
+            dst[0] = (unsigned char) (sum[0] / count);
+            dst[1] = (unsigned char) (sum[1] / count);
+            dst[2] = (unsigned char) (sum[2] / count);
+        }
+    }
+
+    TjHandle compressor(tjInitCompress(), &tjDestroy);
+    if (!compressor) {
+        return false;
+    }
+
+    unsigned char* jpeg = nullptr;
+    unsigned long jpegSize = 0;
+    if (tjCompress2(
+        compressor.get(), output.data(), targetWidth, 0, targetHeight, TJPF_RGB,
+        &jpeg, &jpegSize, TJSAMP_420, JPEG_QUALITY, TJFLAG_FASTDCT) != 0)
+    {
+        tjFree(jpeg);
+        return false;
+    }
+
+    const bool result = writeFile(variant, jpeg, jpegSize);
+    tjFree(jpeg);
+    return result;
+}
+#else
+bool ThumbnailCache::Resize(const std::string& id, int size) {
+    return false;
+}
+#endif
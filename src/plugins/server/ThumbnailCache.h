@@ -0,0 +1,98 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Context.h"
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* generates and caches downscaled variants of the thumbnails the indexer
+extracts into the library's thumbs/ directory. variants are written to
+thumbs/<size>/<id>.jpg and are generated by a small, bounded worker pool. */
+class ThumbnailCache {
+    public:
+        ThumbnailCache(Context& context);
+        ~ThumbnailCache();
+
+        void Start();
+        void Stop();
+
+        /* returns the filename of the original thumbnail with the specified id */
+        std::string GetOriginalFilename(const std::string& id);
+
+        /* returns the filename of a variant of the thumbnail whose longest
+        edge is no larger than `size` pixels. this never blocks: if the variant
+        doesn't exist yet it's queued for generation, `pending` is set, and the
+        original filename is returned in the meantime. if resizing is
+        unsupported, the original filename is also returned. */
+        std::string GetFilename(const std::string& id, int size, bool& pending);
+
+        /* queues low priority jobs to generate variants for all thumbnails
+        in the configured pregeneration sizes. called at startup, and again
+        whenever the indexer finishes, so new artwork is picked up. */
+        void Pregenerate();
+
+        static bool Supported();
+
+    private:
+        struct Job {
+            std::string id;
+            int size;
+            std::shared_ptr<std::promise<bool>> promise;
+        };
+
+        void ThreadProc();
+        bool Resize(const std::string& id, int size);
+        std::shared_future<bool> Enqueue(const std::string& id, int size, bool interactive);
+        std::string GetVariantFilename(const std::string& id, int size);
+        std::string GetThumbnailDirectory();
+
+        Context& context;
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<Job> interactiveQueue;
+        std::deque<Job> backgroundQueue;
+        std::map<std::string, std::shared_future<bool>> pending;
+        std::vector<std::shared_ptr<std::thread>> threads;
+        std::vector<int> pregenerateSizes;
+        bool running;
+};
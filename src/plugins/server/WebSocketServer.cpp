@@ -113,13 +113,24 @@ static std::shared_ptr<IValue*> jsonToPredicateList(json& arr) {
     });
 }
 
-static json getEnvironment(Context& context) {
+static json getEnvironment(Context& context, Snapshots& snapshots) {
+    const auto stats = snapshots.GetStats();
     return {
         { prefs::http_server_enabled, context.prefs->GetBool(prefs::http_server_enabled.c_str()) },
         { prefs::http_server_port, context.prefs->GetInt(prefs::http_server_port.c_str()) },
         { key::sdk_version, musik::core::sdk::SdkVersion },
         { key::app_version, context.environment->GetAppVersion() },
-        { key::api_version, ApiVersion }
+        { key::api_version, ApiVersion },
+        { key::snapshots, {
+            { key::count, stats.count },
+            { key::unique_count, stats.unique },
+            { key::bytes, stats.bytes },
+            { key::max_bytes, stats.maxBytes },
+            { key::hits, stats.hits },
+            { key::misses, stats.misses },
+            { key::shared, stats.shared },
+            { key::evictions, stats.evictions }
+        } }
     };
 }
 
@@ -144,6 +155,11 @@ void WebSocketServer::Wait() {
 
 bool WebSocketServer::Start() {
     this->Stop();
+
+    this->snapshots.SetMaxBytes((size_t) std::max(0, context.prefs->GetInt(
+        prefs::snapshot_cache_max_bytes.c_str(),
+        defaults::snapshot_cache_max_bytes)));
+
     this->running = true;
     this->thread.reset(new std::thread(std::bind(&WebSocketServer::ThreadProc, this)));
 
@@ -256,7 +272,7 @@ void WebSocketServer::HandleAuthentication(connection_hdl connection, json& requ
             this->RespondWithOptions(
                 connection, request, json({
                     { key::authenticated, true },
-                    { key::environment, getEnvironment(context) }
+                    { key::environment, getEnvironment(context, this->snapshots) }
                 }));
 
             return;
@@ -732,29 +748,27 @@ void WebSocketServer::RespondWithQueryTracksByExternalIds(connection_hdl connect
         json& externalIds = options[key::external_ids];
         if (externalIds.is_array()) {
             auto externalIdArray = jsonToStringArray(externalIds);
-            ITrackList* trackList = context.metadataProxy
-                ->QueryTracksByExternalId(
-                    (const char**) externalIdArray.get(),
-                    externalIds.size());
+            const size_t count = externalIds.size();
+
+            /* resolve all of the tracks at once, rather than one at a time */
+            std::vector<ITrack*> result(count, nullptr);
+            context.metadataProxy->QueryTracksByExternalIds(
+                (const char**) externalIdArray.get(), count, result.data());
 
-            if (trackList) {
-                json tracks = { };
+            json tracks = { };
 
-                ITrack* track;
-                std::string externalId;
-                for (size_t i = 0; i < trackList->Count(); i++) {
-                    track = trackList->GetTrack(i);
-                    externalId = GetMetadataString(track, track::ExternalId);
-                    tracks[externalId] = this->ReadTrackMetadata(track);
+            for (size_t i = 0; i < count; i++) {
+                ITrack* track = result[i];
+                if (track) {
+                    tracks[GetMetadataString(track, track::ExternalId)] = this->ReadTrackMetadata(track);
                     track->Release();
                 }
+            }
 
-                trackList->Release();
-                json options = { { key::data, tracks } };
+            json options = { { key::data, tracks } };
 
-                this->RespondWithOptions(connection, request, options);
-                return;
-            }
+            this->RespondWithOptions(connection, request, options);
+            return;
         }
     }
 
@@ -1126,7 +1140,7 @@ void WebSocketServer::RespondWithPlaySnapshotTracks(connection_hdl connection, j
             time = request[message::options].value(key::time, 0.0);
         }
 
-        context.playback->Play(snapshot, index);
+        context.playback->Play(snapshot.get(), index);
 
         if (time > 0.0) {
             context.playback->SetPosition(time);
@@ -1163,7 +1177,7 @@ void WebSocketServer::RespondWithPlayTracksByCategory(connection_hdl connection,
 }
 
 void WebSocketServer::RespondWithEnvironment(connection_hdl connection, json& request) {
-    this->RespondWithOptions(connection, request, getEnvironment(context));
+    this->RespondWithOptions(connection, request, getEnvironment(context, this->snapshots));
 }
 
 void WebSocketServer::RespondWithCurrentTime(connection_hdl connection, json& request) {
@@ -120,6 +120,10 @@ static class PlaybackRemote : public IPlaybackRemote {
             webSocketServer.OnPlayQueueChanged();
         }
 
+        void OnIndexerFinished(int trackCount) {
+            httpServer.OnIndexerFinished(trackCount);
+        }
+
     private:
         void ThreadProc() {
             httpServer.Wait();
@@ -187,6 +191,12 @@ extern "C" DLL_EXPORT void SetPreferences(musik::core::sdk::IPreferences* prefs)
         prefs->GetInt(prefs::transcoder_cache_count.c_str(), defaults::transcoder_cache_count);
         prefs->GetBool(prefs::transcoder_synchronous.c_str(), defaults::transcoder_synchronous);
         prefs->GetBool(prefs::transcoder_synchronous_fallback.c_str(), defaults::transcoder_synchronous_fallback);
+        prefs->GetInt(prefs::http_server_thread_pool_size.c_str(), defaults::http_server_thread_pool_size);
+        prefs->GetInt(prefs::http_server_read_chunk_size.c_str(), defaults::http_server_read_chunk_size);
+        prefs->GetBool(prefs::http_server_sendfile.c_str(), defaults::http_server_sendfile);
+        prefs->GetInt(prefs::thumbnail_resizer_thread_count.c_str(), defaults::thumbnail_resizer_thread_count);
+        prefs->GetString(prefs::thumbnail_pregenerate_sizes.c_str(), nullptr, 0, defaults::thumbnail_pregenerate_sizes.c_str());
+        prefs->GetInt(prefs::snapshot_cache_max_bytes.c_str(), defaults::snapshot_cache_max_bytes);
         prefs->Save();
     }
 
@@ -199,6 +209,10 @@ extern "C" DLL_EXPORT void SetMetadataProxy(musik::core::sdk::IMetadataProxy* me
     remote.CheckRunningStatus();
 }
 
+extern "C" DLL_EXPORT void OnIndexerFinished(int trackCount) {
+    remote.OnIndexerFinished(trackCount);
+}
+
 extern "C" DLL_EXPORT void SetDebug(musik::core::sdk::IDebug*  debug) {
     auto wl = context.lock.Write();
     context.debug = debug;
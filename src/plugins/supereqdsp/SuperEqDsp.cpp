@@ -45,6 +45,8 @@ using namespace musik::core::sdk;
 static IPreferences* prefs = nullptr;
 static std::atomic<int> currentState;
 
+static const char* SIMD_ENGINE_PREF = "simd_engine";
+
 static const std::vector<std::string> BANDS = {
     "65", "92", "131", "185", "262",
     "370", "523", "740", "1047", "1480",
@@ -56,6 +58,12 @@ extern "C" DLLEXPORT void SetPreferences(IPreferences* prefs) {
     ::prefs = prefs;
 }
 
+extern "C" DLLEXPORT musik::core::sdk::ISchema* GetSchema() {
+    auto schema = new TSchema<>();
+    schema->AddBool(SIMD_ENGINE_PREF, true);
+    return schema;
+}
+
 void SuperEqDsp::NotifyChanged() {
     currentState.fetch_add(1);
 }
@@ -65,10 +73,25 @@ SuperEqDsp::SuperEqDsp() {
 }
 
 SuperEqDsp::~SuperEqDsp() {
-    if (this->supereq) {
-        equ_quit(this->supereq);
-        delete this->supereq;
+    if (this->pending.valid()) {
+        delete this->pending.get();
+    }
+    delete this->engine;
+}
+
+SuperEqEngine* SuperEqDsp::CreateEngine(int channels, long sampleRate) {
+    float bands[SuperEqEngine::kBandCount];
+
+    for (size_t i = 0; i < BANDS.size(); i++) {
+        double dB = ::prefs ? ::prefs->GetDouble(BANDS[i].c_str(), 0.0) : 0.0;
+        double amp = pow(10, dB / 20.f);
+        bands[i] = (float) amp;
     }
+
+    /* the original scalar engine is kept around for comparison */
+    const bool simd = !::prefs || ::prefs->GetBool(SIMD_ENGINE_PREF, true);
+
+    return new SuperEqEngine(channels, sampleRate, bands, simd);
 }
 
 void SuperEqDsp::Release() {
@@ -76,43 +99,50 @@ void SuperEqDsp::Release() {
 }
 
 bool SuperEqDsp::Process(IBuffer* buffer) {
-    int channels = buffer->Channels();
-    int current = ::currentState.load();
-
-    if (!this->supereq || this->lastUpdated != current) {
+    const int channels = buffer->Channels();
+    const long sampleRate = buffer->SampleRate();
+    const int current = ::currentState.load();
+
+    if (!this->engine ||
+        channels != this->engine->Channels() ||
+        sampleRate != this->engine->SampleRate())
+    {
+        /* first buffer, or the format changed underneath us. the existing
+        tables are useless, so we have no choice but to build new ones now. */
+        if (this->pending.valid()) {
+            delete this->pending.get();
+        }
+        delete this->engine;
+        this->engine = CreateEngine(channels, sampleRate);
         this->enabled = ::prefs && ::prefs->GetBool("enabled", false);
         this->lastUpdated = current;
+    }
+    else if (this->lastUpdated != current && !this->pending.valid()) {
+        /* the user changed the eq. rebuilding the tables is expensive, so do
+        it on a background thread and keep using the old ones until it's done. */
+        this->lastUpdated = current;
+        this->pending = std::async(std::launch::async, &SuperEqDsp::CreateEngine, channels, sampleRate);
+    }
 
-        if (!this->supereq) {
-            this->supereq = new SuperEqState();
-            equ_init(this->supereq, 10, channels);
-        }
-
-        void *params = paramlist_alloc();
-        float bands[18];
+    if (this->pending.valid() &&
+        this->pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        SuperEqEngine* engine = this->pending.get();
 
-        for (size_t i = 0; i < BANDS.size(); i++) {
-            double dB =  prefs->GetDouble(BANDS[i].c_str(), 0.0);
-            double amp = pow(10, dB / 20.f);
-            bands[i] = (float) amp;
+        /* only hand over history that's current; a disabled engine's is stale */
+        if (this->enabled) {
+            engine->TakeHistory(*this->engine);
         }
 
-        equ_makeTable(
-            this->supereq,
-            bands,
-            params,
-            (float) buffer->SampleRate());
-
-        paramlist_free(params);
+        delete this->engine;
+        this->engine = engine;
+        this->enabled = ::prefs && ::prefs->GetBool("enabled", false);
     }
 
     if (!this->enabled) {
         return false;
     }
 
-    return equ_modifySamples_float(
-        this->supereq,
-        (char*) buffer->BufferPointer(),
-        buffer->Samples() / channels,
-        channels) != 0;
-}
\ No newline at end of file
+    this->engine->Process(buffer->BufferPointer(), buffer->Samples() / channels);
+    return true;
+}
@@ -35,7 +35,9 @@
 #pragma once
 
 #include <musikcore/sdk/IDSP.h>
-#include "supereq/Equ.h"
+#include "SuperEqEngine.h"
+
+#include <future>
 
 using namespace musik::core::sdk;
 
@@ -50,7 +52,10 @@ class SuperEqDsp : public IDSP {
         static void NotifyChanged();
 
     private:
-        SuperEqState* supereq {nullptr};
+        static SuperEqEngine* CreateEngine(int channels, long sampleRate);
+
+        SuperEqEngine* engine {nullptr};
+        std::future<SuperEqEngine*> pending;
         int lastUpdated {0};
         bool enabled;
 };
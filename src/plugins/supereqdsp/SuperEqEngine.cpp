@@ -0,0 +1,279 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "SuperEqEngine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #include <xmmintrin.h>
+    #define SUPEREQ_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define SUPEREQ_NEON 1
+#endif
+
+/* window size (as a power of two) supereq uses for its tables */
+static const int kWindowBits = 10;
+
+extern "C" void rdft(int, int, REAL *, int *, REAL *);
+
+/* multiplies `x` by `h` in place. both are in rdft()'s packed format: [0] and
+[1] are the (real) dc and nyquist terms, followed by (re, im) pairs. */
+static void multiplySpectrum(float* x, const float* h, int n) {
+    x[0] *= h[0];
+    x[1] *= h[1];
+
+    int i = 2;
+
+#if defined(SUPEREQ_SSE)
+    const __m128 sign = _mm_setr_ps(-1.0f, 1.0f, -1.0f, 1.0f);
+    for (; i + 4 <= n; i += 4) {
+        const __m128 a = _mm_loadu_ps(x + i);
+        const __m128 b = _mm_loadu_ps(h + i);
+        const __m128 bre = _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 2, 0, 0));
+        const __m128 bim = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 3, 1, 1));
+        const __m128 aswap = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1));
+        const __m128 result = _mm_add_ps(
+            _mm_mul_ps(a, bre),
+            _mm_mul_ps(sign, _mm_mul_ps(aswap, bim)));
+        _mm_storeu_ps(x + i, result);
+    }
+#elif defined(SUPEREQ_NEON)
+    for (; i + 8 <= n; i += 8) {
+        float32x4x2_t a = vld2q_f32(x + i);
+        const float32x4x2_t b = vld2q_f32(h + i);
+        const float32x4_t re = vmlsq_f32(vmulq_f32(a.val[0], b.val[0]), a.val[1], b.val[1]);
+        const float32x4_t im = vmlaq_f32(vmulq_f32(a.val[1], b.val[0]), a.val[0], b.val[1]);
+        a.val[0] = re;
+        a.val[1] = im;
+        vst2q_f32(x + i, a);
+    }
+#endif
+
+    for (; i < n; i += 2) {
+        const float re = h[i] * x[i] - h[i + 1] * x[i + 1];
+        const float im = h[i + 1] * x[i] + h[i] * x[i + 1];
+        x[i] = re;
+        x[i + 1] = im;
+    }
+}
+
+/* stashes `count` input samples in `stash`, and replaces them with the
+corresponding (clamped) samples from `ready`. */
+static void exchange(float* samples, float* stash, const float* ready, int count) {
+    int i = 0;
+
+#if defined(SUPEREQ_SSE)
+    const __m128 lo = _mm_set1_ps(-1.0f), hi = _mm_set1_ps(1.0f);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(stash + i, _mm_loadu_ps(samples + i));
+        _mm_storeu_ps(samples + i, _mm_min_ps(hi, _mm_max_ps(lo, _mm_loadu_ps(ready + i))));
+    }
+#elif defined(SUPEREQ_NEON)
+    const float32x4_t lo = vdupq_n_f32(-1.0f), hi = vdupq_n_f32(1.0f);
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(stash + i, vld1q_f32(samples + i));
+        vst1q_f32(samples + i, vminq_f32(hi, vmaxq_f32(lo, vld1q_f32(ready + i))));
+    }
+#endif
+
+    for (; i < count; i++) {
+        stash[i] = samples[i];
+        samples[i] = std::min(1.0f, std::max(-1.0f, ready[i]));
+    }
+}
+
+SuperEqEngine::SuperEqEngine(int channels, long sampleRate, const float* bands, bool simd)
+: channels(channels)
+, sampleRate(sampleRate) {
+    SuperEqState* state = new SuperEqState();
+    memset(state, 0, sizeof(SuperEqState));
+
+    /* every channel gets the same filter, so the new engine only needs
+    supereq to generate one. */
+    equ_init(state, kWindowBits, simd ? 1 : channels);
+
+    void *params = paramlist_alloc();
+    equ_makeTable(state, const_cast<float*>(bands), params, (float) sampleRate);
+    paramlist_free(params);
+
+    if (!simd) {
+        this->legacy = state;
+        return;
+    }
+
+    this->winlen = state->winlen;
+    this->tabsize = state->tabsize;
+
+    /* equ_makeTable() writes to whichever table isn't current */
+    const float* table = state->chg_ires == 2 ? state->lires2 : state->lires1;
+    const float scale = 2.0f / (float) this->tabsize;
+    this->filter.resize(this->tabsize);
+    for (int i = 0; i < this->tabsize; i++) {
+        this->filter[i] = table[i] * scale;
+    }
+
+    equ_quit(state);
+    delete state;
+
+    this->spectra.resize(this->tabsize * channels, 0.0f);
+    this->input.resize(this->winlen * channels, 0.0f);
+    this->output.resize(this->tabsize * channels, 0.0f);
+    this->fftIp.resize(2 + (int) std::sqrt((double) (this->tabsize / 2)), 0);
+    this->fftW.resize(this->tabsize / 2, 0.0f);
+}
+
+SuperEqEngine::~SuperEqEngine() {
+    if (this->legacy) {
+        equ_quit(this->legacy);
+        delete this->legacy;
+    }
+}
+
+void SuperEqEngine::Process(float* samples, int frames) {
+    if (this->legacy) {
+        equ_modifySamples_float(this->legacy, (char*) samples, frames, this->channels);
+        return;
+    }
+
+    const int nch = this->channels;
+
+    while (this->buffered + frames >= this->winlen) {
+        const int take = this->winlen - this->buffered;
+
+        exchange(
+            samples,
+            this->input.data() + this->buffered * nch,
+            this->output.data() + this->buffered * nch,
+            take * nch);
+
+        samples += take * nch;
+        frames -= take;
+        this->buffered = 0;
+
+        /* the part of the output that is still accumulating slides down */
+        float* out = this->output.data();
+        memmove(out, out + this->winlen * nch, (this->tabsize - this->winlen) * nch * sizeof(float));
+
+        this->Convolve();
+    }
+
+    exchange(
+        samples,
+        this->input.data() + this->buffered * nch,
+        this->output.data() + this->buffered * nch,
+        frames * nch);
+
+    this->buffered += frames;
+}
+
+SuperEqEngine::History SuperEqEngine::GetHistory() {
+    /* supereq's own buffers have the same (interleaved) layout as ours */
+    if (this->legacy) {
+        return {
+            this->legacy->finbuf,
+            this->legacy->outbuf,
+            &this->legacy->nbufsamples,
+            this->legacy->winlen,
+            this->legacy->tabsize
+        };
+    }
+
+    return {
+        this->input.data(),
+        this->output.data(),
+        &this->buffered,
+        this->winlen,
+        this->tabsize
+    };
+}
+
+void SuperEqEngine::TakeHistory(SuperEqEngine& previous) {
+    if (previous.channels != this->channels) {
+        return;
+    }
+
+    History from = previous.GetHistory();
+    History to = this->GetHistory();
+
+    if (from.winlen != to.winlen || from.tabsize != to.tabsize) {
+        return;
+    }
+
+    /* what's already queued was filtered with the old settings, and plays
+    out that way; the new filter takes over from the next window. */
+    const int nch = this->channels;
+    memcpy(to.input, from.input, to.winlen * nch * sizeof(float));
+    memcpy(to.output, from.output, to.tabsize * nch * sizeof(float));
+    *to.buffered = *from.buffered;
+}
+
+void SuperEqEngine::Convolve() {
+    const int nch = this->channels;
+    const int winlen = this->winlen;
+    const int tabsize = this->tabsize;
+    const float* in = this->input.data();
+    float* out = this->output.data();
+
+    /* deinterleave every channel in a single pass over the input */
+    for (int i = 0; i < winlen; i++) {
+        for (int ch = 0; ch < nch; ch++) {
+            this->spectra[ch * tabsize + i] = in[i * nch + ch];
+        }
+    }
+
+    for (int ch = 0; ch < nch; ch++) {
+        float* x = this->spectra.data() + ch * tabsize;
+        std::fill(x + winlen, x + tabsize, 0.0f);
+        rdft(tabsize, 1, x, this->fftIp.data(), this->fftW.data());
+        multiplySpectrum(x, this->filter.data(), tabsize);
+        rdft(tabsize, -1, x, this->fftIp.data(), this->fftW.data());
+    }
+
+    /* overlap-add the head, replace the tail; again, all channels at once */
+    for (int i = 0; i < winlen; i++) {
+        for (int ch = 0; ch < nch; ch++) {
+            out[i * nch + ch] += this->spectra[ch * tabsize + i];
+        }
+    }
+
+    for (int i = winlen; i < tabsize; i++) {
+        for (int ch = 0; ch < nch; ch++) {
+            out[i * nch + ch] = this->spectra[ch * tabsize + i];
+        }
+    }
+}
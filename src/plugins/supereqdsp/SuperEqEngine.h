@@ -0,0 +1,90 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "supereq/Equ.h"
+
+#include <vector>
+
+/* an overlap-add fft convolution engine driven by the filter tables that
+supereq generates. compared to equ_modifySamples_float() it: keeps its own fft
+work tables (supereq's are process-wide statics), folds output scaling into a
+filter that is computed once per settings change, handles every channel in one
+interleaved pass, and uses SSE or NEON for the spectral multiply and clamping
+where available. the original engine can still be selected for comparison. */
+class SuperEqEngine {
+    public:
+        static const int kBandCount = 18;
+
+        SuperEqEngine(int channels, long sampleRate, const float* bands, bool simd);
+        ~SuperEqEngine();
+
+        SuperEqEngine(const SuperEqEngine&) = delete;
+        SuperEqEngine& operator=(const SuperEqEngine&) = delete;
+
+        int Channels() const noexcept { return this->channels; }
+        long SampleRate() const noexcept { return this->sampleRate; }
+
+        void Process(float* samples, int frames);
+
+        /* carries over the overlap-add state of the engine this one replaces,
+        so output continues seamlessly instead of restarting from silence. */
+        void TakeHistory(SuperEqEngine& previous);
+
+    private:
+        struct History {
+            float* input;
+            float* output;
+            int* buffered;
+            int winlen, tabsize;
+        };
+
+        History GetHistory();
+        void Convolve();
+
+        int channels;
+        long sampleRate;
+        int winlen, tabsize;
+        int buffered { 0 };
+
+        SuperEqState* legacy { nullptr };
+
+        std::vector<float> filter;   /* tabsize, pre-scaled by 2/tabsize */
+        std::vector<float> spectra;  /* tabsize per channel */
+        std::vector<float> input;    /* winlen frames, interleaved */
+        std::vector<float> output;   /* tabsize frames, interleaved */
+        std::vector<int> fftIp;
+        std::vector<float> fftW;
+};
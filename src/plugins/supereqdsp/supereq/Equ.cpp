@@ -21,17 +21,28 @@
 #include <stdlib.h>
 #include <math.h>
 #include <assert.h>
+#include <mutex>
 #include "paramlist.hpp"
 #include "Equ.h"
 
 extern "C" void rdft(int, int, REAL *, int *, REAL *);
+
+/* rfft()'s work tables are shared by every instance, which may live on
+different threads. they're guarded by rfft_mutex, and freed when the last
+initialized instance is torn down (rfft(0, ...)). */
+static std::mutex rfft_mutex;
+static int rfft_users = 0;
+
 void rfft(int n,int isign,REAL *x)
 {
     static int ipsize = 0,wsize=0;
     static int *ip = NULL;
     static REAL *w = NULL;
     int newipsize,newwsize;
+    std::lock_guard<std::mutex> lock(rfft_mutex);
     if (n == 0) {
+        if (--rfft_users > 0) return;
+        rfft_users = 0;
         free(ip); ip = NULL; ipsize = 0;
         free(w);  w  = NULL; wsize  = 0;
         return;
@@ -106,6 +117,12 @@ extern "C" void equ_init(SuperEqState *state, int wb, int channels)
 {
   int i,j;
 
+  if (state->lires1 == NULL) {
+    /* not a re-init; this is a new user of rfft()'s tables */
+    std::lock_guard<std::mutex> lock(rfft_mutex);
+    ++rfft_users;
+  }
+
   if (state->lires1 != NULL)   free(state->lires1);
   if (state->lires2 != NULL)   free(state->lires2);
   if (state->irest != NULL)    free(state->irest);
@@ -312,6 +329,8 @@ extern "C" void equ_makeTable(SuperEqState *state, REAL *lbc,void *_param,REAL f
 
 extern "C" void equ_quit(SuperEqState *state)
 {
+  const int initialized = state->lires1 != NULL;
+
   equ_free(state->lires1);
   equ_free(state->lires2);
   equ_free(state->irest);
@@ -327,7 +346,9 @@ extern "C" void equ_quit(SuperEqState *state)
   state->finbuf    = NULL;
   state->outbuf   = NULL;
 
-  rfft(0,0,NULL);
+  if (initialized) {
+    rfft(0,0,NULL);
+  }
 }
 
 extern "C" void equ_clearbuf(SuperEqState *state)
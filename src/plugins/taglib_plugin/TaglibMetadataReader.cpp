@@ -182,7 +182,13 @@ static inline bool replayGainValid(ReplayGain& rg) {
         rg.trackGain != 1.0 || rg.trackPeak != 1.0;
 }
 
+/* call after album and artist tags have been read; the store may already
+have artwork for the album, in which case we don't need to copy ours. */
 static inline void processAlbumArt(TagLib::List<TagLib::FLAC::Picture*> pictures, ITagStore* target) {
+    if (pictures.isEmpty() || target->ContainsThumbnail()) {
+        return;
+    }
+
     for (auto picture : pictures) {
         if (picture->type() == TagLib::FLAC::Picture::FrontCover) {
             auto byteVector = picture->data();
@@ -292,9 +298,9 @@ bool TaglibMetadataReader::ReadGeneric(
         field list. if we're dealing with a straight-up Xiph tag, process it now */
         const auto xiphTag = dynamic_cast<TagLib::Ogg::XiphComment*>(tag);
         if (xiphTag) {
-            processAlbumArt(xiphTag->pictureList(), target);
             this->ReadFromMap(xiphTag->fieldListMap(), target);
             this->ExtractReplayGain(xiphTag->fieldListMap(), target);
+            processAlbumArt(xiphTag->pictureList(), target);
         }
 
         /* if this isn't a xiph tag, the file format may have some other custom
@@ -306,12 +312,12 @@ bool TaglibMetadataReader::ReadGeneric(
             see if there's a xiph comment buried deep. */
             auto flacFile = dynamic_cast<TagLib::FLAC::File*>(file.file());
             if (flacFile) {
-                processAlbumArt(flacFile->pictureList(), target);
                 if (flacFile->hasXiphComment()) {
                     this->ReadFromMap(flacFile->xiphComment()->fieldListMap(), target);
                     this->ExtractReplayGain(flacFile->xiphComment()->fieldListMap(), target);
                     handled = true;
                 }
+                processAlbumArt(flacFile->pictureList(), target);
             }
 
             /* similarly, mp4 buries disc number and album artist. however, taglib does
@@ -672,21 +678,19 @@ bool TaglibMetadataReader::ReadID3V2(TagLib::ID3v2::Tag *id3v2, ITagStore *track
             not be reliable; the thumbnails are computed and stored at the album level
             so the album and album artist names need to have already been parsed. */
 
-            if (!track->ContainsThumbnail()) {
-                TagLib::ID3v2::FrameList pictures = allTags["APIC"];
-                if (!pictures.isEmpty()) {
-                    /* there can be multiple pictures, apparently. let's just use
-                    the first one. */
+            TagLib::ID3v2::FrameList pictures = allTags["APIC"];
+            if (!pictures.isEmpty() && !track->ContainsThumbnail()) {
+                /* there can be multiple pictures, apparently. let's just use
+                the first one. */
 
-                    const TagLib::ID3v2::AttachedPictureFrame *picture =
-                        static_cast<TagLib::ID3v2::AttachedPictureFrame*>(pictures.front());
+                const TagLib::ID3v2::AttachedPictureFrame *picture =
+                    static_cast<TagLib::ID3v2::AttachedPictureFrame*>(pictures.front());
 
-                    TagLib::ByteVector pictureData = picture->picture();
-                    const long long size = pictureData.size();
+                TagLib::ByteVector pictureData = picture->picture();
+                const long long size = pictureData.size();
 
-                    if (size > 32) {    /* noticed that some id3tags have like a 4-8 byte size with no thumbnail */
-                        track->SetThumbnail(pictureData.data(), size);
-                    }
+                if (size > 32) {    /* noticed that some id3tags have like a 4-8 byte size with no thumbnail */
+                    track->SetThumbnail(pictureData.data(), size);
                 }
             }
 